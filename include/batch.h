@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+
+// `batch [-P n] command args...` runs the first stage of a pipeline as
+// several invocations when its argument list would not fit in ARG_MAX.
+// The fields of the first word that expands to more than one field, and
+// everything after it, are split into maximal batches; the fields before
+// it are repeated in every batch. Batches run one after another, or up to
+// 'parallel' at a time, inside the stage's process, so they share its
+// redirections, pipe ends and process group.
+typedef struct {
+    bool enabled;
+    int parallel;       // Batches running at once
+} BatchSpec;
+
+void batch_clear(BatchSpec *spec);
+
+// Parses the options following the word `batch`. Returns the number of
+// words consumed, or -1 after printing an error.
+int batch_parse(char **words, int count, BatchSpec *spec);
+
+// Runs 'argv' in a forked stage. Execs it directly when it fits; otherwise
+// forks one child per batch and returns the highest exit status among
+// them. Stops starting batches once one reports 126 or 127.
+int batch_exec(char **argv, int argc, int fixed, const BatchSpec *spec);
+
+#endif // BATCH_H
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Builtin flags
+#define BUILTIN_PARENT   0x1u  // Runs in the shell process when not in a pipeline
+#define BUILTIN_PIPELINE 0x2u  // May run as a stage of a pipeline (in a child)
+#define BUILTIN_CAPTURE  0x4u  // Output only via stdio, no shell state changes: $(...) runs it without forking
+#define BUILTIN_PERSIST  0x8u  // Redirections stay applied to the shell afterwards (exec)
+
+// Every builtin, static or loaded, takes the expanded argv and returns an
+// exit status like any other command.
+typedef int (*BuiltinFn)(char **args, int argc);
+
+typedef struct {
+    const char *name;
+    BuiltinFn fn;
+    unsigned flags;
+} Builtin;
+
+// Loadable modules (see `enable -f`) export, for each builtin 'name':
+//   int name_builtin(char **args, int argc);
+//   const unsigned name_builtin_flags;   (optional, defaults to BUILTIN_PIPELINE)
+
+// Returns the builtin registered under 'name', or NULL for external commands
+const Builtin* builtin_lookup(const char *name);
+
+// enable [-f library.so] [-d] [name ...]
+int do_enable(char **args, int argc);
+
+// Hash shared by the build-time table generator and the runtime lookup.
+// FNV-1a seeded through the offset basis, followed by a murmur-style
+// finaliser so that nearby seeds give unrelated distributions.
+static inline uint32_t builtin_hash(const char *s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    return h;
+}
+
+#endif // BUILTINS_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef COREUTILS_H
+#define COREUTILS_H
+
+// In-process replacements for the small utilities that dominate generated
+// scripts. They write through stdio so output is buffered, and they are
+// registered as PARENT|PIPELINE builtins so a standalone call never forks.
+int do_echo(char **args, int argc);
+int do_printf(char **args, int argc);
+int do_test(char **args, int argc);    // Also registered as "["
+int do_true(char **args, int argc);
+int do_false(char **args, int argc);
+int do_pwd(char **args, int argc);
+
+// Flushes what a builtin left in the stdout buffer, for the places where it
+// has to go out now: before its descriptors are switched back, or before a
+// forked stage exits. A failed write is reported as "name: write error"
+// and turns 'status' into 1.
+int builtin_flush(const char *name, int status);
+
+#endif // COREUTILS_H
\ No newline at end of file
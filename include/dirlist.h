@@ -0,0 +1,46 @@
+#ifndef DIRLIST_H
+#define DIRLIST_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+
+typedef enum {
+    SORT_NAME,
+    SORT_SIZE,   // Largest first
+    SORT_MTIME   // Newest first
+} SortKey;
+
+typedef struct {
+    mode_t mode;
+    nlink_t nlink;
+    off_t size;
+    struct timespec mtime;
+    bool valid;          // False if the entry vanished or could not be stat'ed
+} EntryMeta;
+
+typedef struct {
+    char *name;
+    EntryMeta meta;
+} DirEntry;
+
+// Opaque io_uring instance used to submit statx requests in batches
+typedef struct StatRing StatRing;
+
+// Returns NULL when io_uring is unavailable (old kernel, seccomp, or the
+// REVEAL_NO_URING environment variable is set). A ring is not thread-safe,
+// so each thread needs its own.
+StatRing* stat_ring_open(void);
+void stat_ring_close(StatRing *ring);
+
+// Fills in the metadata of every entry, relative to 'dir_fd'. With a NULL
+// ring, or for requests the ring rejects, falls back to fstatat(); so does
+// every later call once the ring failed with requests still in flight.
+void stat_entries(StatRing *ring, int dir_fd, DirEntry *entries, int count);
+
+void sort_entries(DirEntry *entries, int count, SortKey key);
+
+// Prints entries in reveal's format. Long format implies one per line.
+void print_entries(const DirEntry *entries, int count, bool line_by_line, bool long_format);
+
+#endif // DIRLIST_H
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// A small registry of descriptors (timers and the like) the shell watches
+// while it would otherwise block: waiting for a line of input or for a
+// foreground job. A handler runs when its descriptor becomes readable.
+typedef void (*EventHandler)(int fd, void *data);
+
+bool events_add(int fd, EventHandler handler, void *data);
+void events_remove(int fd);
+
+// Runs the handlers of descriptors that are ready now, without blocking
+void events_dispatch(void);
+
+// Blocks until 'fd' is readable, running handlers meanwhile. Returns -1
+// with errno EINTR if a signal interrupted the wait.
+int events_wait_readable(int fd);
+
+// waitpid() that keeps running handlers while it blocks. Behaves exactly
+// like waitpid() when nothing is registered.
+pid_t events_waitpid(pid_t pid, int *status, int options);
+
+#endif // EVENTS_H
\ No newline at end of file
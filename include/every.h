@@ -0,0 +1,29 @@
+#ifndef EVERY_H
+#define EVERY_H
+
+#include <stdbool.h>
+#include "executor.h"
+
+// `every [-d] [-n count] interval pipeline` re-runs a pipeline on a fixed
+// schedule as one job. The pipeline is parsed once; each run expands and
+// executes the same CommandGroup. With -d only lines that changed since the
+// previous run are printed.
+typedef struct {
+    double interval;    // Seconds, 0 when there is no `every` prefix
+    int count;          // Runs before stopping, 0 for no limit
+    bool diff;
+} EverySpec;
+
+void every_clear(EverySpec *spec);
+
+// Parses the options and interval following the word `every`. Returns the
+// number of words consumed, or -1 after printing an error.
+int every_parse(char **words, int count, EverySpec *spec);
+
+// The job's main loop, run in the forked job leader. Runs 'group' on the
+// schedule until the count is reached or SIGINT/SIGTERM arrives, then
+// prints drift and latency statistics to stderr. Returns the last run's
+// exit status.
+int every_run(CommandGroup *group, const EverySpec *spec);
+
+#endif // EVERY_H
\ No newline at end of file
@@ -7,4 +7,62 @@
 // including handling ';' and '&' operators.
 void process_line(char *input);
 
+// Runs a complete line the way the prompt does: compound commands through
+// the script VM, anything else through process_line() after a syntax check.
+// Returns the exit status (2 for a syntax error), also left in LAST_STATUS.
+int execute_line(char *input);
+
+// Runs 'text' line by line through execute_line(), as if typed: the lines
+// after a here-document supply its body, and compound commands may span
+// lines. For `-c` and server requests, whose process exits afterwards, so
+// the very last command may replace it (see set_exit_after_line()).
+int execute_text(const char *text);
+
+// A single pipeline, parsed once so that it can be run repeatedly (e.g. as
+// the body of a loop). Variables are expanded afresh on every run.
+typedef struct CommandGroup CommandGroup;
+
+CommandGroup* parse_cmd_group(const char *input);
+// Runs the pipeline and returns its exit status, which is also stored in
+// LAST_STATUS. Background pipelines return 0 once started.
+int run_parsed_group(CommandGroup *group, bool is_background);
+void free_cmd_group(CommandGroup *group);
+
+// True if 'group' always runs in forked processes (an external command, a
+// pipeline, an `every` job), so running it from a subshell needs no fork
+// of its own. Decided on the words as written.
+bool group_forks(const CommandGroup *group);
+// True if 'group' is nothing but redirections, as after `}` or `)`
+bool group_only_redirects(const CommandGroup *group);
+
+// Redirections of a { ...; } or ( ... ) group, applied to the shell's own
+// descriptors for the length of its body. Pushes report any failure and
+// return -1, having applied nothing; pops undo the innermost push.
+int redirect_push(CommandGroup *group);
+void redirect_pop(void);
+// True if the innermost push fans output out through relays, which its pop
+// waits for
+bool redirect_has_relays(void);
+
+// A forked copy of the shell for a ( ... ) subshell. In the child it returns
+// 0 with job control signals back to default; the parent waits for it with
+// subshell_wait(), which returns its status like a foreground job's.
+pid_t subshell_fork(void);
+int subshell_wait(pid_t pid, const char *command);
+
+// Declares that the process exits once the current line has run (`-c`, a
+// server request, a $(...) child). The last command of the line may then be
+// exec'd in place of the shell instead of being forked and waited for.
+void set_exit_after_line(bool exits);
+bool exits_after_line(void);
+// Lets the next run_parsed_group() exec in place: nothing runs after it
+void mark_tail_call(void);
+
+// Runs 'command' with its standard output captured, for $(command). Returns
+// the output minus trailing newlines (never NULL) and sets LAST_STATUS.
+char* capture_output(const char *command);
+
+// Builtins
+int do_exec(char **args, int argc);
+
 #endif // EXECUTOR_H
\ No newline at end of file
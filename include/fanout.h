@@ -0,0 +1,19 @@
+#ifndef FANOUT_H
+#define FANOUT_H
+
+// Output fan-out. When a descriptor has several `>`/`>>` targets, or a `>+`
+// target (a copy on top of wherever the output was going anyway), the
+// command writes into a pipe and a relay process hands the data on to
+// every target.
+#define FANOUT_MAX 16
+
+// The relay loop: copies everything written to pipe 'in' to each of the
+// 'count' targets (at least two) until EOF. The data is duplicated with
+// tee(2) into one scratch pipe per extra target and moved out with
+// splice(2), so it never passes through user space. Targets splice cannot
+// write to (O_APPEND files, terminals) get a read/write copy instead; a
+// target that fails is dropped and the others carry on. Returns 0, or 1
+// after an error.
+int fanout_relay(int in, const int *targets, int count);
+
+#endif // FANOUT_H
\ No newline at end of file
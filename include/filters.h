@@ -0,0 +1,24 @@
+#ifndef FILTERS_H
+#define FILTERS_H
+
+#include <stddef.h>
+
+// In-process versions of the filters pipelines usually end in. They are
+// registered as PIPELINE builtins, so a stage running one is forked but
+// never exec'd. Each handles the common options itself and execs the real
+// utility for anything else, so behaviour never changes, only speed.
+//
+//   grep [-Fvcqn] pattern [file ...]   fixed strings only (no BRE metacharacters)
+//   wc [-lwc] [file ...]
+//   head [-n N | -N] [file ...]        stops reading once N lines are out
+//   tail [-n N | -N] [file ...]        reads regular files from the end
+int do_grep(char **args, int argc);
+int do_wc(char **args, int argc);
+int do_head(char **args, int argc);
+int do_tail(char **args, int argc);
+
+// SSE2 where available, with a scalar fallback
+size_t count_newlines(const char *p, size_t n);
+const char* find_fixed(const char *hay, size_t n, const char *needle, size_t m);
+
+#endif // FILTERS_H
\ No newline at end of file
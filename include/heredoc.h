@@ -0,0 +1,25 @@
+#ifndef HEREDOC_H
+#define HEREDOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Here-document bodies are read together with the command line and folded
+// into it as a single word, "<<=" (expanded) or "<<:" (literal) followed by
+// the body with blanks and shell operators %-escaped. The line stays
+// self-contained, so it can be re-parsed or compiled into a loop.
+#define HEREDOC_PREFIX_LEN 3
+
+char* heredoc_encode(const char *body, size_t len, bool literal);
+// 'word' starts with the prefix; returns the body and whether it is literal
+char* heredoc_decode(const char *word, bool *literal);
+// Returns a copy of 'line' with every body dropped, leaving the bare
+// prefixes: the command text, as the history keeps it
+char* heredoc_strip(const char *line);
+
+// Returns a read-only descriptor positioned at the start of 'data': a
+// pre-filled pipe for small payloads, otherwise a sealed memfd. Nothing
+// touches the filesystem. Returns -1 on error.
+int heredoc_fd(const char *data, size_t len);
+
+#endif // HEREDOC_H
\ No newline at end of file
@@ -1,7 +1,30 @@
 #ifndef INPUT_H
 #define INPUT_H
 
-// Reads a line of input from the user
+#include <stdbool.h>
+
+// Reads a line of input from the user, or from the string given to
+// input_from_string(). Returns NULL at the end of input.
 char *read_input(void);
 
+// Makes read_input() return the lines of 'text' (which must outlive the
+// reading) instead of reading stdin, e.g. for `-c`. input_exhausted() is
+// true once every line has been read.
+void input_from_string(const char *text);
+bool input_exhausted(void);
+
+// Reads one complete command: a line with its here-document bodies folded
+// in and, for an unfinished compound command, the lines that complete it.
+// Returns NULL at the end of input.
+char *read_command(void);
+
+// Reads the body of every <<DELIM here-document on 'line' from the
+// following input lines and folds it into the line (see heredoc.h).
+// Takes ownership of 'line' and returns the rewritten line.
+char *read_heredocs(char *line);
+
+// Reads further lines until 'text' holds complete compound commands and
+// returns them joined into a single line. Takes ownership of 'text'.
+char *read_compound_input(char *text);
+
 #endif // INPUT_H
\ No newline at end of file
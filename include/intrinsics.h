@@ -13,7 +13,9 @@ void log_add(const char *command);
 // Returns NULL if index is invalid
 char* log_get_command(int index);
 
-// Returns true if the command was an intrinsic and was handled
-bool handle_intrinsic(char **args, int argc);
-bool is_parent_builtin(const char* cmd); 
+// Builtin commands, dispatched through the registry in builtins.c
+int do_hop(char **args, int argc);
+int do_reveal(char **args, int argc);
+int do_log(char **args, int argc);
+
 #endif // INTRINSICS_H
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef JOBLIMITS_H
+#define JOBLIMITS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/resource.h>
+
+// Limits set with the `limit` prefix of a pipeline:
+//   limit [-t duration] [-m size] [-n count] command [| command ...]
+// -t is a wall-clock timeout for the whole job, enforced by the shell;
+// -m (address space) and -n (open files) are rlimits set in every stage.
+typedef struct {
+    double timeout;     // Seconds, 0 for none
+    rlim_t memory;      // RLIM_INFINITY for none
+    rlim_t files;       // RLIM_INFINITY for none
+} JobLimits;
+
+void limits_clear(JobLimits *limits);
+bool limits_any(const JobLimits *limits);
+
+// Parses the options following the word `limit`. Returns the number of
+// words consumed, or -1 after printing an error.
+int limits_parse(char **words, int count, JobLimits *limits);
+
+// Sets the rlimits in a child about to run a stage. Returns -1 after
+// printing an error.
+int limits_apply(const JobLimits *limits);
+
+// Writes e.g. "-t 30s -m 2G" to 'buf'
+void limits_format(const JobLimits *limits, char *buf, size_t size);
+
+#endif // JOBLIMITS_H
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define JOBS_H
 
 #include "shell.h"
+#include "joblimits.h"
+#include "jobsched.h"
 
 // Declare next_job_id as extern for use in other files
 extern int next_job_id;
@@ -11,8 +13,13 @@ typedef enum {
     STOPPED
 } JobState;
 
+#define MAX_JOBS 64
+#define JOB_MAX_PROCS 16
+
 typedef struct {
     pid_t pgid;         // Process group ID for the job
+    pid_t pids[JOB_MAX_PROCS];  // One process per pipeline stage
+    int pid_count;
     int job_id;
     char command[1024]; // The full command string
     JobState state;
@@ -20,14 +27,39 @@ typedef struct {
 } Job;
 
 void jobs_init(void);
-void jobs_add(pid_t pgid, const char* command, JobState state);
+void jobs_add(pid_t pgid, const char* command, JobState state, const pid_t *pids, int pid_count);
 void jobs_reap(void);
 void jobs_kill_all(void);
+// Listed jobs, running or stopped
+int jobs_count(void);
+
+// Process substitutions run as jobs of their own that are never listed or
+// reported; jobs_reap() collects them, as does jobs_hidden_count() before
+// counting those still running
+void jobs_add_hidden(pid_t pgid);
+int jobs_hidden_count(void);
+
+// Copies the active jobs, in job id order, to 'out'; returns how many
+int jobs_list(Job *out, int max);
+
+// `activities --top`: samples the processes of every job each 'interval'
+// seconds, 'count' times (0: until interrupted). Lives in jobtop.c.
+int jobs_top(double interval, int count);
+
+// Enforces the timeout of a job started with `limit` and remembers its
+// limits and scheduling policy ('sched' may be NULL) for `activities`. On expiry the group gets SIGTERM, then SIGKILL
+// if it is still there LIMIT_KILL_GRACE seconds later. The timer runs from
+// the shell's event loop, so it fires while the shell waits for input or
+// for a foreground job. Returns false, after saying why, if the job cannot
+// be watched; the caller must not let it run unwatched.
+bool jobs_watch(pid_t pgid, const JobLimits *limits, const JobSched *sched);
+void jobs_unwatch(pid_t pgid);
 
 // New functions for Part E
-void do_activities(void);
-void do_ping(char** args, int argc);
-void do_fg(char** args, int argc);
-void do_bg(char** args, int argc);
+// Builtins return an exit status like any other command
+int do_activities(char** args, int argc);
+int do_ping(char** args, int argc);
+int do_fg(char** args, int argc);
+int do_bg(char** args, int argc);
 
 #endif // JOBS_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef JOBSCHED_H
+#define JOBSCHED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SCHED_MAX_CPUS 1024
+
+// Scheduling policy set with the `sched` prefix of a pipeline:
+//   sched [--cpus list] [--nice n] [--ioprio class[:level]] [--spread] command
+// The policy is applied to every stage. Background jobs without a prefix
+// get the shell-wide default set with `sched --default`.
+typedef struct {
+    uint64_t cpus[SCHED_MAX_CPUS / 64];   // Allowed CPUs, if has_cpus
+    bool has_cpus;
+    bool spread;        // Pin stage i to the i-th allowed CPU
+    bool has_nice;
+    int nice;
+    int ioprio_class;   // 0 to leave alone, else IOPRIO_CLASS_*
+    int ioprio_level;
+} JobSched;
+
+void sched_clear(JobSched *sched);
+bool sched_any(const JobSched *sched);
+
+// Parses the options following the word `sched`. Returns the number of
+// words consumed, or -1 after printing an error.
+int sched_parse(char **words, int count, JobSched *sched);
+
+// Applies the policy to process 'pid' (0: the calling process), which is
+// stage number 'stage' of its pipeline. Returns -1 after printing an error.
+int sched_apply(const JobSched *sched, pid_t pid, int stage);
+
+// Writes e.g. "--cpus 0-3 --nice 10" to 'buf'
+void sched_format(const JobSched *sched, char *buf, size_t size);
+
+// Policy for background jobs without a `sched` prefix (NULL for none)
+const JobSched* sched_background_default(void);
+
+// Builtin: sched [--default [off | options]]
+int do_sched(char **args, int argc);
+
+#endif // JOBSCHED_H
\ No newline at end of file
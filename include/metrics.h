@@ -0,0 +1,60 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Counters for fleet monitoring, served in the Prometheus text format on a
+// Unix domain socket when the shell is started with --metrics PATH. The
+// hot paths bump plain fields of METRICS; the shell is single-threaded, and
+// a forked child's updates simply stay in its own copy. The socket is
+// answered from the event loop (events.h), between commands and while the
+// shell waits for a foreground job, and never blocks.
+
+// Upper bounds of the parse time histogram buckets, in seconds
+#define METRICS_PARSE_BUCKETS 8
+
+typedef struct {
+    bool enabled;               // Serving; also gates the timing calls
+    uint64_t shell_commands;    // Builtins run in the shell process
+    uint64_t forked_commands;   // Stages forked or launched by the fork server
+    uint64_t fork_failures;
+    uint64_t exec_failures;     // Stages that exited 126 or 127
+    uint64_t parse_buckets[METRICS_PARSE_BUCKETS];
+    uint64_t parse_count;
+    double parse_seconds;
+    uint64_t reap_count;        // jobs_reap() calls
+    double reap_seconds;
+    uint64_t history_entries;
+    uint64_t history_bytes;     // Written to the history file
+    uint64_t *forks_saved;      // --debug-forks only; see metrics_debug_forks()
+} Metrics;
+
+extern Metrics METRICS;
+
+// Listens on 'path', replacing a stale socket left there. Returns -1 after
+// printing an error.
+int metrics_start(const char *path);
+void metrics_stop(void);
+
+// Monotonic clock in seconds, for timing hot paths while enabled
+double metrics_clock(void);
+void metrics_observe_parse(double seconds);
+
+// --debug-forks: counts the forks the executor managed without, by exec'ing
+// the last command in place or running a subshell in the shell itself. The
+// counter lives in a shared page, so forked subshells add theirs too.
+void metrics_debug_forks(void);
+// Prints "forks saved: N" to stderr if counting
+void metrics_report_forks(void);
+
+static inline void metrics_fork_saved(void) {
+    if (METRICS.forks_saved) __atomic_add_fetch(METRICS.forks_saved, 1, __ATOMIC_RELAXED);
+}
+
+// Counts a stage exit status towards exec_failures
+static inline void metrics_stage_status(int status) {
+    if (status == 126 || status == 127) METRICS.exec_failures++;
+}
+
+#endif // METRICS_H
\ No newline at end of file
@@ -9,4 +9,34 @@ bool is_valid_syntax(const char *input);
 // Tokenizes a string into an array of arguments
 char **tokenize(char *input, int *argc);
 
+// Length of the $(...) starting at 's' including the closing parenthesis,
+// or 0 if it is not closed
+size_t substitution_len(const char *s);
+
+// strcspn() and strtok_r() that treat a $(...), <(...) or >(...) as part of
+// the current word, whatever it contains, and do not split on the '&' of >&
+// or <&
+size_t shell_strcspn(const char *s, const char *reject);
+char *shell_strtok(char *s, const char *delims, char **saveptr);
+
+// A growable list of heap-allocated strings
+typedef struct {
+    char **items;
+    int count;
+    int capacity;
+} WordList;
+
+void wordlist_push(WordList *list, char *word);
+void wordlist_free(WordList *list);
+
+// True for NAME=value words
+bool is_assignment(const char *word);
+
+// Expands $NAME, ${NAME}, $?, $$ and $(command) in 'word' and appends the result to
+// 'out'. With 'split', expansion results are split into separate fields on
+// blanks, fields that are glob patterns are replaced by the paths they
+// match, and a word that expands to nothing adds no field; without it
+// exactly one field is added.
+void expand_word(const char *word, bool split, WordList *out);
+
 #endif // PARSER_H
\ No newline at end of file
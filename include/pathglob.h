@@ -0,0 +1,27 @@
+#ifndef PATHGLOB_H
+#define PATHGLOB_H
+
+#include <stdbool.h>
+#include "parser.h"
+
+// Pathname expansion: '*', '?', '[...]' (with '!' or '^' to negate and
+// ranges) within a path component, and '**' as a whole component for any
+// number of directories. A leading '.' in a name is only matched by a
+// pattern component that starts with '.'.
+
+// True if 'word' contains an unescaped glob character
+bool glob_has_magic(const char *word);
+
+// Appends the paths matching 'pattern', sorted, to 'out'. Returns how many
+// were added; with none the caller keeps the word as it is.
+int glob_expand(const char *pattern, WordList *out);
+
+// Drops the cached directory listings. Listings are revalidated against
+// the directory's mtime on every use; this just bounds the memory they hold.
+void glob_cache_clear(void);
+
+// Matches one name against one pattern component. Runs in time
+// proportional to len(pattern) * len(name) without backtracking.
+bool glob_match(const char *pattern, const char *name);
+
+#endif // PATHGLOB_H
\ No newline at end of file
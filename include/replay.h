@@ -0,0 +1,35 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// Session capture and replay for measuring the shell's own latency.
+//
+// `shell.out --record FILE` appends one line per command entered:
+//   <unix time>\t<latency ms>\t<shell cpu ms>\t<exit status>\t<command>
+// `shell.out --replay FILE` runs the commands of such a file, or of a plain
+// ~/.cshell_log, without a prompt and prints latency percentiles per
+// command type to stderr.
+//
+// Latency is wall time from dispatch until the shell is ready for the next
+// command; for a background job that is the launch only. Shell CPU is the
+// user+system time of the shell process itself over the same span, i.e.
+// parsing, expansion, forking and in-process builtins, but not the work
+// of the commands it started.
+
+typedef struct {
+    double wall;
+    double cpu;
+    char *command;      // Copy of the line, NULL when not recording
+} ReplayMark;
+
+// Opens 'path' for appending records. Returns -1 after printing an error.
+int record_open(const char *path);
+
+// Bracket one command of the interactive loop; no-ops unless recording
+void record_begin(ReplayMark *mark, const char *command);
+void record_end(ReplayMark *mark);
+
+// Runs every command in 'path' and prints the report. Returns the exit
+// status for main().
+int replay_run(const char *path);
+
+#endif // REPLAY_H
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include "shell.h"
+
+// Compound commands (if/while/until/for/case) are compiled once into a
+// bytecode program whose pipelines are pre-parsed, then run by a small VM.
+typedef struct Program Program;
+
+typedef enum {
+    COMPILE_OK,
+    COMPILE_INCOMPLETE,   // Input ended inside an open construct
+    COMPILE_ERROR
+} CompileResult;
+
+// True if 'text' contains a reserved word in command position, i.e. it
+// needs script_compile() rather than process_line()
+bool script_is_compound(const char *text);
+
+// Compiles 'text'. On COMPILE_ERROR a message is printed unless 'quiet'.
+CompileResult script_compile(const char *text, bool quiet, Program **out);
+int script_run(Program *program);
+void script_free(Program *program);
+
+// Compiles and runs 'text', reporting syntax errors
+void script_execute(const char *text);
+
+#endif // SCRIPT_H
\ No newline at end of file
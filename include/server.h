@@ -0,0 +1,26 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+// Command server. `shell.out --server PATH` stays resident and listens on a
+// Unix domain socket, so one-off commands skip the shell's startup. A client
+// (tools/shell_client.c) sends one request per connection: a ServerRequest
+// carrying its stdin, stdout and stderr as SCM_RIGHTS, followed by the
+// payload. The server forks a copy of itself that runs the line in the
+// client's directory on the client's descriptors, and answers with the
+// exit status as an int32_t once that copy has exited.
+
+#define SERVER_MAGIC 0x63736801u        // Changes whenever the layout does
+#define SERVER_MAX_PAYLOAD (1 << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t payload_len;               // cwd and command line, NUL-terminated
+} ServerRequest;
+
+// Serves requests on 'path' until SIGTERM or SIGINT. Returns the process
+// exit status.
+int server_main(const char *path);
+
+#endif // SERVER_H
\ No newline at end of file
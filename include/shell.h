@@ -26,5 +26,9 @@ extern char PREVIOUS_CWD[PATH_MAX];
 // Global variable for the shell's process group ID
 extern pid_t SHELL_PGID;
 extern bool PREVIOUS_CWD_IS_SET;
+// Exit status of the most recently executed command
+extern int LAST_STATUS;
+// Set by the shell's SIGINT handler so long-running builtin work can stop
+extern volatile sig_atomic_t INTERRUPTED;
 
 #endif // SHELL_H
\ No newline at end of file
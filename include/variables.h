@@ -0,0 +1,42 @@
+#ifndef VARIABLES_H
+#define VARIABLES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Imports the process environment as exported variables and points
+// 'environ' at the shell's own envp array
+void vars_init(void);
+
+// Returns the value of 'name', or NULL if it is unset
+const char* var_get(const char *name);
+const char* var_get_n(const char *name, size_t len);
+
+// Creates or updates a variable. With 'export' set the variable is also
+// marked for export; an already exported variable stays exported.
+// Returns -1 if 'name' is not a valid identifier.
+int var_set(const char *name, const char *value, bool export);
+
+// Marks an existing variable for export, or records that 'name' should be
+// exported once it is assigned
+int var_export(const char *name);
+int var_unexport(const char *name);
+int var_unset(const char *name);
+
+// The exported variables as a NULL-terminated "NAME=value" array. The array
+// is patched in place when an exported variable changes, so handing it to
+// a child costs nothing. 'environ' always points at it.
+char** vars_envp(void);
+
+// PID of the shell itself, for $$ (unchanged in forked children)
+pid_t vars_shell_pid(void);
+
+// Valid shell identifier: [A-Za-z_][A-Za-z0-9_]*
+bool var_name_valid(const char *name, size_t len);
+
+// Builtins
+int do_export(char **args, int argc);
+int do_unset(char **args, int argc);
+
+#endif // VARIABLES_H
\ No newline at end of file
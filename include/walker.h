@@ -0,0 +1,22 @@
+#ifndef WALKER_H
+#define WALKER_H
+
+#include <stdbool.h>
+#include "dirlist.h"
+
+typedef struct {
+    bool show_all;      // Include and descend into entries starting with '.'
+    bool line_by_line;  // One entry per line instead of space separated
+    bool long_format;   // Mode, link count, size and mtime for each entry
+    SortKey sort_key;
+    int threads;        // Worker count, <= 0 picks one per online core
+} WalkOptions;
+
+// Recursively lists the tree rooted at 'root' using a pool of worker threads.
+// 'label' is the name printed for the root directory. Output is sorted per
+// directory and printed in depth-first order, so it does not depend on the
+// thread count. Returns 0 on success, -1 if the root could not be opened or
+// memory ran out, in which case nothing is printed.
+int walk_tree(const char *root, const char *label, const WalkOptions *opts);
+
+#endif // WALKER_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// Optional fork server. fork() in a large shell copies page tables in
+// proportion to its RSS, so external commands can instead be launched by a
+// helper that is a fresh exec of the shell binary and stays tiny. The
+// helper double-forks; with the shell a child subreaper, every command
+// ends up as the shell's own child and job control works unchanged.
+
+#define ZYGOTE_HELPER_FLAG "--fork-server-helper"
+#define ZYGOTE_MAX_FD 64         // Descriptors from here up are never passed
+
+// Spawns the helper. On failure the shell simply keeps forking itself.
+bool zygote_start(void);
+bool zygote_active(void);
+
+// Called before the shell's descriptor 'fd' is redirected: if the helper's
+// socket is 'fd', it moves to another number. Returns false if it cannot.
+bool zygote_vacate(int fd);
+
+// Turns the shell's child subreaper flag off before it execs another
+// program in its place, and back on if that exec failed
+void zygote_subreaper(bool on);
+
+// In a forked copy of the shell: stops using the helper without shutting
+// it down, since it still serves the parent. Commands are forked instead.
+void zygote_forget(void);
+
+// Launches argv[0] with the shell's environment and working directory and
+// every descriptor below ZYGOTE_MAX_FD that is open and not close-on-exec;
+// the command gets no other descriptor from 3 up.
+// The command joins process group 'pgid' (0: a new group of its own).
+// Returns the pid; *exec_error is the errno of a failed exec (the process
+// then exits with 127). Returns -1 if the caller should fork instead:
+// either there are more descriptors than one request can carry, or the
+// helper could not be reached, in which case it is shut down.
+pid_t zygote_spawn(char **argv, pid_t pgid, int *exec_error);
+
+// Main loop of the helper process
+int zygote_main(int sock);
+
+#endif // ZYGOTE_H
\ No newline at end of file
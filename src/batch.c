@@ -0,0 +1,116 @@
+#include "shell.h"
+#include "batch.h"
+
+// Kept free below ARG_MAX, as POSIX asks of xargs
+#define BATCH_HEADROOM 2048
+
+extern char **environ;
+
+static long arg_budget(void);
+static size_t arg_size(const char *arg);
+static void exec_stage(char **argv);
+
+void batch_clear(BatchSpec *spec) {
+    spec->enabled = false;
+    spec->parallel = 1;
+}
+
+int batch_parse(char **words, int count, BatchSpec *spec) {
+    int i = 0;
+    for (; i < count && words[i][0] == '-'; i++) {
+        if (strcmp(words[i], "-P") == 0 && i + 1 < count && atoi(words[i + 1]) >= 0) {
+            spec->parallel = atoi(words[++i]);
+            // -P 0: one batch per online CPU
+            if (spec->parallel == 0) spec->parallel = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (spec->parallel < 1) spec->parallel = 1;
+        } else {
+            fprintf(stderr, "batch: %s: invalid option\n", words[i]);
+            return -1;
+        }
+    }
+    if (i == count) {
+        fprintf(stderr, "batch: usage: batch [-P n] command [args...]\n");
+        return -1;
+    }
+    spec->enabled = true;
+    return i;
+}
+
+int batch_exec(char **argv, int argc, int fixed, const BatchSpec *spec) {
+    long budget = arg_budget();
+    if (fixed < 1) fixed = 1;
+    if (fixed > argc) fixed = argc;
+    size_t fixed_size = 0, total = 0;
+    for (int i = 0; i < argc; i++) {
+        total += arg_size(argv[i]);
+        if (i < fixed) fixed_size += arg_size(argv[i]);
+    }
+    if ((long)total <= budget) exec_stage(argv);
+
+    char **batch = malloc(sizeof(char *) * (argc + 1));
+    if (!batch) { perror("malloc"); return 1; }
+    memcpy(batch, argv, sizeof(char *) * fixed);
+
+    int next = fixed, running = 0, status = 0;
+    bool stop = false;
+    while ((next < argc && !stop) || running > 0) {
+        if (next < argc && !stop && running < spec->parallel) {
+            // Always at least one argument, even if it alone is too big;
+            // execvp() then reports E2BIG for that batch
+            int n = fixed;
+            size_t size = fixed_size;
+            while (next < argc && (n == fixed || (long)(size + arg_size(argv[next])) <= budget)) {
+                size += arg_size(argv[next]);
+                batch[n++] = argv[next++];
+            }
+            batch[n] = NULL;
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) exec_stage(batch);
+            if (pid < 0) {
+                perror("fork");
+                status = status > 1 ? status : 1;
+                stop = true;
+            } else {
+                running++;
+            }
+            continue;
+        }
+
+        int child_status;
+        if (wait(&child_status) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        running--;
+        int code = WIFEXITED(child_status) ? WEXITSTATUS(child_status) : 128 + WTERMSIG(child_status);
+        if (code == 126 || code == 127) stop = true;
+        if (code > status) status = code;
+    }
+    free(batch);
+    return status;
+}
+
+// Bytes a string costs in the exec image: the string itself and its pointer
+static size_t arg_size(const char *arg) {
+    return strlen(arg) + 1 + sizeof(char *);
+}
+
+// What is left of ARG_MAX once the environment has been passed along
+static long arg_budget(void) {
+    long budget = sysconf(_SC_ARG_MAX);
+    if (budget <= 0) budget = _POSIX_ARG_MAX;
+    budget -= BATCH_HEADROOM + sizeof(char *);
+    for (char **e = environ; e && *e; e++) budget -= arg_size(*e);
+    return budget;
+}
+
+static void exec_stage(char **argv) {
+    execvp(argv[0], argv);
+    if (errno == ENOENT) {
+        fprintf(stderr, "%s: Command not found!\n", argv[0]);
+        _exit(127);
+    }
+    fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+    _exit(126);
+}
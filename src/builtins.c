@@ -0,0 +1,124 @@
+#include "shell.h"
+#include "builtins.h"
+#include "intrinsics.h"
+#include "jobs.h"
+#include "coreutils.h"
+#include "filters.h"
+#include "variables.h"
+#include "executor.h"
+#include "jobsched.h"
+
+#include <dlfcn.h>
+
+// Generated from src/builtins.def by tools/gen_builtins
+#include "builtin_table.h"
+
+#define MAX_LOADED_BUILTINS 64
+
+// Builtins loaded at runtime with `enable -f`. These are consulted before the
+// static table so that a module can replace a builtin, but only when at
+// least one is loaded, so the common lookup stays a single probe.
+typedef struct {
+    Builtin builtin;
+    char *name;
+    void *handle;
+} LoadedBuiltin;
+
+static LoadedBuiltin loaded[MAX_LOADED_BUILTINS];
+static int loaded_count = 0;
+
+static int enable_load(const char *library, const char *name);
+static int enable_delete(const char *name);
+static void enable_list(void);
+
+const Builtin* builtin_lookup(const char *name) {
+    if (!name) return NULL;
+    for (int i = 0; i < loaded_count; i++) {
+        if (strcmp(loaded[i].name, name) == 0) return &loaded[i].builtin;
+    }
+    const Builtin *b = &builtin_table[builtin_hash(name, BUILTIN_HASH_SEED) & BUILTIN_TABLE_MASK];
+    if (b->name && strcmp(b->name, name) == 0) return b;
+    return NULL;
+}
+
+int do_enable(char **args, int argc) {
+    const char *library = NULL;
+    bool delete = false;
+    int i = 1;
+    for (; i < argc && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-f") == 0 && i + 1 < argc) library = args[++i];
+        else if (strcmp(args[i], "-d") == 0) delete = true;
+        else { fprintf(stderr, "enable: usage: enable [-f library] [-d] [name ...]\n"); return 2; }
+    }
+    if (i == argc) {
+        if (library || delete) { fprintf(stderr, "enable: missing builtin name\n"); return 2; }
+        enable_list();
+        return 0;
+    }
+
+    int status = 0;
+    for (; i < argc; i++) {
+        if (delete) {
+            if (enable_delete(args[i]) != 0) {
+                fprintf(stderr, "enable: %s: not a loaded builtin\n", args[i]);
+                status = 1;
+            }
+        } else if (library) {
+            status |= enable_load(library, args[i]);
+        } else if (!builtin_lookup(args[i])) {
+            fprintf(stderr, "enable: %s: not a shell builtin\n", args[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+static int enable_load(const char *library, const char *name) {
+    if (loaded_count == MAX_LOADED_BUILTINS) {
+        fprintf(stderr, "enable: too many loaded builtins\n");
+        return 1;
+    }
+    void *handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) { fprintf(stderr, "enable: %s\n", dlerror()); return 1; }
+
+    char symbol[256];
+    snprintf(symbol, sizeof(symbol), "%s_builtin", name);
+    BuiltinFn fn;
+    // POSIX guarantees dlsym() results convert to function pointers
+    *(void **)(&fn) = dlsym(handle, symbol);
+    if (!fn) {
+        fprintf(stderr, "enable: %s: no symbol %s\n", library, symbol);
+        dlclose(handle);
+        return 1;
+    }
+    snprintf(symbol, sizeof(symbol), "%s_builtin_flags", name);
+    const unsigned *flags = dlsym(handle, symbol);
+
+    enable_delete(name); // Reloading replaces the previous module silently
+    LoadedBuiltin *lb = &loaded[loaded_count++];
+    lb->name = strdup(name);
+    lb->handle = handle;
+    lb->builtin.name = lb->name;
+    lb->builtin.fn = fn;
+    lb->builtin.flags = flags ? *flags : BUILTIN_PIPELINE;
+    return 0;
+}
+
+static int enable_delete(const char *name) {
+    for (int i = 0; i < loaded_count; i++) {
+        if (strcmp(loaded[i].name, name) == 0) {
+            dlclose(loaded[i].handle);
+            free(loaded[i].name);
+            loaded[i] = loaded[--loaded_count];
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void enable_list(void) {
+    for (size_t i = 0; i < sizeof(builtin_table) / sizeof(builtin_table[0]); i++) {
+        if (builtin_table[i].name) printf("enable %s\n", builtin_table[i].name);
+    }
+    for (int i = 0; i < loaded_count; i++) printf("enable -f %s\n", loaded[i].name);
+}
\ No newline at end of file
@@ -0,0 +1,405 @@
+#include "shell.h"
+#include "coreutils.h"
+
+#include <ctype.h>
+
+static bool write_escape(const char **p, bool echo_style);
+static bool write_escaped(const char *s, bool echo_style);
+static int printf_once(const char *fmt, char **args, int argc, int *argi, bool *stop);
+static bool printf_int_arg(const char *arg, long long *out);
+static int check_output(const char *name, int status);
+static int test_expr(char **av, int ac);
+static int test_or(char **av, int ac, int *pos);
+static int test_and(char **av, int ac, int *pos);
+static int test_not(char **av, int ac, int *pos);
+static int test_primary(char **av, int ac, int *pos);
+static bool is_unary_op(const char *op);
+static bool is_binary_op(const char *op);
+static int test_unary(const char *op, const char *arg);
+static int test_binary(const char *lhs, const char *op, const char *rhs);
+
+int do_true(char **args, int argc) { return 0; }
+
+int do_false(char **args, int argc) { return 1; }
+
+int do_pwd(char **args, int argc) {
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) { perror("pwd"); return 1; }
+    puts(cwd);
+    return check_output("pwd", 0);
+}
+
+// echo [-neE] [string ...]
+int do_echo(char **args, int argc) {
+    bool newline = true, escapes = false;
+    int i = 1;
+    // Like bash, only a word made up entirely of option letters is an option
+    for (; i < argc && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        if (strspn(args[i] + 1, "neE") != strlen(args[i] + 1)) break;
+        for (const char *c = args[i] + 1; *c; c++) {
+            if (*c == 'n') newline = false;
+            else if (*c == 'e') escapes = true;
+            else escapes = false;
+        }
+    }
+    for (; i < argc; i++) {
+        if (escapes) {
+            if (write_escaped(args[i], true)) return check_output("echo", 0);
+        } else {
+            fputs(args[i], stdout);
+        }
+        if (i + 1 < argc) putchar(' ');
+    }
+    if (newline) putchar('\n');
+    return check_output("echo", 0);
+}
+
+// Builtins write through the shell's own stdout, so output stays buffered
+// and a failed write (a full disk, a closed pipe) shows up as the stream's
+// error flag, here or when the buffer is flushed. The flag is cleared
+// because the stream outlives the command.
+static int check_output(const char *name, int status) {
+    if (!ferror(stdout)) return status;
+    fprintf(stderr, "%s: write error: %s\n", name, strerror(errno));
+    clearerr(stdout);
+    return 1;
+}
+
+int builtin_flush(const char *name, int status) {
+    fflush(stdout);
+    return check_output(name, status);
+}
+
+// Writes the escape sequence at *p (just past the backslash) and advances
+// *p. Returns true for \c, which stops all further output.
+static bool write_escape(const char **p, bool echo_style) {
+    const char *s = *p;
+    int c = *s++;
+    switch (c) {
+        case 'a': putchar('\a'); break;
+        case 'b': putchar('\b'); break;
+        case 'c': *p = s; return true;
+        case 'e': putchar(033); break;
+        case 'f': putchar('\f'); break;
+        case 'n': putchar('\n'); break;
+        case 'r': putchar('\r'); break;
+        case 't': putchar('\t'); break;
+        case 'v': putchar('\v'); break;
+        case '\\': putchar('\\'); break;
+        case '\0': putchar('\\'); s--; break;
+        default:
+            if (c >= '0' && c <= '7') {
+                // echo spells octal as \0nnn; printf as \nnn
+                int value = 0, digits = 0;
+                if (echo_style && c == '0') c = (*s >= '0' && *s <= '7') ? *s++ : '0';
+                value = c - '0';
+                while (++digits < 3 && *s >= '0' && *s <= '7') value = value * 8 + (*s++ - '0');
+                putchar(value);
+            } else {
+                putchar('\\');
+                putchar(c);
+            }
+    }
+    *p = s;
+    return false;
+}
+
+static bool write_escaped(const char *s, bool echo_style) {
+    while (*s) {
+        if (*s != '\\') { putchar(*s++); continue; }
+        s++;
+        if (write_escape(&s, echo_style)) return true;
+    }
+    return false;
+}
+
+// printf format [argument ...]
+// The format is reused until every argument has been consumed.
+int do_printf(char **args, int argc) {
+    if (argc < 2) { fprintf(stderr, "printf: usage: printf format [arguments]\n"); return 2; }
+    int argi = 2, status = 0;
+    bool stop = false;
+    do {
+        int before = argi;
+        status |= printf_once(args[1], args, argc, &argi, &stop);
+        if (stop || argi == before) break;
+    } while (argi < argc);
+    return check_output("printf", status);
+}
+
+static int printf_once(const char *fmt, char **args, int argc, int *argi, bool *stop) {
+    int status = 0;
+    const char *p = fmt;
+    while (*p) {
+        if (*p == '\\') {
+            p++;
+            if (write_escape(&p, false)) { *stop = true; return status; }
+            continue;
+        }
+        if (*p != '%') { putchar(*p++); continue; }
+        if (p[1] == '%') { putchar('%'); p += 2; continue; }
+
+        // Rebuild the conversion with an explicit 'll' length so every
+        // integer argument can be passed as long long
+        char spec[64];
+        size_t n = 0;
+        spec[n++] = *p++;
+        while (*p && strchr("-+ #0", *p) && n < 16) spec[n++] = *p++;
+        if (*p == '*') {
+            const char *arg = *argi < argc ? args[(*argi)++] : "0";
+            n += snprintf(spec + n, sizeof(spec) - n, "%d", atoi(arg));
+            p++;
+        } else {
+            while (isdigit((unsigned char)*p) && n < 32) spec[n++] = *p++;
+        }
+        if (*p == '.') {
+            spec[n++] = *p++;
+            if (*p == '*') {
+                const char *arg = *argi < argc ? args[(*argi)++] : "0";
+                n += snprintf(spec + n, sizeof(spec) - n, "%d", atoi(arg));
+                p++;
+            } else {
+                while (isdigit((unsigned char)*p) && n < 48) spec[n++] = *p++;
+            }
+        }
+
+        char conv = *p;
+        if (conv == '\0') { fprintf(stderr, "printf: missing format character\n"); return 1; }
+        p++;
+        const char *arg = *argi < argc ? args[(*argi)++] : NULL;
+
+        switch (conv) {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': {
+                long long value = 0;
+                if (arg && !printf_int_arg(arg, &value)) {
+                    fprintf(stderr, "printf: %s: invalid number\n", arg);
+                    status = 1;
+                }
+                spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+                if (conv == 'd' || conv == 'i') printf(spec, value);
+                else printf(spec, (unsigned long long)value);
+                break;
+            }
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                double value = 0;
+                if (arg) {
+                    char *end;
+                    value = strtod(arg, &end);
+                    if (*arg == '\0' || *end != '\0') {
+                        fprintf(stderr, "printf: %s: invalid number\n", arg);
+                        status = 1;
+                    }
+                }
+                spec[n++] = conv; spec[n] = '\0';
+                printf(spec, value);
+                break;
+            }
+            case 'c': {
+                // Printed as a one-character string, so a missing or empty
+                // argument writes nothing (just the padding) instead of a NUL
+                char c[2] = { arg ? arg[0] : '\0', '\0' };
+                spec[n++] = 's'; spec[n] = '\0';
+                printf(spec, c);
+                break;
+            }
+            case 's':
+                spec[n++] = 's'; spec[n] = '\0';
+                printf(spec, arg ? arg : "");
+                break;
+            case 'b':
+                if (arg && write_escaped(arg, true)) { *stop = true; return status; }
+                break;
+            default:
+                fprintf(stderr, "printf: %%%c: invalid directive\n", conv);
+                return 1;
+        }
+    }
+    return status;
+}
+
+// Accepts decimal, octal and hex, plus POSIX's 'c / "c character codes
+static bool printf_int_arg(const char *arg, long long *out) {
+    if (arg[0] == '\'' || arg[0] == '"') {
+        *out = (unsigned char)arg[1];
+        return true;
+    }
+    char *end;
+    errno = 0;
+    *out = strtoll(arg, &end, 0);
+    return *arg != '\0' && *end == '\0' && errno == 0;
+}
+
+// test expression / [ expression ]
+// Returns 0 for true, 1 for false and 2 for a malformed expression.
+int do_test(char **args, int argc) {
+    if (strcmp(args[0], "[") == 0) {
+        if (argc < 2 || strcmp(args[argc - 1], "]") != 0) {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        argc--;
+    }
+    return test_expr(args + 1, argc - 1);
+}
+
+// POSIX fixes the meaning of up to four arguments by count, which resolves
+// cases such as `test -n` or `test ! = x`; anything longer is parsed as a
+// general expression with -a, -o, ! and parentheses.
+static int test_expr(char **av, int ac) {
+    switch (ac) {
+        case 0:
+            return 1;
+        case 1:
+            return av[0][0] != '\0' ? 0 : 1;
+        case 2:
+            if (strcmp(av[0], "!") == 0) return av[1][0] != '\0' ? 1 : 0;
+            if (is_unary_op(av[0])) return test_unary(av[0], av[1]);
+            break;
+        case 3:
+            if (is_binary_op(av[1])) return test_binary(av[0], av[1], av[2]);
+            if (strcmp(av[0], "!") == 0) { int r = test_expr(av + 1, 2); return r == 2 ? 2 : !r; }
+            if (strcmp(av[0], "(") == 0 && strcmp(av[2], ")") == 0) return test_expr(av + 1, 1);
+            break;
+        case 4:
+            if (strcmp(av[0], "!") == 0) { int r = test_expr(av + 1, 3); return r == 2 ? 2 : !r; }
+            if (strcmp(av[0], "(") == 0 && strcmp(av[3], ")") == 0) return test_expr(av + 1, 2);
+            break;
+    }
+    int pos = 0;
+    int result = test_or(av, ac, &pos);
+    if (result != 2 && pos != ac) {
+        fprintf(stderr, "test: %s: unexpected argument\n", av[pos]);
+        return 2;
+    }
+    return result;
+}
+
+static int test_or(char **av, int ac, int *pos) {
+    int result = test_and(av, ac, pos);
+    while (result != 2 && *pos < ac && strcmp(av[*pos], "-o") == 0) {
+        (*pos)++;
+        int rhs = test_and(av, ac, pos);
+        if (rhs == 2) return 2;
+        result = (result == 0 || rhs == 0) ? 0 : 1;
+    }
+    return result;
+}
+
+static int test_and(char **av, int ac, int *pos) {
+    int result = test_not(av, ac, pos);
+    while (result != 2 && *pos < ac && strcmp(av[*pos], "-a") == 0) {
+        (*pos)++;
+        int rhs = test_not(av, ac, pos);
+        if (rhs == 2) return 2;
+        result = (result == 0 && rhs == 0) ? 0 : 1;
+    }
+    return result;
+}
+
+static int test_not(char **av, int ac, int *pos) {
+    if (*pos < ac && strcmp(av[*pos], "!") == 0) {
+        (*pos)++;
+        int result = test_not(av, ac, pos);
+        return result == 2 ? 2 : !result;
+    }
+    return test_primary(av, ac, pos);
+}
+
+static int test_primary(char **av, int ac, int *pos) {
+    if (*pos >= ac) { fprintf(stderr, "test: argument expected\n"); return 2; }
+    if (strcmp(av[*pos], "(") == 0) {
+        (*pos)++;
+        int result = test_or(av, ac, pos);
+        if (result == 2) return 2;
+        if (*pos >= ac || strcmp(av[*pos], ")") != 0) { fprintf(stderr, "test: missing ')'\n"); return 2; }
+        (*pos)++;
+        return result;
+    }
+    if (*pos + 2 < ac && is_binary_op(av[*pos + 1])) {
+        int result = test_binary(av[*pos], av[*pos + 1], av[*pos + 2]);
+        *pos += 3;
+        return result;
+    }
+    if (*pos + 1 < ac && is_unary_op(av[*pos])) {
+        int result = test_unary(av[*pos], av[*pos + 1]);
+        *pos += 2;
+        return result;
+    }
+    return av[(*pos)++][0] != '\0' ? 0 : 1;
+}
+
+static bool is_unary_op(const char *op) {
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("bcdefghknprsStuwxzLO", op[1]);
+}
+
+static bool is_binary_op(const char *op) {
+    static const char *ops[] = { "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le",
+                                 "-gt", "-ge", "-nt", "-ot", "-ef", NULL };
+    for (int i = 0; ops[i]; i++) if (strcmp(op, ops[i]) == 0) return true;
+    return false;
+}
+
+static int test_unary(const char *op, const char *arg) {
+    struct stat st;
+    switch (op[1]) {
+        case 'z': return arg[0] == '\0' ? 0 : 1;
+        case 'n': return arg[0] != '\0' ? 0 : 1;
+        case 't': return isatty(atoi(arg)) ? 0 : 1;
+        case 'r': return access(arg, R_OK) == 0 ? 0 : 1;
+        case 'w': return access(arg, W_OK) == 0 ? 0 : 1;
+        case 'x': return access(arg, X_OK) == 0 ? 0 : 1;
+        case 'h': case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode) ? 0 : 1;
+    }
+    if (stat(arg, &st) != 0) return 1;
+    switch (op[1]) {
+        case 'e': return 0;
+        case 'f': return S_ISREG(st.st_mode) ? 0 : 1;
+        case 'd': return S_ISDIR(st.st_mode) ? 0 : 1;
+        case 'b': return S_ISBLK(st.st_mode) ? 0 : 1;
+        case 'c': return S_ISCHR(st.st_mode) ? 0 : 1;
+        case 'p': return S_ISFIFO(st.st_mode) ? 0 : 1;
+        case 'S': return S_ISSOCK(st.st_mode) ? 0 : 1;
+        case 's': return st.st_size > 0 ? 0 : 1;
+        case 'g': return (st.st_mode & S_ISGID) ? 0 : 1;
+        case 'u': return (st.st_mode & S_ISUID) ? 0 : 1;
+        case 'k': return (st.st_mode & S_ISVTX) ? 0 : 1;
+        case 'O': return st.st_uid == geteuid() ? 0 : 1;
+    }
+    return 2;
+}
+
+static int test_binary(const char *lhs, const char *op, const char *rhs) {
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(lhs, rhs) == 0 ? 0 : 1;
+    if (strcmp(op, "!=") == 0) return strcmp(lhs, rhs) != 0 ? 0 : 1;
+    if (strcmp(op, "<") == 0) return strcmp(lhs, rhs) < 0 ? 0 : 1;
+    if (strcmp(op, ">") == 0) return strcmp(lhs, rhs) > 0 ? 0 : 1;
+
+    if (op[1] == 'n' || op[1] == 'o' || (op[1] == 'e' && op[2] == 'f')) {
+        struct stat a, b;
+        bool have_a = stat(lhs, &a) == 0, have_b = stat(rhs, &b) == 0;
+        if (strcmp(op, "-ef") == 0) return have_a && have_b && a.st_dev == b.st_dev && a.st_ino == b.st_ino ? 0 : 1;
+        if (strcmp(op, "-nt") == 0) {
+            if (!have_a) return 1;
+            if (!have_b) return 0;
+            return (a.st_mtim.tv_sec > b.st_mtim.tv_sec ||
+                    (a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec > b.st_mtim.tv_nsec)) ? 0 : 1;
+        }
+        if (!have_b) return 1;
+        if (!have_a) return 0;
+        return (a.st_mtim.tv_sec < b.st_mtim.tv_sec ||
+                (a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec < b.st_mtim.tv_nsec)) ? 0 : 1;
+    }
+
+    long long x, y;
+    char *end;
+    x = strtoll(lhs, &end, 10);
+    if (*lhs == '\0' || *end != '\0') { fprintf(stderr, "test: %s: integer expression expected\n", lhs); return 2; }
+    y = strtoll(rhs, &end, 10);
+    if (*rhs == '\0' || *end != '\0') { fprintf(stderr, "test: %s: integer expression expected\n", rhs); return 2; }
+    if (strcmp(op, "-eq") == 0) return x == y ? 0 : 1;
+    if (strcmp(op, "-ne") == 0) return x != y ? 0 : 1;
+    if (strcmp(op, "-lt") == 0) return x < y ? 0 : 1;
+    if (strcmp(op, "-le") == 0) return x <= y ? 0 : 1;
+    if (strcmp(op, "-gt") == 0) return x > y ? 0 : 1;
+    return x >= y ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,254 @@
+// MAP_POPULATE needs the default feature set; _GNU_SOURCE is avoided so that
+// glibc's struct statx does not clash with the one from <linux/stat.h>
+#define _DEFAULT_SOURCE
+
+#include "shell.h"
+#include "dirlist.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+
+#define STAT_RING_ENTRIES 256
+
+struct StatRing {
+    int fd;
+    unsigned sq_entries, cq_entries;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_len, cq_ring_len, sqes_len;
+    bool broken;        // Requests were left in flight; fstatat() from now on
+};
+
+static void stat_entry_sync(int dir_fd, DirEntry *entry);
+static bool stat_entries_uring(StatRing *ring, int dir_fd, DirEntry *entries, int count);
+static int compare_by_name(const void *a, const void *b);
+static int compare_by_size(const void *a, const void *b);
+static int compare_by_mtime(const void *a, const void *b);
+static void format_mode(mode_t mode, char *out);
+
+StatRing* stat_ring_open(void) {
+    if (getenv("REVEAL_NO_URING")) return NULL;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, STAT_RING_ENTRIES, &params);
+    if (fd < 0) return NULL;
+
+    StatRing *ring = calloc(1, sizeof(StatRing));
+    if (!ring) { close(fd); return NULL; }
+    ring->fd = fd;
+    ring->sq_entries = params.sq_entries;
+    ring->cq_entries = params.cq_entries;
+    ring->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && ring->cq_ring_len > ring->sq_ring_len) ring->sq_ring_len = ring->cq_ring_len;
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) { ring->sq_ring = NULL; stat_ring_close(ring); return NULL; }
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) { ring->cq_ring = NULL; stat_ring_close(ring); return NULL; }
+    }
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) { ring->sqes = NULL; stat_ring_close(ring); return NULL; }
+
+    char *sq = ring->sq_ring, *cq = ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return ring;
+}
+
+void stat_ring_close(StatRing *ring) {
+    if (!ring) return;
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_len);
+    if (ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_len);
+    close(ring->fd);
+    free(ring);
+}
+
+void stat_entries(StatRing *ring, int dir_fd, DirEntry *entries, int count) {
+    if (ring && !ring->broken && stat_entries_uring(ring, dir_fd, entries, count)) return;
+    for (int i = 0; i < count; i++) stat_entry_sync(dir_fd, &entries[i]);
+}
+
+static void stat_entry_sync(int dir_fd, DirEntry *entry) {
+    struct stat st;
+    if (fstatat(dir_fd, entry->name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        entry->meta.valid = false;
+        return;
+    }
+    entry->meta.mode = st.st_mode;
+    entry->meta.nlink = st.st_nlink;
+    entry->meta.size = st.st_size;
+    entry->meta.mtime = st.st_mtim;
+    entry->meta.valid = true;
+}
+
+// Submits the batch in rounds of at most one ring's worth of statx requests
+// and waits for each round to complete, so no completion is ever left for a
+// later batch to find. Returns false if the ring failed before consuming
+// anything, in which case the caller redoes the batch.
+static bool stat_entries_uring(StatRing *ring, int dir_fd, DirEntry *entries, int count) {
+    struct statx *bufs = malloc(count * sizeof(struct statx));
+    if (!bufs) return false;
+
+    int next = 0;
+    while (next < count) {
+        unsigned round = (unsigned)(count - next);
+        if (round > ring->sq_entries) round = ring->sq_entries;
+        if (round > ring->cq_entries) round = ring->cq_entries;
+
+        unsigned tail = *ring->sq_tail;
+        for (unsigned i = 0; i < round; i++) {
+            int e = next + (int)i;
+            unsigned idx = (tail + i) & *ring->sq_mask;
+            struct io_uring_sqe *sqe = &ring->sqes[idx];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dir_fd;
+            sqe->addr = (unsigned long)entries[e].name;
+            sqe->len = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_SIZE | STATX_MTIME;
+            sqe->off = (unsigned long)&bufs[e];
+            sqe->statx_flags = AT_SYMLINK_NOFOLLOW;
+            sqe->user_data = (unsigned long)e;
+            ring->sq_array[idx] = idx;
+        }
+        __atomic_store_n(ring->sq_tail, tail + round, __ATOMIC_RELEASE);
+
+        unsigned unsubmitted = round, inflight = round;
+        while (inflight > 0) {
+            int ret = (int)syscall(__NR_io_uring_enter, ring->fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            if (ret < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                if (unsubmitted == 0) {
+                    // Requests are in flight but cannot be waited for. They
+                    // may still write into 'bufs' and post completions, so
+                    // neither the buffers nor the ring are used again.
+                    ring->broken = true;
+                    for (int i = next; i < count; i++) stat_entry_sync(dir_fd, &entries[i]);
+                    return true;
+                }
+                // The kernel never saw the unsubmitted tail of the round, so
+                // take it back and stat those entries synchronously. What
+                // it did take is still waited for by the next pass.
+                __atomic_store_n(ring->sq_tail, *ring->sq_tail - unsubmitted, __ATOMIC_RELEASE);
+                if (next == 0 && unsubmitted == round) { free(bufs); return false; }
+                for (unsigned i = round - unsubmitted; i < round; i++) stat_entry_sync(dir_fd, &entries[next + i]);
+                inflight -= unsubmitted;
+                unsubmitted = 0;
+                continue;
+            }
+            unsubmitted -= (unsigned)ret;
+
+            unsigned cq_head = *ring->cq_head;
+            while (cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+                struct io_uring_cqe *cqe = &ring->cqes[cq_head & *ring->cq_mask];
+                DirEntry *entry = &entries[cqe->user_data];
+                if (cqe->res == 0) {
+                    struct statx *stx = &bufs[cqe->user_data];
+                    entry->meta.mode = stx->stx_mode;
+                    entry->meta.nlink = stx->stx_nlink;
+                    entry->meta.size = (off_t)stx->stx_size;
+                    entry->meta.mtime.tv_sec = stx->stx_mtime.tv_sec;
+                    entry->meta.mtime.tv_nsec = stx->stx_mtime.tv_nsec;
+                    entry->meta.valid = true;
+                } else if (cqe->res == -ENOENT) {
+                    entry->meta.valid = false;
+                } else {
+                    // E.g. -EINVAL from kernels without IORING_OP_STATX
+                    stat_entry_sync(dir_fd, entry);
+                }
+                cq_head++;
+                inflight--;
+            }
+            __atomic_store_n(ring->cq_head, cq_head, __ATOMIC_RELEASE);
+        }
+        next += (int)round;
+    }
+
+    free(bufs);
+    return true;
+}
+
+void sort_entries(DirEntry *entries, int count, SortKey key) {
+    int (*cmp)(const void *, const void *) = compare_by_name;
+    if (key == SORT_SIZE) cmp = compare_by_size;
+    else if (key == SORT_MTIME) cmp = compare_by_mtime;
+    qsort(entries, count, sizeof(DirEntry), cmp);
+}
+
+void print_entries(const DirEntry *entries, int count, bool line_by_line, bool long_format) {
+    if (long_format) {
+        for (int i = 0; i < count; i++) {
+            const EntryMeta *m = &entries[i].meta;
+            if (!m->valid) {
+                printf("?????????? %3s %10s %12s %s\n", "?", "?", "?", entries[i].name);
+                continue;
+            }
+            char mode[11], when[32];
+            format_mode(m->mode, mode);
+            time_t secs = m->mtime.tv_sec;
+            struct tm tm;
+            localtime_r(&secs, &tm);
+            strftime(when, sizeof(when), "%b %e %H:%M", &tm);
+            printf("%s %3lu %10lld %12s %s\n", mode, (unsigned long)m->nlink,
+                   (long long)m->size, when, entries[i].name);
+        }
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        printf("%s%s", entries[i].name, line_by_line ? "\n" : "  ");
+    }
+    if (!line_by_line && count > 0) printf("\n");
+}
+
+static void format_mode(mode_t mode, char *out) {
+    char type = '-';
+    if (S_ISDIR(mode)) type = 'd';
+    else if (S_ISLNK(mode)) type = 'l';
+    else if (S_ISCHR(mode)) type = 'c';
+    else if (S_ISBLK(mode)) type = 'b';
+    else if (S_ISFIFO(mode)) type = 'p';
+    else if (S_ISSOCK(mode)) type = 's';
+    out[0] = type;
+    const char *rwx = "rwxrwxrwx";
+    for (int i = 0; i < 9; i++) out[i + 1] = (mode & (0400 >> i)) ? rwx[i] : '-';
+    out[10] = '\0';
+}
+
+static int compare_by_name(const void *a, const void *b) {
+    return strcmp(((const DirEntry *)a)->name, ((const DirEntry *)b)->name);
+}
+
+static int compare_by_size(const void *a, const void *b) {
+    const DirEntry *x = a, *y = b;
+    if (x->meta.size != y->meta.size) return x->meta.size < y->meta.size ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static int compare_by_mtime(const void *a, const void *b) {
+    const DirEntry *x = a, *y = b;
+    if (x->meta.mtime.tv_sec != y->meta.mtime.tv_sec) return x->meta.mtime.tv_sec < y->meta.mtime.tv_sec ? 1 : -1;
+    if (x->meta.mtime.tv_nsec != y->meta.mtime.tv_nsec) return x->meta.mtime.tv_nsec < y->meta.mtime.tv_nsec ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
\ No newline at end of file
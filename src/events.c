@@ -0,0 +1,94 @@
+#include "shell.h"
+#include "events.h"
+
+#include <poll.h>
+#include <sys/signalfd.h>
+
+#define MAX_EVENTS 64
+
+typedef struct {
+    int fd;
+    EventHandler handler;
+    void *data;
+} Event;
+
+static Event events[MAX_EVENTS];
+static int event_count = 0;
+static int sigchld_fd = -1;
+
+static int poll_events(int extra_fd, int timeout_ms);
+
+bool events_add(int fd, EventHandler handler, void *data) {
+    if (event_count == MAX_EVENTS) return false;
+    events[event_count++] = (Event){ fd, handler, data };
+    return true;
+}
+
+void events_remove(int fd) {
+    for (int i = 0; i < event_count; i++) {
+        if (events[i].fd == fd) {
+            events[i] = events[--event_count];
+            return;
+        }
+    }
+}
+
+void events_dispatch(void) {
+    if (event_count > 0) poll_events(-1, 0);
+}
+
+int events_wait_readable(int fd) {
+    int ready;
+    while ((ready = poll_events(fd, -1)) == 0);
+    return ready < 0 ? -1 : 0;
+}
+
+// SIGCHLD is blocked for the duration and read from a signalfd, so a child
+// changing state between the WNOHANG check and poll() is not missed
+pid_t events_waitpid(pid_t pid, int *status, int options) {
+    if (event_count == 0) return waitpid(pid, status, options);
+
+    sigset_t chld, old;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+    if (sigchld_fd < 0) sigchld_fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    pid_t result;
+    while ((result = waitpid(pid, status, options | WNOHANG)) == 0) {
+        if (sigchld_fd < 0) { result = waitpid(pid, status, options); break; }
+        int ready = poll_events(sigchld_fd, -1);
+        if (ready < 0) { result = -1; break; }
+        struct signalfd_siginfo info;
+        while (read(sigchld_fd, &info, sizeof(info)) > 0);
+    }
+
+    int saved_errno = errno;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    errno = saved_errno;
+    return result;
+}
+
+// Polls every registered descriptor plus 'extra_fd' (if >= 0) and runs the
+// handlers of the ready ones. Returns 1 if 'extra_fd' is readable, 0 if not,
+// -1 on error.
+static int poll_events(int extra_fd, int timeout_ms) {
+    struct pollfd fds[MAX_EVENTS + 1];
+    int count = event_count;
+    for (int i = 0; i < count; i++) fds[i] = (struct pollfd){ events[i].fd, POLLIN, 0 };
+    if (extra_fd >= 0) fds[count] = (struct pollfd){ extra_fd, POLLIN, 0 };
+
+    if (poll(fds, count + (extra_fd >= 0), timeout_ms) < 0) return -1;
+
+    // Handlers may add or remove events, so look each one up again
+    for (int i = 0; i < count; i++) {
+        if (!fds[i].revents) continue;
+        for (int j = 0; j < event_count; j++) {
+            if (events[j].fd == fds[i].fd) {
+                events[j].handler(events[j].fd, events[j].data);
+                break;
+            }
+        }
+    }
+    return extra_fd >= 0 && fds[count].revents ? 1 : 0;
+}
\ No newline at end of file
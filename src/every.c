@@ -0,0 +1,185 @@
+// memfd_create
+#define _GNU_SOURCE
+
+#include "shell.h"
+#include "every.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+typedef struct {
+    int runs;
+    uint64_t missed;        // Ticks that passed while a run was still going
+    double latency_sum, latency_min, latency_max;
+    double drift_sum, drift_max;
+} EveryStats;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop(int sig) { (void)sig; stop_requested = 1; }
+static double now_seconds(void);
+static char* read_output(int fd, size_t *len);
+static void print_changes(const char *old, size_t old_len, const char *new, size_t new_len);
+static const char* next_line(const char *p, const char *end, size_t *len);
+
+void every_clear(EverySpec *spec) {
+    spec->interval = 0;
+    spec->count = 0;
+    spec->diff = false;
+}
+
+int every_parse(char **words, int count, EverySpec *spec) {
+    int i = 0;
+    for (; i < count && words[i][0] == '-'; i++) {
+        if (strcmp(words[i], "-d") == 0) {
+            spec->diff = true;
+        } else if (strcmp(words[i], "-n") == 0 && i + 1 < count && atoi(words[i + 1]) > 0) {
+            spec->count = atoi(words[++i]);
+        } else {
+            fprintf(stderr, "every: %s: invalid option\n", words[i]);
+            return -1;
+        }
+    }
+    char *end = NULL;
+    double interval = i < count ? strtod(words[i], &end) : 0;
+    if (end && strcmp(end, "ms") == 0) interval /= 1000;
+    else if (end && *end && strcmp(end, "s") != 0) interval = 0;
+    if (interval <= 0 || i + 1 >= count) {
+        fprintf(stderr, "every: usage: every [-d] [-n count] interval command\n");
+        return -1;
+    }
+    spec->interval = interval;
+    return i + 1;
+}
+
+int every_run(CommandGroup *group, const EverySpec *spec) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    int capture = spec->diff ? memfd_create("every", MFD_CLOEXEC) : -1;
+    if (timer < 0 || (spec->diff && capture < 0)) { perror("every"); return 1; }
+
+    time_t whole = (time_t)spec->interval;
+    long nanos = (long)((spec->interval - whole) * 1e9);
+    struct itimerspec period = { { whole, nanos }, { whole, nanos } };
+    double start = now_seconds();
+    timerfd_settime(timer, 0, &period, NULL);
+
+    EveryStats stats = { 0, 0, 0, INFINITY, 0, 0, 0 };
+    char *previous = NULL;
+    size_t previous_len = 0;
+    uint64_t tick = 0;
+    int status = 0;
+
+    while (!stop_requested) {
+        double began = now_seconds();
+        double drift = began - (start + tick * spec->interval);
+
+        int saved_stdout = -1;
+        if (capture >= 0) {
+            fflush(stdout);
+            saved_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+            ftruncate(capture, 0);
+            lseek(capture, 0, SEEK_SET);
+            dup2(capture, STDOUT_FILENO);
+        }
+        status = run_parsed_group(group, false);
+        fflush(stdout);
+        if (capture >= 0) {
+            dup2(saved_stdout, STDOUT_FILENO);
+            close(saved_stdout);
+            size_t len;
+            char *output = read_output(capture, &len);
+            if (!previous) fwrite(output, 1, len, stdout);
+            else print_changes(previous, previous_len, output, len);
+            fflush(stdout);
+            free(previous);
+            previous = output;
+            previous_len = len;
+        }
+
+        double latency = now_seconds() - began;
+        stats.runs++;
+        stats.latency_sum += latency;
+        if (latency < stats.latency_min) stats.latency_min = latency;
+        if (latency > stats.latency_max) stats.latency_max = latency;
+        stats.drift_sum += drift;
+        if (drift > stats.drift_max) stats.drift_max = drift;
+        if (spec->count && stats.runs == spec->count) break;
+
+        // Each expiration is one tick; more than one means runs were skipped
+        uint64_t expirations;
+        if (read(timer, &expirations, sizeof(expirations)) != sizeof(expirations)) break;
+        tick += expirations;
+        stats.missed += expirations - 1;
+    }
+
+    free(previous);
+    close(timer);
+    if (capture >= 0) close(capture);
+    if (stats.runs > 0) {
+        fprintf(stderr, "every: %d runs, %llu missed; latency min/avg/max %.2f/%.2f/%.2f ms; drift avg/max %.3f/%.3f ms\n",
+                stats.runs, (unsigned long long)stats.missed,
+                stats.latency_min * 1e3, stats.latency_sum / stats.runs * 1e3, stats.latency_max * 1e3,
+                stats.drift_sum / stats.runs * 1e3, stats.drift_max * 1e3);
+    }
+    return status;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char* read_output(int fd, size_t *len) {
+    struct stat st;
+    *len = fstat(fd, &st) == 0 ? (size_t)st.st_size : 0;
+    char *buf = malloc(*len + 1);
+    if (!buf) { perror("malloc"); exit(EXIT_FAILURE); }
+    ssize_t n = pread(fd, buf, *len, 0);
+    *len = n > 0 ? (size_t)n : 0;
+    buf[*len] = '\0';
+    return buf;
+}
+
+// Compares the outputs line by line, position for position, which suits
+// status output whose lines keep their place. Prints nothing if nothing
+// changed, otherwise a timestamp and "-old"/"+new" pairs.
+static void print_changes(const char *old, size_t old_len, const char *new, size_t new_len) {
+    const char *o = old, *o_end = old + old_len, *n = new, *n_end = new + new_len;
+    bool header = false;
+    while (o < o_end || n < n_end) {
+        size_t ol = 0, nl = 0;
+        const char *o_line = next_line(o, o_end, &ol), *n_line = next_line(n, n_end, &nl);
+        bool same = o_line && n_line && ol == nl && memcmp(o_line, n_line, ol) == 0;
+        if (!same) {
+            if (!header) {
+                time_t t = time(NULL);
+                char stamp[16];
+                strftime(stamp, sizeof(stamp), "%H:%M:%S", localtime(&t));
+                printf("--- %s\n", stamp);
+                header = true;
+            }
+            if (o_line) printf("-%.*s\n", (int)ol, o_line);
+            if (n_line) printf("+%.*s\n", (int)nl, n_line);
+        }
+        o = o_line ? o_line + ol + (o_line + ol < o_end) : o_end;
+        n = n_line ? n_line + nl + (n_line + nl < n_end) : n_end;
+    }
+}
+
+// The line starting at 'p' (without its newline), or NULL at the end
+static const char* next_line(const char *p, const char *end, size_t *len) {
+    if (p >= end) return NULL;
+    const char *newline = memchr(p, '\n', end - p);
+    *len = newline ? (size_t)(newline - p) : (size_t)(end - p);
+    return p;
+}
\ No newline at end of file
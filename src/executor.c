@@ -1,170 +1,332 @@
-// --- START: Replace the top part of your executor.c file with this ---
-
-
-
 #include "shell.h"
-
 #include "executor.h"
-
 #include "jobs.h"
-
-#include "intrinsics.h"
-
+#include "builtins.h"
 #include "parser.h"
+#include "variables.h"
+#include "script.h"
+#include "heredoc.h"
+#include "joblimits.h"
+#include "jobsched.h"
+#include "every.h"
+#include "batch.h"
+#include "fanout.h"
+#include "metrics.h"
+#include "zygote.h"
+#include "events.h"
+#include "input.h"
+#include "coreutils.h"
 
 #include <ctype.h>
 #include <errno.h>
 
-
-
 #define MAX_ARGS 64
+#define MAX_CAPTURE_PARTS 16
+#define MAX_SUBSTITUTIONS 16
+#define MAX_OPEN_SUBSTITUTIONS 64
+#define MAX_REDIRECT_DEPTH 32
 
 // External reference to next_job_id from jobs.c
 extern int next_job_id;
 
-
-
-// NEW: A struct to represent a single redirection
-
+// A single redirection onto descriptor 'fd'. 'word' is the target as
+// written, 'filename' the target after expansion; for here-documents and
+// here-strings it is the data itself, for REDIR_DUP the source descriptor.
 typedef struct {
-
-enum { REDIR_IN, REDIR_OUT, REDIR_APPEND } type;
-
-char* filename;
-
+    enum { REDIR_IN, REDIR_OUT, REDIR_APPEND, REDIR_TEE, REDIR_HEREDOC, REDIR_HERESTRING, REDIR_DUP, REDIR_CLOSE } type;
+    int fd;
+    char* word;
+    char* filename;
 } Redirection;
 
-
-
-// UPDATED: SimpleCommand now holds a list of redirections
-
+// Descriptors a redirection replaced in the shell itself, with a
+// close-on-exec copy of what they were before (-1 if they were closed) and
+// their descriptor flags, which dup2() does not carry back
 typedef struct {
-
-char *argv[MAX_ARGS];
-
-int argc;
-
-char full_command[1024];
-
-Redirection redirections[MAX_ARGS];
-
-int redirection_count;
-
-} SimpleCommand;
-
-
-
+    int fd[MAX_ARGS];
+    int saved[MAX_ARGS];
+    int flags[MAX_ARGS];
+    int count;
+} SavedFds;
+
+// SimpleCommand holds the words as parsed and, once expand_command() has
+// run, the expanded argv and the NAME=value assignments that prefixed it
 typedef struct {
+    char **words;
+    int word_count;
+    int word_capacity;
+    char **argv;
+    int argc;
+    int fixed_args;     // Leading argv fields that `batch` repeats in every batch
+    WordList args;
+    WordList assigns;
+    char full_command[1024];
+    Redirection redirections[MAX_ARGS];
+    int redirection_count;
+    int subst_fds[MAX_SUBSTITUTIONS];   // Shell ends of <(...) and >(...) pipes
+    int subst_count;
+} SimpleCommand;
 
-SimpleCommand *commands;
-
-int num_commands;
-
-} CommandGroup;
-
-
+// A parsed pipeline. The words of every command point into 'text', so a
+// group can be expanded and run any number of times.
+struct CommandGroup {
+    SimpleCommand *commands;
+    int num_commands;
+    char *text;
+    JobLimits limits;   // From a leading `limit` prefix
+    JobSched sched;     // From a leading `sched` prefix
+    EverySpec every;    // From a leading `every` prefix
+    BatchSpec batch;    // From a leading `batch` prefix
+    bool invalid;       // A prefix was malformed; running fails
+};
 
 // Internal function prototypes
-
-static CommandGroup* parse_cmd_group(char *input);
-
-static void free_cmd_group(CommandGroup *group);
-
-static void run_cmd_group(CommandGroup *group, bool is_background);
-
-static void execute_cmd_group(char* cmd_group_string, bool is_background);
-
-
-
-// --- END: Replace the top part of your executor.c file with this ---
-
-
-
-
-
-// (The process_line and execute_cmd_group functions remain the same as the last fix)
+static int run_cmd_group(CommandGroup *group, bool is_background);
+static void execute_cmd_group(char* cmd_group_string, bool is_background, bool tail);
+static void run_expanded_group(CommandGroup *group, bool is_background, bool tail);
+static bool can_exec_in_place(const CommandGroup *group);
+static int exec_in_place(SimpleCommand *cmd);
+static int apply_redirections(SimpleCommand *cmd, SavedFds *saved);
+static int save_fd(SavedFds *saved, int fd);
+static void restore_fds(SavedFds *saved);
+static int run_builtin_in_shell(const Builtin *builtin, SimpleCommand *cmd);
+static void expand_command(SimpleCommand *cmd);
+static void release_expansion(SimpleCommand *cmd);
+static void add_redirection(SimpleCommand *cmd, int type, int fd, char *word);
+static void add_word(SimpleCommand *cmd, char *word);
+static bool parse_redirection(char *token, int *type, int *fd, char **target);
+static void apply_assignments(SimpleCommand *cmd, bool export);
+static bool capture_in_process(const char *command, char **output, size_t *len);
+static pid_t spawn_stage(SimpleCommand *cmd, int in_fd, int out_fd, pid_t pgid);
+static int run_every_job(CommandGroup *group, bool is_background);
+static int finish_job(const char *command, const JobLimits *limits, pid_t pgid, pid_t last_pid, pid_t *pids, int launched, bool is_background, const JobSched *sched);
+static bool is_stage(pid_t pid, const pid_t *pids, int launched);
+static bool is_substitution(const char *word);
+static char* start_substitution(SimpleCommand *cmd, const char *word);
+static void close_substitutions(SimpleCommand *cmd);
+static void track_substitution(int fd, bool open);
+static void close_other_substitutions(const SimpleCommand *cmd);
+static bool is_output(const Redirection *r);
+static bool needs_fanout(const SimpleCommand *cmd, int fd);
+static int start_fanout(SimpleCommand *cmd, int fd);
+static void finish_relays(bool detach);
+static void capture_in_child(const char *command, char **output, size_t *len);
+
+// Set in the leader of an `every` job: pipelines it runs join its process
+// group and leave the terminal and the job table alone
+static pid_t job_pgid = 0;
+
+// Set while the pipeline of a process substitution starts: it gets a process
+// group of its own and becomes a hidden job instead of a listed one
+static bool hidden_job = false;
+
+// Set in a forked stage before its redirections are applied. A stage that
+// fans out becomes the relay itself and runs the command in a child; the
+// shell instead starts relays as helpers, listed here until waited for.
+static bool in_stage = false;
+static pid_t relays[FANOUT_MAX];
+static int relay_count = 0;
+
+// The shell's real stdout stream. A child forked while stdout points at an
+// in-memory capture buffer switches back to it.
+static FILE *shell_stdout = NULL;
+
+// See set_exit_after_line(). Only a line run at the top counts: a line run
+// by a builtin, e.g. `replay`, has more to do afterwards.
+static bool exit_after = false;
+static bool tail_call = false;
+static int running_groups = 0;
+
+// Redirections of the groups whose body is running. Each frame keeps the
+// relays its push started, so that commands inside the body only ever wait
+// for their own.
+typedef struct {
+    CommandGroup *group;
+    SavedFds saved;
+    pid_t relays[FANOUT_MAX];
+    int relay_count;
+} RedirectFrame;
+
+static RedirectFrame redirect_stack[MAX_REDIRECT_DEPTH];
+static int redirect_count = 0;
+
+// Shell ends of the process substitution pipes open right now. They are
+// close-on-exec, but a forked copy of the shell that never execs (a builtin
+// stage, an `every` leader) has to close them itself, or it would hold a
+// pipe open and the pipeline at the other end would never see EOF.
+static int open_substitutions[MAX_OPEN_SUBSTITUTIONS];
+static int open_substitution_count = 0;
 
 void process_line(char *input) {
-
-char *input_copy = strdup(input);
-
-char *current = input;
-
-char *end = input + strlen(input);
-
-while (current < end) {
-
-char *separator = strpbrk(current, ";&");
-
-bool is_background = false;
-
-if (!separator && current[strlen(current) - 1] == '&') {
-
-is_background = true;
-
-current[strlen(current) - 1] = '\0';
-
-} else if (separator) {
-
-if (*separator == '&') is_background = true;
-
-*separator = '\0';
-
+    char *current = input;
+    char *end = input + strlen(input);
+    while (current < end) {
+        char *separator = current + shell_strcspn(current, ";&");
+        if (*separator == '\0') separator = NULL;
+        bool is_background = false;
+        if (!separator && current[strlen(current) - 1] == '&') {
+            is_background = true;
+            current[strlen(current) - 1] = '\0';
+        } else if (separator) {
+            if (*separator == '&') is_background = true;
+            *separator = '\0';
+        }
+        // With nothing left to run, the last command may replace the shell
+        execute_cmd_group(current, is_background, !separator && exits_after_line());
+        if (separator) current = separator + 1;
+        else break;
+    }
 }
 
-execute_cmd_group(current, is_background);
-
-if (separator) current = separator + 1;
-
-else break;
-
+int execute_line(char *input) {
+    if (script_is_compound(input)) {
+        script_execute(input);
+    } else if (!is_valid_syntax(input)) {
+        fprintf(stderr, "Invalid Syntax!\n");
+        LAST_STATUS = 2;
+    } else {
+        process_line(input);
+    }
+    return LAST_STATUS;
 }
 
-free(input_copy);
-
+int execute_text(const char *text) {
+    input_from_string(text);
+    char *line;
+    while ((line = read_command()) != NULL) {
+        set_exit_after_line(input_exhausted());
+        execute_line(line);
+        free(line);
+    }
+    input_from_string(NULL);
+    set_exit_after_line(false);
+    return LAST_STATUS;
 }
 
-
-
-static void execute_cmd_group(char* cmd_group_string, bool is_background) {
-
-while (isspace((unsigned char)*cmd_group_string)) cmd_group_string++;
-
-if (*cmd_group_string == '\0') return;
-
-CommandGroup *group = parse_cmd_group(cmd_group_string);
-
-if (group && group->num_commands == 1 && is_parent_builtin(group->commands[0].argv[0])) {
-
-handle_intrinsic(group->commands[0].argv, group->commands[0].argc);
-
-} else if (group && group->num_commands > 0) {
-
-run_cmd_group(group, is_background);
-
+static void execute_cmd_group(char* cmd_group_string, bool is_background, bool tail) {
+    while (isspace((unsigned char)*cmd_group_string)) cmd_group_string++;
+    if (*cmd_group_string == '\0') return;
+    CommandGroup *group = parse_cmd_group(cmd_group_string);
+    if (group) {
+        if (tail) mark_tail_call();
+        run_parsed_group(group, is_background);
+    }
+    free_cmd_group(group);
 }
 
-free_cmd_group(group);
-
+int run_parsed_group(CommandGroup *group, bool is_background) {
+    bool tail = tail_call;
+    tail_call = false;
+    if (group->invalid) return LAST_STATUS = 2;
+    if (group->num_commands == 0) return LAST_STATUS;
+    running_groups++;
+    if (group->every.interval > 0) {
+        // Expanded afresh by each run of the job instead
+        LAST_STATUS = run_every_job(group, is_background);
+    } else {
+        run_expanded_group(group, is_background, tail);
+    }
+    running_groups--;
+    return LAST_STATUS;
 }
 
+static void run_expanded_group(CommandGroup *group, bool is_background, bool tail) {
+    for (int i = 0; i < group->num_commands; i++) expand_command(&group->commands[i]);
+
+    // A lone builtin marked PARENT runs in the shell itself. Builtins that can
+    // also be pipeline stages still fork when backgrounded so '&' means a job,
+    // and when prefixed with assignments, which only belong in the child's
+    // environment, or with `limit` or `sched`. A bare assignment sets shell
+    // variables.
+    SimpleCommand *first = &group->commands[0];
+    const Builtin *builtin = group->num_commands == 1 && first->argc > 0 ? builtin_lookup(first->argv[0]) : NULL;
+    bool forks_anyway = (builtin && (builtin->flags & BUILTIN_PIPELINE)) && (is_background || first->assigns.count > 0 || limits_any(&group->limits) || sched_any(&group->sched));
+    if (group->num_commands == 1 && first->argc == 0 && !is_background) {
+        apply_assignments(first, false);
+        LAST_STATUS = first->redirection_count > 0 ? run_builtin_in_shell(NULL, first) : 0;
+    } else if (builtin && (builtin->flags & BUILTIN_PARENT) && !forks_anyway) {
+        apply_assignments(first, false);
+        METRICS.shell_commands++;
+        LAST_STATUS = run_builtin_in_shell(builtin, first);
+    } else if (tail && !is_background && can_exec_in_place(group)) {
+        LAST_STATUS = exec_in_place(first);
+    } else {
+        LAST_STATUS = run_cmd_group(group, is_background);
+    }
+    for (int i = 0; i < group->num_commands; i++) release_expansion(&group->commands[i]);
+}
 
+bool group_forks(const CommandGroup *group) {
+    if (group->invalid || group->num_commands == 0) return false;
+    if (group->num_commands > 1 || group->every.interval > 0) return true;
+    const SimpleCommand *cmd = &group->commands[0];
+    int i = 0;
+    while (i < cmd->word_count && is_assignment(cmd->words[i])) i++;
+    // A name that only expansion reveals could turn out to be a builtin
+    return i < cmd->word_count && !strpbrk(cmd->words[i], "$*?[~") && !builtin_lookup(cmd->words[i]);
+}
 
+bool group_only_redirects(const CommandGroup *group) {
+    return !group->invalid && group->num_commands == 1 && group->commands[0].word_count == 0
+        && group->commands[0].redirection_count > 0 && group->every.interval == 0 && !group->batch.enabled
+        && !limits_any(&group->limits) && !sched_any(&group->sched);
+}
 
+// A lone external command that nothing else is waiting on. Fan-out and
+// process substitutions need the shell to outlive the command, as do jobs
+// that `-c` would kill at the end and the metrics socket it would remove.
+// Hidden jobs (substitutions and relays still running) count too, in any
+// shell: exec would leave them unkilled and unreaped. A nested shell (a
+// subshell, an `every` leader) never has listed jobs.
+static bool can_exec_in_place(const CommandGroup *group) {
+    const SimpleCommand *cmd = &group->commands[0];
+    if (group->num_commands != 1 || cmd->argc == 0 || cmd->subst_count > 0 || builtin_lookup(cmd->argv[0])) return false;
+    if (group->batch.enabled || limits_any(&group->limits) || sched_any(&group->sched)) return false;
+    if (hidden_job || METRICS.enabled || (job_pgid == 0 && jobs_count() > 0) || jobs_hidden_count() > 0) return false;
+    for (int j = 0; j < cmd->redirection_count; j++) if (needs_fanout(cmd, cmd->redirections[j].fd)) return false;
+    return true;
+}
 
-// --- START: Replace your parse_cmd_group function with this ---
+// Replaces the shell with the command instead of forking it. Returns only if
+// the exec failed, with the status the stage would have exited with.
+static int exec_in_place(SimpleCommand *cmd) {
+    fflush(stdout);
+    if (apply_redirections(cmd, NULL) < 0) return 1;
+    apply_assignments(cmd, true);
+    signal(SIGINT, SIG_DFL); signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTIN, SIG_DFL); signal(SIGTTOU, SIG_DFL);
+    metrics_fork_saved();
+    // The shell itself is about to go, so the session's count goes now
+    if (getpid() == vars_shell_pid()) metrics_report_forks();
+    zygote_subreaper(false);
+    execvp(cmd->argv[0], cmd->argv);
+    zygote_subreaper(true);
+    if (errno == E2BIG) {
+        fprintf(stderr, "%s: Argument list too long (try `batch`)\n", cmd->argv[0]);
+        return 126;
+    }
+    fprintf(stderr, "%s: Command not found!\n", cmd->argv[0]);
+    return 127;
+}
 
-static CommandGroup* parse_cmd_group(char *input) {
+CommandGroup* parse_cmd_group(const char *input) {
+    double started = METRICS.enabled ? metrics_clock() : 0;
     CommandGroup *group = malloc(sizeof(CommandGroup));
     if (!group) return NULL;
     group->commands = malloc(sizeof(SimpleCommand) * 16);
-    if (!group->commands) { free(group); return NULL; }
+    group->text = strdup(input);
+    if (!group->commands || !group->text) { free(group->commands); free(group->text); free(group); return NULL; }
     group->num_commands = 0;
+    group->invalid = false;
+    limits_clear(&group->limits);
+    sched_clear(&group->sched);
+    every_clear(&group->every);
+    batch_clear(&group->batch);
 
     char *original_pipeline = strdup(input); // for job display
 
     char *saveptr_pipe = NULL;
-    char *command_str = strtok_r(input, "|", &saveptr_pipe);
+    char *command_str = shell_strtok(group->text, "|", &saveptr_pipe);
     while (command_str) {
         if (group->num_commands >= 16) break;
 
@@ -174,8 +336,15 @@ static CommandGroup* parse_cmd_group(char *input) {
         while (seg_len > 0 && isspace((unsigned char)command_str[seg_len - 1])) command_str[--seg_len] = '\0';
 
         SimpleCommand *cmd = &group->commands[group->num_commands++];
+        cmd->words = NULL;
+        cmd->word_count = 0;
+        cmd->word_capacity = 0;
+        cmd->argv = NULL;
         cmd->argc = 0;
+        cmd->args = (WordList){ NULL, 0, 0 };
+        cmd->assigns = (WordList){ NULL, 0, 0 };
         cmd->redirection_count = 0;
+        cmd->subst_count = 0;
         cmd->full_command[0] = '\0';
         if (group->num_commands == 1 && original_pipeline) {
             strncpy(cmd->full_command, original_pipeline, sizeof(cmd->full_command) - 1);
@@ -183,266 +352,1006 @@ static CommandGroup* parse_cmd_group(char *input) {
         }
 
         char *saveptr_token = NULL;
-        char *token = strtok_r(command_str, " \t\r\n", &saveptr_token);
+        char *token = shell_strtok(command_str, " \t\r\n", &saveptr_token);
         while (token) {
-            if (strcmp(token, "<") == 0) {
-                cmd->redirections[cmd->redirection_count].type = REDIR_IN;
-                cmd->redirections[cmd->redirection_count++].filename = strtok_r(NULL, " \t\r\n", &saveptr_token);
-            } else if (strcmp(token, ">") == 0) {
-                cmd->redirections[cmd->redirection_count].type = REDIR_OUT;
-                cmd->redirections[cmd->redirection_count++].filename = strtok_r(NULL, " \t\r\n", &saveptr_token);
-            } else if (strcmp(token, ">>") == 0) {
-                cmd->redirections[cmd->redirection_count].type = REDIR_APPEND;
-                cmd->redirections[cmd->redirection_count++].filename = strtok_r(NULL, " \t\r\n", &saveptr_token);
+            int type, fd;
+            char *target;
+            if (strncmp(token, "<<<", 3) == 0) {
+                add_redirection(cmd, REDIR_HERESTRING, STDIN_FILENO, token[3] ? token + 3 : shell_strtok(NULL, " \t\r\n", &saveptr_token));
+            } else if (strncmp(token, "<<=", 3) == 0 || strncmp(token, "<<:", 3) == 0) {
+                // Body already folded into the word by read_heredocs()
+                add_redirection(cmd, REDIR_HEREDOC, STDIN_FILENO, token);
+            } else if (is_substitution(token)) {
+                add_word(cmd, token);
+            } else if (parse_redirection(token, &type, &fd, &target)) {
+                if (!target) target = shell_strtok(NULL, " \t\r\n", &saveptr_token);
+                if (type == REDIR_DUP && target && strcmp(target, "-") == 0) type = REDIR_CLOSE;
+                add_redirection(cmd, type, fd, target);
             } else {
-                if (cmd->argc < MAX_ARGS - 1) cmd->argv[cmd->argc++] = token;
+                add_word(cmd, token);
             }
-            token = strtok_r(NULL, " \t\r\n", &saveptr_token);
+            token = shell_strtok(NULL, " \t\r\n", &saveptr_token);
         }
-        cmd->argv[cmd->argc] = NULL;
-        command_str = strtok_r(NULL, "|", &saveptr_pipe);
+        add_word(cmd, NULL);    // Terminator, not counted
+        cmd->word_count--;
+
+        // `limit`, `sched`, `every` and `batch` prefixes, in any order, apply
+        // to the whole pipeline. `sched --default` on its own is the builtin.
+        while (group->num_commands == 1 && cmd->word_count > 0) {
+            int used;
+            if (strcmp(cmd->words[0], "limit") == 0) {
+                used = limits_parse(cmd->words + 1, cmd->word_count - 1, &group->limits);
+            } else if (strcmp(cmd->words[0], "sched") == 0 && cmd->word_count > 1 && strcmp(cmd->words[1], "--default") != 0) {
+                used = sched_parse(cmd->words + 1, cmd->word_count - 1, &group->sched);
+            } else if (strcmp(cmd->words[0], "every") == 0) {
+                used = every_parse(cmd->words + 1, cmd->word_count - 1, &group->every);
+            } else if (strcmp(cmd->words[0], "batch") == 0) {
+                used = batch_parse(cmd->words + 1, cmd->word_count - 1, &group->batch);
+            } else {
+                break;
+            }
+            if (used < 0) {
+                group->invalid = true;
+                break;
+            }
+            cmd->word_count -= used + 1;
+            memmove(cmd->words, cmd->words + used + 1, sizeof(char *) * (cmd->word_count + 1));
+        }
+        if (group->invalid) break;
+        command_str = shell_strtok(NULL, "|", &saveptr_pipe);
     }
 
     free(original_pipeline);
+    if (METRICS.enabled) metrics_observe_parse(metrics_clock() - started);
     return group;
 }
 
-// --- END: Replace your parse_cmd_group function ---
-
-
-
-
-
-// --- START: Replace your run_cmd_group function with this ---
-
-static void run_cmd_group(CommandGroup *group, bool is_background) {
-
-int num_pipes = group->num_commands - 1;
-
-pid_t pgid = 0;
-
-int pipe_fds[num_pipes][2];
-
-
-
-for (int i = 0; i < num_pipes; i++) if (pipe(pipe_fds[i]) < 0) { perror("pipe"); return; }
-
-
-
-for (int i = 0; i < group->num_commands; i++) {
-
-pid_t pid = fork();
-
-if (pid < 0) { perror("fork"); return; }
-
+static void add_word(SimpleCommand *cmd, char *word) {
+    if (cmd->word_count == cmd->word_capacity) {
+        cmd->word_capacity = cmd->word_capacity ? cmd->word_capacity * 2 : 16;
+        cmd->words = realloc(cmd->words, sizeof(char *) * cmd->word_capacity);
+        if (!cmd->words) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    cmd->words[cmd->word_count++] = word;
+}
 
-if (pid == 0) { // Child Process
+static void add_redirection(SimpleCommand *cmd, int type, int fd, char *word) {
+    if (cmd->redirection_count == MAX_ARGS) return;
+    Redirection *r = &cmd->redirections[cmd->redirection_count++];
+    r->type = type;
+    r->fd = fd;
+    r->word = word;
+    r->filename = NULL;
+}
 
-signal(SIGINT, SIG_DFL); signal(SIGTSTP, SIG_DFL);
+// Recognises [n]<, [n]>, [n]>>, [n]>+, [n]>&, [n]<& at the start of 'token'. The
+// target follows directly or is the next word (*target == NULL).
+static bool parse_redirection(char *token, int *type, int *fd, char **target) {
+    char *p = token;
+    while (isdigit((unsigned char)*p)) p++;
+    if (*p != '<' && *p != '>') return false;
+    bool has_fd = p > token;
+    if (has_fd && p - token > 4) return false;
+
+    if (p[0] == '<' && p[1] == '&') { *type = REDIR_DUP; *fd = STDIN_FILENO; p += 2; }
+    else if (p[0] == '>' && p[1] == '&') { *type = REDIR_DUP; *fd = STDOUT_FILENO; p += 2; }
+    else if (p[0] == '>' && p[1] == '>') { *type = REDIR_APPEND; *fd = STDOUT_FILENO; p += 2; }
+    else if (p[0] == '>' && p[1] == '+') { *type = REDIR_TEE; *fd = STDOUT_FILENO; p += 2; }
+    else if (p[0] == '>') { *type = REDIR_OUT; *fd = STDOUT_FILENO; p += 1; }
+    else if (p[1] != '<') { *type = REDIR_IN; *fd = STDIN_FILENO; p += 1; }
+    else return false;
+
+    if (has_fd) *fd = atoi(token);
+    *target = *p ? p : NULL;
+    return true;
+}
 
-signal(SIGTTIN, SIG_DFL); signal(SIGTTOU, SIG_DFL);
+// Expands the words of 'cmd' against the current variables. Leading NAME=value
+// words are assignments; their values and redirection targets expand to a
+// single field, the remaining words are split into fields and may vanish.
+// Fields before the first word that expands to several are 'fixed_args'.
+static void expand_command(SimpleCommand *cmd) {
+    int i = 0;
+    for (; i < cmd->word_count && is_assignment(cmd->words[i]); i++) {
+        char *eq = strchr(cmd->words[i], '=');
+        WordList value = { NULL, 0, 0 };
+        expand_word(eq + 1, false, &value);
+        size_t name_len = eq - cmd->words[i], value_len = strlen(value.items[0]);
+        char *assign = malloc(name_len + value_len + 2);
+        if (!assign) { perror("malloc"); exit(EXIT_FAILURE); }
+        memcpy(assign, cmd->words[i], name_len + 1);
+        memcpy(assign + name_len + 1, value.items[0], value_len + 1);
+        wordlist_push(&cmd->assigns, assign);
+        wordlist_free(&value);
+    }
+    cmd->fixed_args = -1;
+    for (; i < cmd->word_count; i++) {
+        int before = cmd->args.count;
+        if (is_substitution(cmd->words[i])) {
+            char *path = start_substitution(cmd, cmd->words[i]);
+            if (path) wordlist_push(&cmd->args, path);
+            continue;
+        }
+        expand_word(cmd->words[i], true, &cmd->args);
+        if (cmd->fixed_args < 0 && cmd->args.count - before > 1) cmd->fixed_args = before;
+    }
+    if (cmd->fixed_args < 0) cmd->fixed_args = 1;
+    wordlist_push(&cmd->args, NULL);    // argv terminator, not counted
+    cmd->args.count--;
+    cmd->argv = cmd->args.items;
+    cmd->argc = cmd->args.count;
+
+    for (int j = 0; j < cmd->redirection_count; j++) {
+        Redirection *r = &cmd->redirections[j];
+        if (!r->word) continue;
+        if (is_substitution(r->word)) {
+            // cmd > >(tee log): a failure leaves no filename, which
+            // apply_redirections() reports
+            r->filename = start_substitution(cmd, r->word);
+            continue;
+        }
+        bool literal = false;
+        char *body = r->type == REDIR_HEREDOC ? heredoc_decode(r->word, &literal) : NULL;
+        if (literal) { r->filename = body; continue; }
+
+        WordList target = { NULL, 0, 0 };
+        expand_word(body ? body : r->word, false, &target);
+        r->filename = target.items[0];
+        free(target.items);
+        free(body);
+        if (r->type == REDIR_HERESTRING) {
+            // A here-string is the word plus a newline
+            size_t len = strlen(r->filename);
+            r->filename = realloc(r->filename, len + 2);
+            if (!r->filename) { perror("realloc"); exit(EXIT_FAILURE); }
+            memcpy(r->filename + len, "\n", 2);
+        }
+    }
+}
 
-pgid = (pgid == 0) ? getpid() : pgid;
+static void release_expansion(SimpleCommand *cmd) {
+    wordlist_free(&cmd->args);
+    wordlist_free(&cmd->assigns);
+    cmd->argv = NULL;
+    cmd->argc = 0;
+    for (int j = 0; j < cmd->redirection_count; j++) {
+        free(cmd->redirections[j].filename);
+        cmd->redirections[j].filename = NULL;
+    }
+    close_substitutions(cmd);
+}
 
-setpgid(0, pgid);
+// <(pipeline) or >(pipeline) as a whole word
+static bool is_substitution(const char *word) {
+    return (word[0] == '<' || word[0] == '>') && word[1] == '(' && substitution_len(word + 1) == strlen(word) - 1;
+}
 
-// Only the parent should manipulate terminal foreground process group; remove from child to avoid SIGTTOU stops
+// Starts the pipeline of <(...) or >(...) as a hidden background job whose
+// stdout or stdin is a pipe, and returns "/dev/fd/N" naming the shell's end.
+// That end is close-on-exec except in the stage that uses it, and the shell
+// closes it once the command has started.
+static char* start_substitution(SimpleCommand *cmd, const char *word) {
+    bool reads = word[0] == '<';    // The command reads what the pipeline writes
+    char *text = strndup(word + 2, strlen(word) - 3);
+    if (text[shell_strcspn(text, ";&")] != '\0' || script_is_compound(text)) {
+        fprintf(stderr, "%s: only a single pipeline can be substituted\n", word);
+        free(text);
+        return NULL;
+    }
+    bool room = cmd->subst_count < MAX_SUBSTITUTIONS && open_substitution_count < MAX_OPEN_SUBSTITUTIONS;
+    CommandGroup *group = room ? parse_cmd_group(text) : NULL;
+    free(text);
+    int fds[2];
+    if (!group || group->invalid || group->num_commands == 0 || pipe(fds) < 0) {
+        if (!group || !group->invalid) fprintf(stderr, "%s: cannot start process substitution\n", word);
+        free_cmd_group(group);
+        return NULL;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    int target = reads ? STDOUT_FILENO : STDIN_FILENO;
+    int shell_end = reads ? fds[0] : fds[1];
+    track_substitution(shell_end, true);
+
+    // Nested substitutions start while this group expands, before it runs
+    bool every = group->every.interval > 0;
+    if (!every) for (int i = 0; i < group->num_commands; i++) expand_command(&group->commands[i]);
+    fflush(stdout);
+    SavedFds saved;
+    saved.count = 0;
+    if (save_fd(&saved, target) < 0) {
+        track_substitution(shell_end, false);
+        close(fds[0]);
+        close(fds[1]);
+        if (!every) for (int i = 0; i < group->num_commands; i++) release_expansion(&group->commands[i]);
+        free_cmd_group(group);
+        return NULL;
+    }
+    dup2(reads ? fds[1] : fds[0], target);
+    close(reads ? fds[1] : fds[0]);
+    hidden_job = true;
+    if (every) run_every_job(group, true);
+    else run_cmd_group(group, true);
+    hidden_job = false;
+    restore_fds(&saved);
+    if (!every) for (int i = 0; i < group->num_commands; i++) release_expansion(&group->commands[i]);
+    free_cmd_group(group);
+
+    int fd = fcntl(shell_end, F_DUPFD_CLOEXEC, 10);
+    track_substitution(shell_end, false);
+    close(shell_end);
+    if (fd < 0) { perror("fcntl"); return NULL; }
+    track_substitution(fd, true);
+    cmd->subst_fds[cmd->subst_count++] = fd;
+    char *path = malloc(32);
+    if (!path) { perror("malloc"); exit(EXIT_FAILURE); }
+    snprintf(path, 32, "/dev/fd/%d", fd);
+    return path;
+}
 
+static void close_substitutions(SimpleCommand *cmd) {
+    for (int i = 0; i < cmd->subst_count; i++) {
+        track_substitution(cmd->subst_fds[i], false);
+        close(cmd->subst_fds[i]);
+    }
+    cmd->subst_count = 0;
+}
 
+static void track_substitution(int fd, bool open) {
+    if (open) {
+        open_substitutions[open_substitution_count++] = fd;
+        return;
+    }
+    for (int i = 0; i < open_substitution_count; i++) {
+        if (open_substitutions[i] == fd) {
+            open_substitutions[i] = open_substitutions[--open_substitution_count];
+            return;
+        }
+    }
+}
 
-// Set up I/O from pipes
+// In a forked copy of the shell: closes every substitution pipe except the
+// ones 'cmd' (NULL: none) was given as /dev/fd/N arguments
+static void close_other_substitutions(const SimpleCommand *cmd) {
+    for (int i = 0; i < open_substitution_count; i++) {
+        bool own = false;
+        for (int j = 0; cmd && j < cmd->subst_count && !own; j++) own = cmd->subst_fds[j] == open_substitutions[i];
+        if (!own) close(open_substitutions[i]);
+    }
+    open_substitution_count = 0;
+}
 
-if (i > 0) dup2(pipe_fds[i - 1][0], STDIN_FILENO);
+// Sets the command's prefix assignments, as exported variables in a child
+// about to exec, or as shell variables for a bare assignment
+static void apply_assignments(SimpleCommand *cmd, bool export) {
+    for (int i = 0; i < cmd->assigns.count; i++) {
+        char *eq = strchr(cmd->assigns.items[i], '=');
+        *eq = '\0';
+        var_set(cmd->assigns.items[i], eq + 1, export);
+        *eq = '=';
+    }
+}
 
-if (i < num_pipes) dup2(pipe_fds[i][1], STDOUT_FILENO);
+char* capture_output(const char *command) {
+    if (!shell_stdout) shell_stdout = stdout;
+    char *output = NULL;
+    size_t len = 0;
+    if (!capture_in_process(command, &output, &len)) capture_in_child(command, &output, &len);
+    while (len > 0 && output[len - 1] == '\n') output[--len] = '\0';
+    return output;
+}
 
+// A substitution made only of CAPTURE builtins, e.g. $(pwd) or
+// $(printf %s x; echo y), runs in the shell with stdout pointed at a memory
+// stream. Returns false, having run nothing, for anything else.
+static bool capture_in_process(const char *command, char **output, size_t *len) {
+    if (script_is_compound(command) || !is_valid_syntax(command)) return false;
+
+    char *text = strdup(command);
+    CommandGroup *parts[MAX_CAPTURE_PARTS];
+    int count = 0;
+    bool capturable = true;
+    char *saveptr = NULL;
+    for (char *part = shell_strtok(text, ";", &saveptr); part && capturable; part = shell_strtok(NULL, ";", &saveptr)) {
+        if (count == MAX_CAPTURE_PARTS || part[shell_strcspn(part, "&")] != '\0') { capturable = false; break; }
+        CommandGroup *group = parts[count++] = parse_cmd_group(part);
+        if (!group) { capturable = false; break; }
+        if (group->num_commands == 0) continue;
+        SimpleCommand *cmd = &group->commands[0];
+        // Decided on the words as written, so nothing is expanded twice
+        const Builtin *builtin = cmd->word_count > 0 && !strchr(cmd->words[0], '$') ? builtin_lookup(cmd->words[0]) : NULL;
+        if (group->num_commands > 1 || cmd->redirection_count > 0 || !builtin || !(builtin->flags & BUILTIN_CAPTURE)) capturable = false;
+    }
 
-// Set up I/O from files (this will override pipe I/O if specified)
+    FILE *capture = capturable ? open_memstream(output, len) : NULL;
+    if (capture) {
+        fflush(stdout);
+        FILE *saved = stdout;
+        stdout = capture;
+        for (int i = 0; i < count; i++) run_parsed_group(parts[i], false);
+        stdout = saved;
+        fclose(capture);
+    }
+    for (int i = 0; i < count; i++) free_cmd_group(parts[i]);
+    free(text);
+    return capture != NULL;
+}
 
-int input_fd = -1, output_fd = -1;
-bool had_input_error = false;
-bool had_output_error = false;
+// Everything else runs in a forked copy of the shell whose stdout is a pipe
+// read into a growable buffer
+static void capture_in_child(const char *command, char **output, size_t *len) {
+    size_t capacity = 4096;
+    *output = malloc(capacity);
+    if (!*output) { perror("malloc"); exit(EXIT_FAILURE); }
+    *len = 0;
+    (*output)[0] = '\0';
+
+    int fds[2];
+    if (pipe(fds) < 0) { perror("pipe"); LAST_STATUS = 1; return; }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); METRICS.fork_failures++; close(fds[0]); close(fds[1]); LAST_STATUS = 1; return; }
+
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL); signal(SIGTSTP, SIG_DFL);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        stdout = shell_stdout;
+        set_exit_after_line(true);
+        char *text = strdup(command);
+        if (script_is_compound(text)) {
+            script_execute(text);
+        } else if (is_valid_syntax(text)) {
+            process_line(text);
+        } else {
+            fprintf(stderr, "Invalid Syntax!\n");
+            LAST_STATUS = 1;
+        }
+        fflush(stdout);
+        _exit(LAST_STATUS);
+    }
 
-for (int j = 0; j < group->commands[i].redirection_count; j++) {
+    close(fds[1]);
+    for (;;) {
+        if (capacity - *len < 1024) {
+            capacity *= 2;
+            *output = realloc(*output, capacity);
+            if (!*output) { perror("realloc"); exit(EXIT_FAILURE); }
+        }
+        ssize_t n = read(fds[0], *output + *len, capacity - *len - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        *len += n;
+    }
+    (*output)[*len] = '\0';
+    close(fds[0]);
 
-Redirection *r = &group->commands[i].redirections[j];
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) { LAST_STATUS = 1; return; }
+    }
+    LAST_STATUS = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
 
-if (r->type == REDIR_IN) {
-    // Handle input redirections
-    if (input_fd != -1) close(input_fd);
-    
-    input_fd = open(r->filename, O_RDONLY);
-    if (input_fd < 0) { 
-        fprintf(stderr, "No such file or directory\n");
-        had_input_error = true;
-        // Continue with next redirection instead of exiting
+// Records the current state of 'fd' before a redirection replaces it. A
+// saved copy that is itself about to be replaced is moved out of the way.
+// Returns -1, after reporting why, if the state cannot be recorded; the
+// caller must then leave 'fd' alone or it could never be restored.
+static int save_fd(SavedFds *saved, int fd) {
+    if (!zygote_vacate(fd)) { perror("fcntl"); return -1; }
+    if (!saved) return 0;
+    for (int i = 0; i < saved->count; i++) {
+        if (saved->saved[i] != fd) continue;
+        int moved = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+        if (moved < 0) { perror("fcntl"); return -1; }
+        saved->saved[i] = moved;
+        // The copy was ours: 'fd' was closed before, and is again on restore
+        close(fd);
     }
-} else {
-    // Handle output redirections
-    if (output_fd != -1) close(output_fd);
-    
-    int flags = O_WRONLY | O_CREAT | (r->type == REDIR_APPEND ? O_APPEND : O_TRUNC);
-    output_fd = open(r->filename, flags, 0644);
-    if (output_fd < 0) { 
-        fprintf(stderr, "Unable to create file for writing\n");
-        had_output_error = true;
-        // Continue with next redirection instead of exiting
+    for (int i = 0; i < saved->count; i++) if (saved->fd[i] == fd) return 0;
+    if (saved->count == MAX_ARGS) {
+        fprintf(stderr, "%d: too many redirections\n", fd);
+        return -1;
     }
+    // EBADF just means 'fd' was closed, which restore_fds() reproduces
+    int copy = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    if (copy < 0 && errno != EBADF) { perror("fcntl"); return -1; }
+    saved->fd[saved->count] = fd;
+    saved->flags[saved->count] = copy < 0 ? 0 : fcntl(fd, F_GETFD);
+    saved->saved[saved->count++] = copy;
+    return 0;
 }
 
+static void restore_fds(SavedFds *saved) {
+    for (int i = saved->count - 1; i >= 0; i--) {
+        if (saved->saved[i] >= 0) {
+            // Pipe ends are close-on-exec so that the fork server only hands
+            // a stage the ends it was given; a restored one must stay that way
+            dup2(saved->saved[i], saved->fd[i]);
+            if (saved->flags[i] > 0) fcntl(saved->fd[i], F_SETFD, saved->flags[i]);
+            close(saved->saved[i]);
+        } else {
+            close(saved->fd[i]);
+        }
+    }
+    saved->count = 0;
 }
 
-// Only set up stdin if we didn't have any input errors
-if (!had_input_error && input_fd != -1) { 
-    dup2(input_fd, STDIN_FILENO); 
-    close(input_fd); 
-} else if (had_input_error) {
-    // If we had an input error, exit after error messages were printed
-    exit(1);
+// Applies the redirections of 'cmd' in order, each one onto its target
+// descriptor. With 'saved', every descriptor is recorded first so that
+// restore_fds() can undo the lot. Every failure is reported, then -1 is
+// returned so the caller can skip the command.
+static int apply_redirections(SimpleCommand *cmd, SavedFds *saved) {
+    bool had_error = false;
+
+    for (int j = 0; j < cmd->redirection_count; j++) {
+        Redirection *r = &cmd->redirections[j];
+        int fd = -1;
+        switch (r->type) {
+        case REDIR_IN:
+            fd = r->filename ? open(r->filename, O_RDONLY) : -1;
+            if (fd < 0) fprintf(stderr, "No such file or directory\n");
+            break;
+        case REDIR_OUT:
+        case REDIR_APPEND:
+        case REDIR_TEE:
+            if (needs_fanout(cmd, r->fd)) {
+                // Every target of the descriptor is opened with the first
+                bool first = true;
+                for (int k = 0; k < j && first; k++) first = !(cmd->redirections[k].fd == r->fd && is_output(&cmd->redirections[k]));
+                if (!first) continue;
+                fd = start_fanout(cmd, r->fd);
+                if (fd < 0) had_error = true;
+                break;
+            }
+            fd = r->filename ? open(r->filename, O_WRONLY | O_CREAT | (r->type == REDIR_APPEND ? O_APPEND : O_TRUNC), 0644) : -1;
+            if (fd < 0) fprintf(stderr, "Unable to create file for writing\n");
+            break;
+        case REDIR_HEREDOC:
+        case REDIR_HERESTRING:
+            fd = r->filename ? heredoc_fd(r->filename, strlen(r->filename)) : -1;
+            if (fd < 0) fprintf(stderr, "Unable to create here-document\n");
+            break;
+        case REDIR_DUP: {
+            char *end = NULL;
+            long source = r->filename ? strtol(r->filename, &end, 10) : -1;
+            if (!end || end == r->filename || *end || source < 0 || fcntl((int)source, F_GETFD) < 0) {
+                fprintf(stderr, "%s: Bad file descriptor\n", r->filename ? r->filename : "");
+                had_error = true;
+                continue;
+            }
+            if (source != r->fd) {
+                if (save_fd(saved, r->fd) < 0) { had_error = true; continue; }
+                dup2((int)source, r->fd);
+            }
+            continue;
+        }
+        case REDIR_CLOSE:
+            if (save_fd(saved, r->fd) < 0) { had_error = true; continue; }
+            close(r->fd);
+            continue;
+        }
+
+        if (fd < 0) { had_error = true; continue; }
+        if (fd != r->fd) {
+            if (save_fd(saved, r->fd) < 0) {
+                had_error = true;
+                close(fd);
+                continue;
+            }
+            dup2(fd, r->fd);
+            close(fd);
+        }
+    }
+    return had_error ? -1 : 0;
 }
 
-// Only set up stdout if we didn't have any output errors
-if (!had_output_error && output_fd != -1) { 
-    dup2(output_fd, STDOUT_FILENO); 
-    close(output_fd); 
-} else if (had_output_error) {
-    // If we had an output error, exit after error messages were printed
-    exit(1);
+// Runs a builtin without forking. Redirections are applied to the shell's
+// own descriptors for the duration of the call and then undone, except for
+// PERSIST builtins (exec), whose redirections are the point. Output stays in
+// the stdio buffer and is only flushed when it has to be: before the
+// descriptors are switched back, or before the next fork.
+static int run_builtin_in_shell(const Builtin *builtin, SimpleCommand *cmd) {
+    if (cmd->redirection_count == 0) return builtin->fn(cmd->argv, cmd->argc);
+
+    fflush(stdout);
+    SavedFds saved;
+    saved.count = 0;
+    bool persist = builtin && (builtin->flags & BUILTIN_PERSIST);
+
+    int status = 1;
+    if (apply_redirections(cmd, persist ? NULL : &saved) == 0) status = builtin ? builtin->fn(cmd->argv, cmd->argc) : 0;
+
+    if (builtin) status = builtin_flush(builtin->name, status);
+    else fflush(stdout);
+    restore_fds(&saved);
+    // Closing our end of a fan-out pipe lets its relay finish
+    finish_relays(persist);
+    return status;
 }
 
+// exec [command [args...]]: replaces the shell with 'command'. Redirections
+// on the exec line have already been applied to the shell itself and stay.
+int do_exec(char **args, int argc) {
+    if (argc < 2) return 0;
+    fflush(stdout);
+    void (*old_int)(int) = signal(SIGINT, SIG_DFL);
+    void (*old_tstp)(int) = signal(SIGTSTP, SIG_DFL);
+    void (*old_ttin)(int) = signal(SIGTTIN, SIG_DFL);
+    void (*old_ttou)(int) = signal(SIGTTOU, SIG_DFL);
+    zygote_subreaper(false);
+    execvp(args[1], &args[1]);
+
+    int error = errno;
+    zygote_subreaper(true);
+    fprintf(stderr, "exec: %s: %s\n", args[1], strerror(error));
+    signal(SIGINT, old_int);
+    signal(SIGTSTP, old_tstp);
+    signal(SIGTTIN, old_ttin);
+    signal(SIGTTOU, old_ttou);
+    return error == ENOENT ? 127 : 126;
+}
 
+// Forks every stage of the pipeline into one process group. Returns the exit
+// status of the last stage for foreground jobs, or 0 for background jobs.
+static int run_cmd_group(CommandGroup *group, bool is_background) {
+    int num_pipes = group->num_commands - 1;
+    pid_t pgid = hidden_job ? 0 : job_pgid;
+    pid_t last_pid = -1;
+    int pipe_fds[num_pipes][2];
+
+    // Close-on-exec so that only the ends a stage dup2()s onto 0/1 reach it,
+    // whether it is forked here or launched by the fork server
+    for (int i = 0; i < num_pipes; i++) {
+        if (pipe(pipe_fds[i]) < 0) { perror("pipe"); return 1; }
+        fcntl(pipe_fds[i][0], F_SETFD, FD_CLOEXEC);
+        fcntl(pipe_fds[i][1], F_SETFD, FD_CLOEXEC);
+    }
 
-// Child must close ALL original pipe fds
+    // Children inherit the stdio buffer; anything builtins left in it must go
+    // out now or it would be written once per child
+    fflush(stdout);
+
+    // An explicit `sched` wins; otherwise background jobs get the default,
+    // but not process substitutions, which the foreground command waits on
+    const JobSched *sched = sched_any(&group->sched) ? &group->sched : is_background && !hidden_job ? sched_background_default() : NULL;
+
+    pid_t pids[group->num_commands];
+    int launched = 0;
+    for (int i = 0; i < group->num_commands; i++) {
+        SimpleCommand *stage = &group->commands[i];
+        bool batched = i == 0 && group->batch.enabled;
+        bool fans_out = false;
+        for (int j = 0; j < stage->redirection_count && !fans_out; j++) fans_out = needs_fanout(stage, stage->redirections[j].fd);
+        // Limits and policies must be in place before the command runs, and
+        // a stage that cannot get them must fail without running: forked
+        if (zygote_active() && !limits_any(&group->limits) && !sched && !batched && !fans_out && stage->argc > 0 && stage->assigns.count == 0 && !builtin_lookup(stage->argv[0])) {
+            pid_t pid = spawn_stage(stage, i > 0 ? pipe_fds[i - 1][0] : -1, i < num_pipes ? pipe_fds[i][1] : -1, pgid);
+            if (pid > 0) {
+                METRICS.forked_commands++;
+                pgid = (pgid == 0) ? pid : pgid;
+                last_pid = pid;
+                pids[launched++] = pid;
+                continue;
+            }
+            if (pid == 0) {             // A redirection failed; nothing runs
+                last_pid = -1;
+                continue;
+            }
+            // The helper is gone or cannot pass every descriptor: fork it
+        }
 
-for (int j = 0; j < num_pipes; j++) {
+        pid_t pid = fork();
+        if (pid < 0) { perror("fork"); METRICS.fork_failures++; return 1; }
+        METRICS.forked_commands++;
+
+        if (pid == 0) { // Child Process
+            signal(SIGINT, SIG_DFL); signal(SIGTSTP, SIG_DFL);
+            signal(SIGTTIN, SIG_DFL); signal(SIGTTOU, SIG_DFL);
+            pgid = (pgid == 0) ? getpid() : pgid;
+            setpgid(0, pgid);
+            if (limits_apply(&group->limits) < 0) _exit(1);
+            if (sched && sched_apply(sched, 0, i) < 0) _exit(1);
+            // Only the parent should manipulate terminal foreground process group; remove from child to avoid SIGTTOU stops
+
+            // Set up I/O from pipes
+            if (i > 0) dup2(pipe_fds[i - 1][0], STDIN_FILENO);
+            if (i < num_pipes) dup2(pipe_fds[i][1], STDOUT_FILENO);
+
+            // Child must close ALL original pipe fds, before the redirections
+            // so that one like 4>file is not closed again afterwards
+            for (int j = 0; j < num_pipes; j++) {
+                close(pipe_fds[j][0]);
+                close(pipe_fds[j][1]);
+            }
+            close_other_substitutions(&group->commands[i]);
+
+            // Set up I/O from files (this will override pipe I/O if specified)
+            in_stage = true;
+            if (apply_redirections(&group->commands[i], NULL) < 0) _exit(1);
+
+            // Its own /dev/fd/N arguments have to survive the exec
+            SimpleCommand *cmd = &group->commands[i];
+            for (int j = 0; j < cmd->subst_count; j++) fcntl(cmd->subst_fds[j], F_SETFD, 0);
+            if (cmd->argc == 0) _exit(0);
+            apply_assignments(cmd, true);
+
+            const Builtin *builtin = builtin_lookup(cmd->argv[0]);
+            if (builtin) {
+                if (num_pipes > 0 && !(builtin->flags & BUILTIN_PIPELINE)) {
+                    fprintf(stderr, "%s: cannot be used in a pipeline\n", builtin->name);
+                    _exit(1);
+                }
+                // _exit() rather than exit(): exit() would also "close" the
+                // shell's stdin stream and rewind the shared offset of a
+                // script file, making the parent read lines twice
+                _exit(builtin_flush(builtin->name, builtin->fn(cmd->argv, cmd->argc)));
+            }
 
-close(pipe_fds[j][0]);
+            if (batched) _exit(batch_exec(cmd->argv, cmd->argc, cmd->fixed_args, &group->batch));
+            execvp(cmd->argv[0], cmd->argv);
+            if (errno == E2BIG) {
+                fprintf(stderr, "%s: Argument list too long (try `batch`)\n", cmd->argv[0]);
+                _exit(126);
+            }
+            fprintf(stderr, "%s: Command not found!\n", cmd->argv[0]);
+            _exit(127);
+        }
+        pgid = (pgid == 0) ? pid : pgid;
+        setpgid(pid, pgid);
+        last_pid = pid;
+        pids[launched++] = pid;
+    }
 
-close(pipe_fds[j][1]);
+    //
+    // CRITICAL: Parent must close ALL pipe file descriptors
+    // This allows children to receive EOF when writers finish
+    //
+    for (int i = 0; i < num_pipes; i++) {
+        if (pipe_fds[i][0] >= 0) close(pipe_fds[i][0]);
+        if (pipe_fds[i][1] >= 0) close(pipe_fds[i][1]);
+    }
+    for (int i = 0; i < group->num_commands; i++) close_substitutions(&group->commands[i]);
 
+    // Every stage failed its redirections
+    if (launched == 0) return 1;
+    return finish_job(group->commands[0].full_command, &group->limits, pgid, last_pid, pids, launched, is_background, sched);
 }
 
+// Registers a started job, or waits for it in the foreground. Returns the
+// exit status of 'last_pid' (1 if the last stage never started), or 0 for
+// background jobs.
+static int finish_job(const char *command, const JobLimits *limits, pid_t pgid, pid_t last_pid, pid_t *pids, int launched, bool is_background, const JobSched *sched) {
+    // A process substitution: reaped by jobs_reap(), never listed
+    if (hidden_job) {
+        // Killed, but still reaped like any substitution
+        if (limits_any(limits) && !jobs_watch(pgid, limits, NULL)) kill(-pgid, SIGKILL);
+        jobs_add_hidden(pgid);
+        return 0;
+    }
+    bool nested = job_pgid != 0;
+    // A timeout nobody enforces is worse than none: the job is not let run
+    if (!nested && (limits_any(limits) || sched) && !jobs_watch(pgid, limits, sched)) {
+        kill(-pgid, SIGKILL);
+        while (waitpid(-pgid, NULL, 0) > 0 || errno == EINTR) {}
+        return 1;
+    }
 
-if (handle_intrinsic(group->commands[i].argv, group->commands[i].argc)) exit(0);
+    if (is_background && !nested) {
+        jobs_add(pgid, command, RUNNING, pids, launched);
+        return 0;
+    }
 
-execvp(group->commands[i].argv[0], group->commands[i].argv);
+    int status;
+    // A last stage that never started counts as failed
+    int last_status = last_pid < 0 ? 1 : 0;
+    pid_t pid;
+    bool job_stopped = false;
+    int active_procs = launched;  // Track how many processes are still active
+    bool interactive = !nested && isatty(STDIN_FILENO);
+
+    if (interactive) tcsetpgrp(STDIN_FILENO, pgid);
+
+    // Wait for all processes in the pipeline to complete or for one to be stopped
+    while (active_procs > 0) {
+        pid = events_waitpid(-pgid, &status, WUNTRACED);
+
+        if (pid < 0) {
+            // No more children to wait for
+            if (errno == ECHILD) break;
+            // Interrupted by signal, continue waiting
+            if (errno == EINTR) continue;
+            perror("waitpid");
+            break;
+        }
 
-fprintf(stderr, "%s: Command not found!\n", group->commands[i].argv[0]);
+        if (WIFSTOPPED(status)) {
+            // Inside an `every` job the leader is stopped along with the
+            // stages and simply carries on waiting once they continue
+            if (nested) continue;
+            // A process was stopped, mark the job as stopped
+            job_stopped = true;
+            last_status = 128 + WSTOPSIG(status);
+            break;  // Stop waiting and give control back to shell
+        } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            // With the fork server, what a stage left running when it exited
+            // is reparented to the shell but stays in the group. Collecting
+            // it is all there is to do: it is not one of the stages.
+            if (!is_stage(pid, pids, launched)) continue;
+            // A process has completed, decrement counter
+            active_procs--;
+            if (WIFEXITED(status)) metrics_stage_status(WEXITSTATUS(status));
+            if (pid == last_pid) last_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+    }
+    if (nested) return last_status;
 
-exit(127);
+    if (interactive) tcsetpgrp(STDIN_FILENO, SHELL_PGID);
+    if (!job_stopped) jobs_unwatch(pgid);
 
+    if (job_stopped) {
+        jobs_add(pgid, command, STOPPED, pids, launched);
+        printf("[%d]+ Stopped\t\t%s\n", next_job_id - 1, command);
+        fflush(stdout);
+    }
+    return last_status;
 }
 
-pgid = (pgid == 0) ? pid : pgid;
-
-setpgid(pid, pgid);
-
+static bool is_stage(pid_t pid, const pid_t *pids, int launched) {
+    for (int i = 0; i < launched; i++) if (pids[i] == pid) return true;
+    return false;
 }
 
+// Forks the leader of an `every` job, which re-runs the group inside its
+// own process group. To the shell it is an ordinary one-process job.
+static int run_every_job(CommandGroup *group, bool is_background) {
+    const JobSched *sched = sched_any(&group->sched) ? &group->sched : is_background && !hidden_job ? sched_background_default() : NULL;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); METRICS.fork_failures++; return 1; }
+
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL); signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL); signal(SIGTTOU, SIG_DFL);
+        setpgid(0, 0);
+        close_other_substitutions(NULL);
+        if (limits_apply(&group->limits) < 0) _exit(1);
+        // An explicit policy is applied per stage by the runs themselves
+        // (--spread needs that); the background default is simply inherited
+        if (sched && sched != &group->sched && sched_apply(sched, 0, 0) < 0) _exit(1);
+
+        // The runs are plain pipelines in this group; the timeout belongs
+        // to the job as a whole and is enforced by the shell
+        EverySpec spec = group->every;
+        every_clear(&group->every);
+        limits_clear(&group->limits);
+        job_pgid = getpid();
+        hidden_job = false;
+        int status = every_run(group, &spec);
+        fflush(stdout);
+        _exit(status);
+    }
+    setpgid(pid, pid);
+    return finish_job(group->commands[0].full_command, &group->limits, pid, pid, &pid, 1, is_background, sched);
+}
 
+// Launches one external stage through the fork server. The stage's pipe
+// ends and redirections are set up on the shell's own descriptors, which
+// the helper hands on to the command, and then restored. Returns the pid,
+// 0 if a redirection failed, or -1 if the stage has to be forked instead
+// (a redirection the helper could not pass on counts as well).
+static pid_t spawn_stage(SimpleCommand *cmd, int in_fd, int out_fd, pid_t pgid) {
+    for (int i = 0; i < cmd->redirection_count; i++) {
+        if (cmd->redirections[i].fd >= ZYGOTE_MAX_FD) return -1;
+    }
+    SavedFds saved;
+    saved.count = 0;
+    bool ok = true;
+    if (in_fd >= 0 && (ok = save_fd(&saved, STDIN_FILENO) == 0)) dup2(in_fd, STDIN_FILENO);
+    if (ok && out_fd >= 0 && (ok = save_fd(&saved, STDOUT_FILENO) == 0)) dup2(out_fd, STDOUT_FILENO);
+
+    pid_t pid = 0;
+    if (ok && apply_redirections(cmd, &saved) == 0) {
+        int exec_error;
+        for (int i = 0; i < cmd->subst_count; i++) fcntl(cmd->subst_fds[i], F_SETFD, 0);
+        pid = zygote_spawn(cmd->argv, pgid, &exec_error);
+        if (pid > 0 && exec_error) fprintf(stderr, "%s: Command not found!\n", cmd->argv[0]);
+        for (int i = 0; i < cmd->subst_count; i++) fcntl(cmd->subst_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    restore_fds(&saved);
+    return pid;
+}
 
-//
-
-// CRITICAL: Parent must close ALL pipe file descriptors
-
-// This allows children to receive EOF when writers finish
-
-//
-
-for (int i = 0; i < num_pipes; i++) {
-
-if (pipe_fds[i][0] >= 0) close(pipe_fds[i][0]);
-if (pipe_fds[i][1] >= 0) close(pipe_fds[i][1]);
-
+void free_cmd_group(CommandGroup *group) {
+    if (group) {
+        for (int i = 0; i < group->num_commands; i++) free(group->commands[i].words);
+        free(group->commands);
+        free(group->text);
+        free(group);
+    }
 }
 
+static bool is_output(const Redirection *r) {
+    return r->type == REDIR_OUT || r->type == REDIR_APPEND || r->type == REDIR_TEE;
+}
 
+// Two or more output targets on 'fd', or a `>+` among them
+static bool needs_fanout(const SimpleCommand *cmd, int fd) {
+    int outputs = 0;
+    for (int j = 0; j < cmd->redirection_count; j++) {
+        const Redirection *r = &cmd->redirections[j];
+        if (r->fd != fd || !is_output(r)) continue;
+        if (r->type == REDIR_TEE) return true;
+        outputs++;
+    }
+    return outputs > 1;
+}
 
-if (!is_background) {
-    int status;
-    pid_t pid;
-    bool job_stopped = false;
-    int active_procs = group->num_commands;  // Track how many processes are still active
-
-    if (isatty(STDIN_FILENO)) {
-        tcsetpgrp(STDIN_FILENO, pgid);
-        
-        // Wait for all processes in the pipeline to complete or for one to be stopped
-        while (active_procs > 0) {
-            pid = waitpid(-pgid, &status, WUNTRACED);
-            
-            if (pid < 0) {
-                if (errno == ECHILD) {
-                    // No more children to wait for
-                    break;
-                }
-                // Interrupted by signal, continue waiting
-                if (errno == EINTR) {
-                    continue;
-                }
-                perror("waitpid");
-                break;
-            }
-            
-            if (WIFSTOPPED(status)) {
-                // A process was stopped, mark the job as stopped
-                job_stopped = true;
-                break;  // Stop waiting and give control back to shell
-            } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
-                // A process has completed, decrement counter
-                active_procs--;
-            }
+// Opens every output target of 'fd' and starts a relay that copies what the
+// command writes to the returned pipe to all of them (see fanout.h). With a
+// `>+` target, whatever 'fd' pointed at so far is a target as well. Returns
+// -1 after reporting an error.
+static int start_fanout(SimpleCommand *cmd, int fd) {
+    int targets[FANOUT_MAX + 1];
+    int count = 0;
+    bool ok = true, keep_original = false;
+    for (int j = 0; j < cmd->redirection_count; j++) {
+        Redirection *r = &cmd->redirections[j];
+        if (r->fd != fd || !is_output(r)) continue;
+        if (r->type == REDIR_TEE) keep_original = true;
+        if (count == FANOUT_MAX) {
+            fprintf(stderr, "fan-out: too many output targets for descriptor %d (at most %d)\n", fd, FANOUT_MAX);
+            ok = false;
+            break;
         }
-        
-        tcsetpgrp(STDIN_FILENO, SHELL_PGID);
-    } else {
-        // Non-interactive mode has similar logic but simpler
-        while (active_procs > 0) {
-            pid = waitpid(-pgid, &status, WUNTRACED);
-            if (pid < 0) {
-                if (errno == ECHILD) break;
-                if (errno == EINTR) continue;
-                perror("waitpid");
-                break;
-            }
-            
-            if (WIFSTOPPED(status)) {
-                job_stopped = true;
-                break;
-            } else if (WIFEXITED(status) || WIFSIGNALED(status)) {
-                active_procs--;
-            }
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (r->type == REDIR_APPEND ? O_APPEND : O_TRUNC);
+        int target = r->filename ? open(r->filename, flags, 0644) : -1;
+        if (target < 0) {
+            fprintf(stderr, "Unable to create file for writing\n");
+            ok = false;
+            continue;
         }
+        targets[count++] = target;
+    }
+    if (ok && keep_original) {
+        int original = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+        if (original >= 0) targets[count++] = original;
+    }
+    // A single target left, e.g. `>+` onto a closed descriptor, needs no relay
+    if (ok && count == 1) {
+        fcntl(targets[0], F_SETFD, 0);
+        return targets[0];
     }
 
-    if (job_stopped) {
-        jobs_add(pgid, group->commands[0].full_command, STOPPED);
-        printf("[%d]+ Stopped\t\t%s\n", next_job_id - 1, group->commands[0].full_command);
+    int fds[2] = { -1, -1 };
+    pid_t pid = -1;
+    if (ok && relay_count == FANOUT_MAX) {
+        fprintf(stderr, "fan-out: too many output relays (at most %d)\n", FANOUT_MAX);
+        ok = false;
+    }
+    if (ok && pipe(fds) < 0) {
+        perror("pipe");
+        ok = false;
+    }
+    if (ok) {
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
         fflush(stdout);
+        pid = fork();
+        if (pid < 0) { perror("fork"); METRICS.fork_failures++; }
+    }
+    if (pid < 0) {
+        for (int i = 0; i < count; i++) close(targets[i]);
+        if (fds[0] >= 0) { close(fds[0]); close(fds[1]); }
+        return -1;
     }
 
-} else {
-
-jobs_add(pgid, group->commands[0].full_command, RUNNING);
-
+    // In a stage the relay is the process the shell waits for, so it only
+    // exits once the data is out, with the command's status
+    bool relay = in_stage ? pid > 0 : pid == 0;
+    if (relay) {
+        close(fds[1]);
+        signal(SIGPIPE, SIG_IGN);
+        if (!in_stage) setpgid(0, 0);
+        int status = fanout_relay(fds[0], targets, count);
+        if (in_stage) {
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+            status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        }
+        _exit(status);
+    }
+    if (!in_stage) {
+        setpgid(pid, pid);
+        relays[relay_count++] = pid;
+    }
+    close(fds[0]);
+    for (int i = 0; i < count; i++) close(targets[i]);
+    return fds[1];
 }
 
+// Waits for the relays the shell started, or after `exec > a > b` leaves
+// them running as hidden jobs
+static void finish_relays(bool detach) {
+    for (int i = 0; i < relay_count; i++) {
+        if (detach) jobs_add_hidden(relays[i]);
+        else while (waitpid(relays[i], NULL, 0) < 0 && errno == EINTR) {}
+    }
+    relay_count = 0;
 }
 
-// --- END: Replace your run_cmd_group function ---
-
-
+int redirect_push(CommandGroup *group) {
+    if (redirect_count == MAX_REDIRECT_DEPTH) {
+        fprintf(stderr, "Redirections nested too deeply\n");
+        return -1;
+    }
+    SimpleCommand *cmd = &group->commands[0];
+    expand_command(cmd);
+    RedirectFrame *frame = &redirect_stack[redirect_count++];
+    frame->group = group;
+    frame->saved.count = 0;
+    fflush(stdout);
+    int result = apply_redirections(cmd, &frame->saved);
+    memcpy(frame->relays, relays, sizeof(pid_t) * relay_count);
+    frame->relay_count = relay_count;
+    relay_count = 0;
+    if (result < 0) redirect_pop();
+    return result;
+}
 
-// (free_cmd_group can remain the same)
+void redirect_pop(void) {
+    RedirectFrame *frame = &redirect_stack[--redirect_count];
+    fflush(stdout);
+    restore_fds(&frame->saved);
+    for (int i = 0; i < frame->relay_count; i++) {
+        while (waitpid(frame->relays[i], NULL, 0) < 0 && errno == EINTR) {}
+    }
+    release_expansion(&frame->group->commands[0]);
+}
 
-static void free_cmd_group(CommandGroup *group) {
+bool redirect_has_relays(void) {
+    return redirect_count > 0 && redirect_stack[redirect_count - 1].relay_count > 0;
+}
 
-if (group) {
+pid_t subshell_fork(void) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); METRICS.fork_failures++; return -1; }
+    METRICS.forked_commands++;
+
+    if (pid == 0) {
+        signal(SIGINT, SIG_DFL); signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL); signal(SIGTTOU, SIG_DFL);
+        // Like the leader of an `every` job: what it runs joins its group.
+        // Stages it launched through the fork server would be reaped by the
+        // shell, so it forks its own.
+        if (job_pgid == 0) {
+            setpgid(0, 0);
+            job_pgid = getpid();
+        }
+        hidden_job = false;
+        zygote_forget();
+        return 0;
+    }
+    if (job_pgid == 0) setpgid(pid, pid);
+    return pid;
+}
 
-free(group->commands);
+int subshell_wait(pid_t pid, const char *command) {
+    JobLimits none;
+    limits_clear(&none);
+    return finish_job(command, &none, job_pgid ? job_pgid : pid, pid, &pid, 1, false, NULL);
+}
 
-free(group);
+void set_exit_after_line(bool exits) {
+    exit_after = exits;
+    running_groups = 0;
+}
 
+bool exits_after_line(void) {
+    return exit_after && running_groups == 0;
 }
 
+void mark_tail_call(void) {
+    tail_call = true;
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+// tee(), splice() and F_GETPIPE_SZ/F_SETPIPE_SZ are Linux extensions
+#define _GNU_SOURCE
+
+#include "shell.h"
+#include "fanout.h"
+
+// Bounce buffer for targets that cannot be spliced to
+#define FANOUT_COPY_BUF 65536
+
+typedef enum { TARGET_SPLICE, TARGET_COPY, TARGET_FAILED } TargetMode;
+
+static void move_data(int from, int to, size_t len, char *buf, TargetMode *mode);
+static bool write_all(int fd, const char *buf, size_t len);
+
+int fanout_relay(int in, const int *targets, int count) {
+    int scratch[FANOUT_MAX][2];
+    TargetMode modes[FANOUT_MAX + 1];
+    char *buf = malloc(FANOUT_COPY_BUF);
+    if (!buf || count < 2 || count > FANOUT_MAX + 1) { free(buf); return 1; }
+
+    // A scratch pipe as large as 'in' always takes a whole tee() of it
+    int pipe_size = fcntl(in, F_GETPIPE_SZ);
+    int made = 0, status = 0;
+    for (; made < count - 1; made++) {
+        if (pipe(scratch[made]) < 0) { perror("fan-out: pipe"); status = 1; break; }
+        if (pipe_size > 0) fcntl(scratch[made][1], F_SETPIPE_SZ, pipe_size);
+    }
+    for (int i = 0; i < count; i++) modes[i] = TARGET_SPLICE;
+
+    while (status == 0) {
+        // tee() only peeks at 'in'; the data stays there for the next target
+        ssize_t n = tee(in, scratch[0][1], pipe_size > 0 ? (size_t)pipe_size : FANOUT_COPY_BUF, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0) break;
+        if (n < 0) { perror("fan-out: tee"); status = 1; break; }
+        for (int i = 1; i < count - 1 && status == 0; i++) {
+            ssize_t copied;
+            while ((copied = tee(in, scratch[i][1], n, 0)) < 0 && errno == EINTR) {}
+            if (copied != n) { fprintf(stderr, "fan-out: short tee\n"); status = 1; }
+        }
+        if (status != 0) break;
+        for (int i = 0; i < count - 1; i++) move_data(scratch[i][0], targets[i], n, buf, &modes[i]);
+        // The last target takes the data out of 'in' itself
+        move_data(in, targets[count - 1], n, buf, &modes[count - 1]);
+    }
+
+    for (int i = 0; i < made; i++) {
+        close(scratch[i][0]);
+        close(scratch[i][1]);
+    }
+    free(buf);
+    return status;
+}
+
+// Moves exactly 'len' bytes, all already in pipe 'from', to 'to'. After a
+// write error the bytes are still consumed so that the other targets are
+// not held up.
+static void move_data(int from, int to, size_t len, char *buf, TargetMode *mode) {
+    while (len > 0) {
+        if (*mode == TARGET_SPLICE) {
+            ssize_t n = splice(from, NULL, to, NULL, len, SPLICE_F_MOVE);
+            if (n > 0) { len -= n; continue; }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno == EINVAL) { *mode = TARGET_COPY; continue; }
+            if (n < 0 && errno != EPIPE) perror("fan-out");
+            *mode = TARGET_FAILED;
+            continue;
+        }
+        ssize_t n = read(from, buf, len < FANOUT_COPY_BUF ? len : FANOUT_COPY_BUF);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        len -= n;
+        if (*mode == TARGET_COPY && !write_all(to, buf, n)) {
+            if (errno != EPIPE) perror("fan-out");
+            *mode = TARGET_FAILED;
+        }
+    }
+}
+
+static bool write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
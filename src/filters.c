@@ -0,0 +1,473 @@
+// memrchr
+#define _GNU_SOURCE
+
+#include "shell.h"
+#include "filters.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define FILTER_CHUNK (256 * 1024)
+
+typedef struct {
+    const char *pattern;
+    size_t pattern_len;
+    bool invert, count, quiet, numbers;
+    bool prefix;            // Several files: lines start with "name:"
+    const char *name;
+    long long line;         // Number of the next line, for -n
+    long long selected;
+} Grep;
+
+static int run_external(char **args);
+static int open_input(const char *cmd, const char *path, bool verbose);
+static ssize_t read_some(int fd, char *buf, size_t len);
+static int grep_fd(Grep *g, int fd);
+static void grep_block(Grep *g, const char *p, const char *end);
+static void grep_emit(Grep *g, const char *p, const char *end);
+static bool parse_count(char **args, int argc, int *i, long long *n);
+static bool head_fd(int fd, long long n);
+static bool tail_fd(int fd, long long n);
+static size_t tail_start(const char *p, size_t len, long long n);
+static bool wc_fd(int fd, long long counts[3], bool words);
+
+size_t count_newlines(const char *p, size_t n) {
+    size_t count = 0, i = 0;
+#ifdef __SSE2__
+    // Matches are subtracted bytewise (0xff is -1) for up to 255 blocks,
+    // then the byte lanes are summed with psadbw
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= n) {
+        __m128i acc = zero;
+        for (int k = 0; k < 255 && i + 16 <= n; k++, i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(p + i));
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(block, newline));
+        }
+        __m128i sums = _mm_sad_epu8(acc, zero);
+        count += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    }
+#endif
+    for (; i < n; i++) count += p[i] == '\n';
+    return count;
+}
+
+const char* find_fixed(const char *hay, size_t n, const char *needle, size_t m) {
+    if (m == 0) return hay;
+    if (m > n) return NULL;
+    if (m == 1) return memchr(hay, needle[0], n);
+    size_t i = 0;
+#ifdef __SSE2__
+    // Candidates are positions where both the first and the last byte of
+    // the needle match, 16 at a time; only those are compared in full
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            size_t at = i + __builtin_ctz(mask);
+            if (memcmp(hay + at + 1, needle + 1, m - 2) == 0) return hay + at;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    while (i + m <= n) {
+        const char *candidate = memchr(hay + i, needle[0], n - m + 1 - i);
+        if (!candidate) return NULL;
+        if (memcmp(candidate + 1, needle + 1, m - 1) == 0) return candidate;
+        i = candidate - hay + 1;
+    }
+    return NULL;
+}
+
+// grep [-Fvcqn] pattern [file ...]
+int do_grep(char **args, int argc) {
+    Grep g;
+    memset(&g, 0, sizeof(g));
+    int i = 1;
+    bool fixed = false;
+    for (; i < argc && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        if (strcmp(args[i], "--") == 0) { i++; break; }
+        for (const char *c = args[i] + 1; *c; c++) {
+            if (*c == 'F') fixed = true;
+            else if (*c == 'v') g.invert = true;
+            else if (*c == 'c') g.count = true;
+            else if (*c == 'q') g.quiet = true;
+            else if (*c == 'n') g.numbers = true;
+            else return run_external(args);
+        }
+    }
+    if (i == argc) return run_external(args);
+    g.pattern = args[i++];
+    g.pattern_len = strlen(g.pattern);
+    // A basic regular expression is only a fixed string without these
+    if (strchr(g.pattern, '\n') || (!fixed && strpbrk(g.pattern, ".[]*^$\\"))) return run_external(args);
+
+    int files = argc - i;
+    g.prefix = files > 1;
+    bool error = false, any = false;
+    for (int f = 0; f < (files ? files : 1); f++) {
+        const char *path = files ? args[i + f] : "-";
+        int fd = open_input("grep", path, false);
+        if (fd < 0) { error = true; continue; }
+        g.name = strcmp(path, "-") == 0 ? "(standard input)" : path;
+        g.line = 1;
+        g.selected = 0;
+        if (grep_fd(&g, fd) < 0) error = true;
+        if (fd != STDIN_FILENO) close(fd);
+        any |= g.selected > 0;
+        if (g.quiet && any) return 0;
+        if (g.count) {
+            if (g.prefix) printf("%s:", g.name);
+            printf("%lld\n", g.selected);
+        }
+    }
+    return error && !(g.quiet && any) ? 2 : any ? 0 : 1;
+}
+
+// Feeds whole lines to grep_block(); the unterminated tail of a read waits
+// for the next one, and the buffer grows for lines longer than itself
+static int grep_fd(Grep *g, int fd) {
+    size_t capacity = FILTER_CHUNK, kept = 0;
+    char *buf = malloc(capacity);
+    if (!buf) { perror("grep"); return -1; }
+    int result = 0;
+    for (;;) {
+        if (kept == capacity) {
+            char *grown = realloc(buf, capacity * 2);
+            if (!grown) { perror("grep"); result = -1; break; }
+            buf = grown;
+            capacity *= 2;
+        }
+        ssize_t n = read_some(fd, buf + kept, capacity - kept);
+        if (n < 0) {
+            fprintf(stderr, "grep: %s: %s\n", g->name, strerror(errno));
+            result = -1;
+            break;
+        }
+        size_t len = kept + n;
+        if (n == 0) {
+            grep_block(g, buf, buf + len);
+            break;
+        }
+        const char *last = memrchr(buf + kept, '\n', n);
+        size_t end = last ? (size_t)(last - buf) + 1 : 0;
+        grep_block(g, buf, buf + end);
+        kept = len - end;
+        memmove(buf, buf + end, kept);
+        if (g->quiet && g->selected > 0) break;
+    }
+    free(buf);
+    return result;
+}
+
+// Searches a run of whole lines (the last one possibly unterminated). The
+// search spans lines, so non-matching stretches are skipped at SIMD speed
+// and handed on as single blocks.
+static void grep_block(Grep *g, const char *p, const char *end) {
+    const char *cursor = p;
+    while (cursor < end) {
+        const char *hit = find_fixed(cursor, end - cursor, g->pattern, g->pattern_len);
+        const char *line_start = end;
+        if (hit) {
+            const char *newline = memrchr(cursor, '\n', hit - cursor);
+            line_start = newline ? newline + 1 : cursor;
+        }
+        if (g->invert) grep_emit(g, cursor, line_start);
+        else if (g->numbers) g->line += count_newlines(cursor, line_start - cursor);
+        if (!hit) break;
+
+        const char *newline = memchr(hit, '\n', end - hit);
+        const char *next = newline ? newline + 1 : end;
+        if (g->invert) g->line++;
+        else grep_emit(g, line_start, next);
+        cursor = next;
+        if (g->quiet && g->selected > 0) return;
+    }
+}
+
+// Selects the whole lines in [p, end)
+static void grep_emit(Grep *g, const char *p, const char *end) {
+    if (p == end) return;
+    bool unterminated = end[-1] != '\n';
+    size_t lines = count_newlines(p, end - p) + unterminated;
+    g->selected += lines;
+    if (g->count || g->quiet) {
+        g->line += lines;
+        return;
+    }
+    if (!g->prefix && !g->numbers) {
+        fwrite(p, 1, end - p, stdout);
+        if (unterminated) putchar('\n');
+        return;
+    }
+    while (p < end) {
+        const char *newline = memchr(p, '\n', end - p);
+        const char *next = newline ? newline + 1 : end;
+        if (g->prefix) printf("%s:", g->name);
+        if (g->numbers) printf("%lld:", g->line);
+        fwrite(p, 1, next - p, stdout);
+        if (!newline) putchar('\n');
+        g->line++;
+        p = next;
+    }
+}
+
+// head [-n N | -N] [file ...]
+int do_head(char **args, int argc) {
+    long long n = 10;
+    int i = 1;
+    if (!parse_count(args, argc, &i, &n)) return run_external(args);
+    int files = argc - i;
+    bool error = false;
+    for (int f = 0; f < (files ? files : 1); f++) {
+        const char *path = files ? args[i + f] : "-";
+        int fd = open_input("head", path, true);
+        if (fd < 0) { error = true; continue; }
+        if (files > 1) printf("%s==> %s <==\n", f ? "\n" : "", path);
+        if (!head_fd(fd, n)) error = true;
+        if (fd != STDIN_FILENO) close(fd);
+    }
+    return error ? 1 : 0;
+}
+
+// Copies the first 'n' lines and stops reading; a writer upstream then
+// gets SIGPIPE instead of producing the rest
+static bool head_fd(int fd, long long n) {
+    char buf[FILTER_CHUNK];
+    while (n > 0) {
+        ssize_t got = read_some(fd, buf, sizeof(buf));
+        if (got < 0) { perror("head"); return false; }
+        if (got == 0) break;
+        size_t lines = count_newlines(buf, got);
+        if ((long long)lines < n) {
+            fwrite(buf, 1, got, stdout);
+            n -= lines;
+            continue;
+        }
+        const char *p = buf;
+        while (n-- > 0) p = (const char *)memchr(p, '\n', buf + got - p) + 1;
+        fwrite(buf, 1, p - buf, stdout);
+    }
+    return true;
+}
+
+// tail [-n N | -N] [file ...]
+int do_tail(char **args, int argc) {
+    long long n = 10;
+    int i = 1;
+    if (!parse_count(args, argc, &i, &n)) return run_external(args);
+    int files = argc - i;
+    bool error = false;
+    for (int f = 0; f < (files ? files : 1); f++) {
+        const char *path = files ? args[i + f] : "-";
+        int fd = open_input("tail", path, true);
+        if (fd < 0) { error = true; continue; }
+        if (files > 1) printf("%s==> %s <==\n", f ? "\n" : "", path);
+        if (!tail_fd(fd, n)) error = true;
+        if (fd != STDIN_FILENO) close(fd);
+    }
+    return error ? 1 : 0;
+}
+
+// A regular file is read backwards from the end, a block at a time, until
+// it holds 'n' lines; anything else is read through, keeping only a suffix
+// that still holds the last 'n' lines
+static bool tail_fd(int fd, long long n) {
+    struct stat st;
+    // Files in /proc and the like report a size of 0 and are read through
+    off_t size = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 ? lseek(fd, 0, SEEK_END) : -1;
+    size_t capacity = FILTER_CHUNK, len = 0;
+    char *buf = malloc(capacity);
+    if (!buf) { perror("tail"); return false; }
+
+    bool ok = true;
+    if (size >= 0) {
+        // Whole blocks from the end, prepended, until the lines are there
+        off_t offset = size;
+        while (offset > 0 && (len == 0 || tail_start(buf, len, n) == 0)) {
+            size_t block = offset < FILTER_CHUNK ? (size_t)offset : FILTER_CHUNK;
+            if (len + block > capacity) {
+                char *grown = realloc(buf, capacity * 2);
+                if (!grown) { perror("tail"); ok = false; break; }
+                buf = grown;
+                capacity *= 2;
+            }
+            memmove(buf + block, buf, len);
+            offset -= block;
+            if (pread(fd, buf, block, offset) != (ssize_t)block) { perror("tail"); ok = false; break; }
+            len += block;
+        }
+    } else {
+        for (;;) {
+            if (len == capacity) {
+                size_t start = tail_start(buf, len, n);
+                if (start > 0) {
+                    memmove(buf, buf + start, len - start);
+                    len -= start;
+                } else {
+                    char *grown = realloc(buf, capacity * 2);
+                    if (!grown) { perror("tail"); ok = false; break; }
+                    buf = grown;
+                    capacity *= 2;
+                }
+            }
+            ssize_t got = read_some(fd, buf + len, capacity - len);
+            if (got < 0) { perror("tail"); ok = false; break; }
+            if (got == 0) break;
+            len += got;
+        }
+    }
+    if (ok) {
+        size_t start = tail_start(buf, len, n);
+        fwrite(buf + start, 1, len - start, stdout);
+    }
+    free(buf);
+    return ok;
+}
+
+// Offset of the first of the last 'n' lines in p[0..len), an unterminated
+// final line counting as one; 0 if there are no more than 'n'
+static size_t tail_start(const char *p, size_t len, long long n) {
+    if (n == 0) return len;
+    size_t end = len > 0 && p[len - 1] == '\n' ? len - 1 : len;
+    while (n-- > 0) {
+        const char *newline = memrchr(p, '\n', end);
+        if (!newline) return 0;
+        end = newline - p;
+    }
+    return end + 1;
+}
+
+// wc [-lwc] [file ...]
+int do_wc(char **args, int argc) {
+    bool show[3] = { false, false, false };     // lines, words, bytes
+    int i = 1;
+    for (; i < argc && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        if (strcmp(args[i], "--") == 0) { i++; break; }
+        for (const char *c = args[i] + 1; *c; c++) {
+            if (*c == 'l') show[0] = true;
+            else if (*c == 'w') show[1] = true;
+            else if (*c == 'c') show[2] = true;
+            else return run_external(args);
+        }
+    }
+    if (!show[0] && !show[1] && !show[2]) show[0] = show[1] = show[2] = true;
+
+    int files = argc - i, inputs = files ? files : 1;
+    int fds[inputs];
+    long long counts[inputs][3];
+    long long total[3] = { 0, 0, 0 };
+    bool error = false;
+
+    // Like coreutils: a single number is printed bare, otherwise columns are
+    // as wide as the total size of the inputs, and at least 7 when one of
+    // them is not a regular file
+    off_t size = 0;
+    bool irregular = false;
+    for (int f = 0; f < inputs; f++) {
+        fds[f] = open_input("wc", files ? args[i + f] : "-", false);
+        struct stat st;
+        if (fds[f] >= 0 && fstat(fds[f], &st) == 0 && S_ISREG(st.st_mode)) size += st.st_size;
+        else if (fds[f] >= 0) irregular = true;
+    }
+    int width = 1;
+    if (show[0] + show[1] + show[2] > 1 || files > 1) {
+        for (off_t s = size; s >= 10; s /= 10) width++;
+        if (irregular && width < 7) width = 7;
+    }
+
+    for (int f = 0; f < inputs; f++) {
+        if (fds[f] < 0) { error = true; continue; }
+        if (!wc_fd(fds[f], counts[f], show[1])) error = true;
+        if (fds[f] != STDIN_FILENO) close(fds[f]);
+        bool first = true;
+        for (int k = 0; k < 3; k++) {
+            total[k] += counts[f][k];
+            if (!show[k]) continue;
+            printf(first ? "%*lld" : " %*lld", width, counts[f][k]);
+            first = false;
+        }
+        if (files) printf(" %s", args[i + f]);
+        putchar('\n');
+    }
+    if (files > 1) {
+        bool first = true;
+        for (int k = 0; k < 3; k++) {
+            if (!show[k]) continue;
+            printf(first ? "%*lld" : " %*lld", width, total[k]);
+            first = false;
+        }
+        printf(" total\n");
+    }
+    return error ? 1 : 0;
+}
+
+// Lines and bytes at SIMD speed; words, when asked for, need a byte loop
+static bool wc_fd(int fd, long long counts[3], bool words) {
+    char buf[FILTER_CHUNK];
+    bool in_word = false;
+    counts[0] = counts[1] = counts[2] = 0;
+    for (;;) {
+        ssize_t got = read_some(fd, buf, sizeof(buf));
+        if (got < 0) { perror("wc"); return false; }
+        if (got == 0) return true;
+        counts[0] += count_newlines(buf, got);
+        counts[2] += got;
+        if (!words) continue;
+        for (ssize_t k = 0; k < got; k++) {
+            char c = buf[k];
+            bool space = c == ' ' || (c >= '\t' && c <= '\r');
+            if (!space && !in_word) counts[1]++;
+            in_word = !space;
+        }
+    }
+}
+
+// -n N, -nN or -N; anything else is left to the real utility
+static bool parse_count(char **args, int argc, int *i, long long *n) {
+    for (; *i < argc && args[*i][0] == '-' && args[*i][1] != '\0'; (*i)++) {
+        const char *value;
+        if (strcmp(args[*i], "--") == 0) { (*i)++; break; }
+        if (strcmp(args[*i], "-n") == 0) {
+            if (*i + 1 == argc) return false;
+            value = args[++*i];
+        } else if (args[*i][1] == 'n') {
+            value = args[*i] + 2;
+        } else {
+            value = args[*i] + 1;
+        }
+        char *end;
+        errno = 0;
+        *n = strtoll(value, &end, 10);
+        if (end == value || *end || errno || *n < 0 || *value == '+' || *value == '-') return false;
+    }
+    return true;
+}
+
+// The fallback: this runs in a forked pipeline stage, so the real utility
+// can simply replace it
+static int run_external(char **args) {
+    fflush(stdout);
+    execvp(args[0], args);
+    fprintf(stderr, "%s: Command not found!\n", args[0]);
+    return 127;
+}
+
+// The message follows the utility: head and tail use the 'verbose' form
+static int open_input(const char *cmd, const char *path, bool verbose) {
+    if (strcmp(path, "-") == 0) return STDIN_FILENO;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 && verbose) fprintf(stderr, "%s: cannot open '%s' for reading: %s\n", cmd, path, strerror(errno));
+    else if (fd < 0) fprintf(stderr, "%s: %s: %s\n", cmd, path, strerror(errno));
+    return fd;
+}
+
+static ssize_t read_some(int fd, char *buf, size_t len) {
+    ssize_t n;
+    while ((n = read(fd, buf, len)) < 0 && errno == EINTR);
+    return n;
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+// memfd_create() and the F_ADD_SEALS fcntl are GNU extensions
+#define _GNU_SOURCE
+
+#include "shell.h"
+#include "heredoc.h"
+
+#include <sys/mman.h>
+
+// Payloads up to this size are first tried in a pipe, which is cheaper to set
+// up than a memfd. The write is non-blocking, so a smaller pipe just falls
+// back to the memfd.
+#define HEREDOC_PIPE_MAX 65536
+
+// Characters that would end or split a word, plus the escape itself
+static const char ESCAPED[] = " \t\r\n%;&|<>()";
+
+static int hex_value(char ch);
+static int pipe_fd(const char *data, size_t len);
+static int memfd(const char *data, size_t len);
+
+char* heredoc_encode(const char *body, size_t len, bool literal) {
+    char *word = malloc(HEREDOC_PREFIX_LEN + len * 3 + 1);
+    if (!word) { perror("malloc"); exit(EXIT_FAILURE); }
+    memcpy(word, literal ? "<<:" : "<<=", HEREDOC_PREFIX_LEN);
+    char *out = word + HEREDOC_PREFIX_LEN;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char ch = body[i];
+        if (ch && strchr(ESCAPED, ch)) out += sprintf(out, "%%%02X", ch);
+        else *out++ = ch;
+    }
+    *out = '\0';
+    return word;
+}
+
+char* heredoc_decode(const char *word, bool *literal) {
+    *literal = word[2] == ':';
+    word += HEREDOC_PREFIX_LEN;
+    char *body = malloc(strlen(word) + 1);
+    if (!body) { perror("malloc"); exit(EXIT_FAILURE); }
+    char *out = body;
+    for (const char *p = word; *p; p++) {
+        int high, low;
+        if (*p == '%' && (high = hex_value(p[1])) >= 0 && (low = hex_value(p[2])) >= 0) {
+            *out++ = (char)(high << 4 | low);
+            p += 2;
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+    return body;
+}
+
+char* heredoc_strip(const char *line) {
+    char *copy = strdup(line);
+    if (!copy) { perror("strdup"); exit(EXIT_FAILURE); }
+    char *out = copy;
+    for (const char *p = line; *p; ) {
+        // read_heredocs() puts each word after a blank, and bodies have none
+        bool word_start = p == line || p[-1] == ' ' || p[-1] == '\t';
+        if (word_start && (strncmp(p, "<<=", HEREDOC_PREFIX_LEN) == 0 || strncmp(p, "<<:", HEREDOC_PREFIX_LEN) == 0)) {
+            memcpy(out, p, HEREDOC_PREFIX_LEN);
+            out += HEREDOC_PREFIX_LEN;
+            p += HEREDOC_PREFIX_LEN + strcspn(p + HEREDOC_PREFIX_LEN, " \t");
+        } else {
+            *out++ = *p++;
+        }
+    }
+    *out = '\0';
+    return copy;
+}
+
+int heredoc_fd(const char *data, size_t len) {
+    if (len <= HEREDOC_PIPE_MAX) {
+        int fd = pipe_fd(data, len);
+        if (fd >= 0) return fd;
+    }
+    return memfd(data, len);
+}
+
+static int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    return -1;
+}
+
+static int pipe_fd(const char *data, size_t len) {
+    int fds[2];
+    if (pipe(fds) < 0) return -1;
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fds[1], data + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    close(fds[1]);
+    if (done < len) { close(fds[0]); return -1; }
+    return fds[0];
+}
+
+static int memfd(const char *data, size_t len) {
+    int fd = memfd_create("heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) { perror("memfd_create"); return -1; }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) { perror("write"); close(fd); return -1; }
+        done += n;
+    }
+    // The reader gets a frozen copy: no writes, no resizing, no unsealing
+    fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
\ No newline at end of file
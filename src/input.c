@@ -1,11 +1,50 @@
 #include "shell.h"
 #include "input.h"
+#include "script.h"
+#include "heredoc.h"
+#include "parser.h"
+#include "events.h"
+
+#include <ctype.h>
+
+// Set by input_from_string(): lines come from here instead of stdin
+static const char *string_input = NULL;
+
+// Continuation prompts only make sense for a user typing at a terminal
+static bool prompting(void) {
+    return !string_input && isatty(STDIN_FILENO);
+}
+
+void input_from_string(const char *text) {
+    string_input = text;
+}
+
+bool input_exhausted(void) {
+    return string_input && *string_input == '\0';
+}
 
 char *read_input(void) {
     char *line = NULL;
     size_t len = 0;
     ssize_t nread;
 
+    if (string_input) {
+        if (*string_input == '\0') return NULL;
+        size_t n = strcspn(string_input, "\n");
+        line = strndup(string_input, n);
+        if (!line) { perror("strndup"); exit(EXIT_FAILURE); }
+        string_input += n + (string_input[n] == '\n');
+        return line;
+    }
+
+    // Job timers keep running while the shell waits for a line. A terminal
+    // hands over one line per read, so stdio has nothing buffered here and
+    // polling the descriptor is safe; other input is read without waiting.
+    events_dispatch();
+    if (isatty(STDIN_FILENO)) {
+        while (events_wait_readable(STDIN_FILENO) < 0 && errno == EINTR && !INTERRUPTED);
+    }
+
     nread = getline(&line, &len, stdin);
 
     if (nread == -1) {
@@ -20,4 +59,139 @@ char *read_input(void) {
     }
 
     return line;
+}
+
+// Appends 'line' to 'text', separated so the result is still valid on one
+// line: "do" + "echo" becomes "do; echo", "echo a;" + "done" becomes "echo a; done"
+static char *join_line(char *text, const char *line) {
+    size_t len = strlen(text);
+    size_t end = len;
+    while (end > 0 && isspace((unsigned char)text[end - 1])) end--;
+    const char *separator = (end == 0 || text[end - 1] == ';' || text[end - 1] == '&') ? " " : "; ";
+    char *joined = realloc(text, len + strlen(separator) + strlen(line) + 1);
+    if (!joined) { perror("realloc"); exit(EXIT_FAILURE); }
+    strcat(joined, separator);
+    strcat(joined, line);
+    return joined;
+}
+
+char *read_command(void) {
+    char *line = read_input();
+    if (!line) return NULL;
+    line = read_heredocs(line);
+    if (script_is_compound(line)) line = read_compound_input(line);
+    return line;
+}
+
+char *read_compound_input(char *text) {
+    Program *program;
+    CompileResult result = script_compile(text, true, &program);
+    while (result == COMPILE_INCOMPLETE) {
+        if (prompting()) { printf("> "); fflush(stdout); }
+        char *line = read_input();
+        if (!line) break;    // EOF: the caller reports the unfinished command
+        line = read_heredocs(line);
+        text = join_line(text, line);
+        // Only a closing keyword, `}` or `)` can complete the input, so
+        // skip the recompile for body lines
+        bool may_close = strstr(line, "done") || strstr(line, "fi") || strstr(line, "esac") || strpbrk(line, "})");
+        free(line);
+        if (may_close) result = script_compile(text, true, &program);
+    }
+    script_free(program);
+    return text;
+}
+
+// Reads lines up to 'delim' and returns them as one string. With 'strip_tabs'
+// (<<-) leading tabs are removed from every line, including the delimiter.
+static char *read_heredoc_body(const char *delim, bool strip_tabs, size_t *len) {
+    size_t capacity = 256;
+    char *body = malloc(capacity);
+    if (!body) { perror("malloc"); exit(EXIT_FAILURE); }
+    *len = 0;
+    for (;;) {
+        if (prompting()) { printf("> "); fflush(stdout); }
+        char *line = read_input();
+        if (!line) break;
+        char *text = line;
+        if (strip_tabs) text += strspn(text, "\t");
+        if (strcmp(text, delim) == 0) { free(line); break; }
+        size_t n = strlen(text);
+        if (*len + n + 2 > capacity) {
+            while (*len + n + 2 > capacity) capacity *= 2;
+            body = realloc(body, capacity);
+            if (!body) { perror("realloc"); exit(EXIT_FAILURE); }
+        }
+        memcpy(body + *len, text, n);
+        *len += n;
+        body[(*len)++] = '\n';
+        free(line);
+    }
+    body[*len] = '\0';
+    return body;
+}
+
+// Growable output line for read_heredocs()
+typedef struct {
+    char *data;
+    size_t len, capacity;
+} LineBuffer;
+
+static void line_append(LineBuffer *b, const char *s, size_t n) {
+    if (b->len + n + 1 > b->capacity) {
+        b->capacity = (b->len + n + 1) * 2;
+        b->data = realloc(b->data, b->capacity);
+        if (!b->data) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+}
+
+char *read_heredocs(char *line) {
+    if (!strstr(line, "<<")) return line;
+
+    LineBuffer out = { NULL, 0, 0 };
+    const char *p = line;
+    while (*p) {
+        size_t run = shell_strcspn(p, "<");
+        if (p[run] == '\0') { line_append(&out, p, run); break; }
+        // '<' and '<<<' are copied as they are
+        size_t op_len = strncmp(p + run, "<<<", 3) == 0 ? 3 : strncmp(p + run, "<<", 2) == 0 ? 2 : 1;
+        if (op_len != 2) {
+            line_append(&out, p, run + op_len);
+            p += run + op_len;
+            continue;
+        }
+
+        // <<[-]DELIM
+        const char *delim_start = p + run + 2;
+        bool strip_tabs = *delim_start == '-';
+        if (strip_tabs) delim_start++;
+        delim_start += strspn(delim_start, " \t");
+        size_t delim_len = strcspn(delim_start, " \t;&|<>()");
+        if (delim_len == 0) {
+            // Left for the syntax check to reject
+            line_append(&out, p, run + 2);
+            p += run + 2;
+            continue;
+        }
+
+        // A quoted delimiter ('EOF' or "EOF") turns off expansion in the body
+        bool literal = delim_len >= 2 && (*delim_start == '\'' || *delim_start == '"') && delim_start[delim_len - 1] == *delim_start;
+        char *delim = literal ? strndup(delim_start + 1, delim_len - 2) : strndup(delim_start, delim_len);
+        size_t body_len;
+        char *body = read_heredoc_body(delim, strip_tabs, &body_len);
+        char *word = heredoc_encode(body, body_len, literal);
+
+        line_append(&out, p, run);
+        line_append(&out, " ", 1);
+        line_append(&out, word, strlen(word));
+        p = delim_start + delim_len;
+        free(word);
+        free(body);
+        free(delim);
+    }
+    free(line);
+    return out.data ? out.data : strdup("");
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include "intrinsics.h"
 #include "executor.h"
 #include "jobs.h"
+#include "walker.h"
+#include "dirlist.h"
+#include "metrics.h"
 
 #define MAX_LOG_SIZE 15
 
@@ -10,54 +13,31 @@ static char* command_log[MAX_LOG_SIZE];
 static int log_count = 0;
 static int log_start = 0;
 
-// Forward declarations for all intrinsic command functions
-static void do_hop(char **args, int argc);
-static void do_reveal(char **args, int argc);
-static void do_log(char **args, int argc);
+// Forward declarations for internal helpers
 static char* get_log_path(void);
-static int compare_strings(const void *a, const void *b);
-
-
-// Main dispatcher for all intrinsic commands
-bool handle_intrinsic(char **args, int argc) {
-    if (strcmp(args[0], "hop") == 0) { do_hop(args, argc); return true; }
-    if (strcmp(args[0], "reveal") == 0) { do_reveal(args, argc); return true; }
-    if (strcmp(args[0], "log") == 0) { do_log(args, argc); return true; }
-    if (strcmp(args[0], "activities") == 0) { do_activities(); return true; }
-    if (strcmp(args[0], "ping") == 0) { do_ping(args, argc); return true; }
-    if (strcmp(args[0], "fg") == 0) { do_fg(args, argc); return true; }
-    if (strcmp(args[0], "bg") == 0) { do_bg(args, argc); return true; }
-    return false;
-}
 
-bool is_parent_builtin(const char* cmd) {
-    if (strcmp(cmd, "hop") == 0) {
-        return true;
-    }
-    // In the future, you might add "exit", "export", etc. here.
-    return false;
-}
 // B.1: hop command logic (Corrected Version)
-static void do_hop(char **args, int argc) {
+int do_hop(char **args, int argc) {
+    int status = 0;
     if (argc == 1) { // hop or hop ~
         char current_dir[PATH_MAX];
-        if (getcwd(current_dir, sizeof(current_dir)) == NULL) { perror("getcwd"); return; }
+        if (getcwd(current_dir, sizeof(current_dir)) == NULL) { perror("getcwd"); return 1; }
         if (chdir(SHELL_HOME) == 0) {
             strncpy(PREVIOUS_CWD, current_dir, sizeof(PREVIOUS_CWD) - 1);
             PREVIOUS_CWD_IS_SET = true;
         }
-        return;
+        return 0;
     }
 
     for (int i = 1; i < argc; i++) {
         char current_dir[PATH_MAX];
-        if (getcwd(current_dir, sizeof(current_dir)) == NULL) { perror("getcwd"); return; }
+        if (getcwd(current_dir, sizeof(current_dir)) == NULL) { perror("getcwd"); return 1; }
 
         char *target = args[i];
         int chdir_res = -1;
 
         if (strcmp(target, "-") == 0) {
-            if (!PREVIOUS_CWD_IS_SET) { fprintf(stderr, "hop: OLDPWD not set\n"); continue; }
+            if (!PREVIOUS_CWD_IS_SET) { fprintf(stderr, "hop: OLDPWD not set\n"); status = 1; continue; }
             char temp[PATH_MAX];
             strncpy(temp, PREVIOUS_CWD, sizeof(temp) - 1);
             printf("%s\n", PREVIOUS_CWD);
@@ -74,29 +54,36 @@ static void do_hop(char **args, int argc) {
                 PREVIOUS_CWD_IS_SET = true; // FIX: Set the flag on any successful hop
             } else {
                 fprintf(stderr, "No such directory!\n");
+                status = 1;
             }
         }
     }
+    return status;
 }
 
 // B.2: reveal command logic (Corrected Version)
-static void do_reveal(char **args, int argc) {
-    bool show_all = false, line_by_line = false;
+int do_reveal(char **args, int argc) {
+    bool show_all = false, line_by_line = false, recursive = false, long_format = false;
+    SortKey sort_key = SORT_NAME;
     char *path_arg = NULL;
 
     for (int i = 1; i < argc; i++) {
         if (args[i][0] == '-') {
             if (strlen(args[i]) == 1) {
-                if (path_arg != NULL) { fprintf(stderr, "reveal: Invalid Syntax!\n"); return; }
+                if (path_arg != NULL) { fprintf(stderr, "reveal: Invalid Syntax!\n"); return 1; }
                 path_arg = args[i];
                 continue;
             }
             for (size_t j = 1; j < strlen(args[i]); j++) {
                 if (args[i][j] == 'a') show_all = true;
                 else if (args[i][j] == 'l') line_by_line = true;
+                else if (args[i][j] == 'R') recursive = true;
+                else if (args[i][j] == 'L') long_format = true;
+                else if (args[i][j] == 'S') sort_key = SORT_SIZE;
+                else if (args[i][j] == 't') sort_key = SORT_MTIME;
             }
         } else {
-            if (path_arg != NULL) { fprintf(stderr, "reveal: Invalid Syntax!\n"); return; }
+            if (path_arg != NULL) { fprintf(stderr, "reveal: Invalid Syntax!\n"); return 1; }
             path_arg = args[i];
         }
     }
@@ -104,7 +91,7 @@ static void do_reveal(char **args, int argc) {
     char target_path[PATH_MAX];
     if (path_arg == NULL) { getcwd(target_path, sizeof(target_path)); }
     else if (strcmp(path_arg, "-") == 0) {
-        if (!PREVIOUS_CWD_IS_SET) { fprintf(stderr, "No such directory!\n"); return; } // FIX: Check flag
+        if (!PREVIOUS_CWD_IS_SET) { fprintf(stderr, "No such directory!\n"); return 1; } // FIX: Check flag
         strncpy(target_path, PREVIOUS_CWD, sizeof(target_path));
     } else if (strcmp(path_arg, "~") == 0) strncpy(target_path, SHELL_HOME, sizeof(target_path));
     else if (strcmp(path_arg, ".") == 0) getcwd(target_path, sizeof(target_path));
@@ -117,33 +104,58 @@ static void do_reveal(char **args, int argc) {
          strncpy(target_path, path_arg, sizeof(target_path));
     }
 
+    if (recursive) {
+        // REVEAL_THREADS overrides the default of one worker per core
+        const char *threads_env = getenv("REVEAL_THREADS");
+        WalkOptions opts = { show_all, line_by_line, long_format, sort_key, threads_env ? atoi(threads_env) : 0 };
+        return walk_tree(target_path, path_arg ? path_arg : ".", &opts) == 0 ? 0 : 1;
+    }
+
     DIR *d = opendir(target_path);
-    if (!d) { fprintf(stderr, "No such directory!\n"); return; }
-    
-    char *files[2048]; int file_count = 0;
+    if (!d) { fprintf(stderr, "No such directory!\n"); return 1; }
+
+    int file_cap = 256, file_count = 0;
+    DirEntry *files = malloc(file_cap * sizeof(DirEntry));
+    if (!files) { perror("malloc"); closedir(d); return 1; }
     struct dirent *dir;
     while ((dir = readdir(d)) != NULL) {
         if (!show_all && dir->d_name[0] == '.') continue;
-        files[file_count++] = strdup(dir->d_name);
+        if (file_count == file_cap) {
+            DirEntry *grown = realloc(files, file_cap * 2 * sizeof(DirEntry));
+            if (!grown) {
+                perror("realloc");
+                for (int i = 0; i < file_count; i++) free(files[i].name);
+                free(files);
+                closedir(d);
+                return 1;
+            }
+            files = grown;
+            file_cap *= 2;
+        }
+        memset(&files[file_count], 0, sizeof(DirEntry));
+        files[file_count++].name = strdup(dir->d_name);
     }
-    closedir(d);
-    qsort(files, file_count, sizeof(char *), compare_strings);
-    for (int i = 0; i < file_count; i++) {
-        printf("%s%s", files[i], line_by_line ? "\n" : "  ");
-        free(files[i]);
+
+    // Metadata is only fetched when it is displayed or sorted on, and then in
+    // one batch through io_uring rather than a stat() per entry
+    if (long_format || sort_key != SORT_NAME) {
+        StatRing *ring = stat_ring_open();
+        stat_entries(ring, dirfd(d), files, file_count);
+        stat_ring_close(ring);
     }
-    if (!line_by_line && file_count > 0) printf("\n");
+    closedir(d);
+
+    sort_entries(files, file_count, sort_key);
+    print_entries(files, file_count, line_by_line, long_format);
+    for (int i = 0; i < file_count; i++) free(files[i].name);
+    free(files);
+    return 0;
 }
 
 
 // (The rest of the functions: log, activities, ping, fg, bg, etc. remain the same)
-// Helper for qsort
-static int compare_strings(const void *a, const void *b) {
-    return strcmp(*(const char **)a, *(const char **)b);
-}
-
 // B.3: log command logic
-static void do_log(char **args, int argc) {
+int do_log(char **args, int argc) {
     if (argc == 1) {
         for (int i = 0; i < log_count; i++) {
             printf("%s\n", command_log[(log_start + i) % MAX_LOG_SIZE]);
@@ -151,6 +163,7 @@ static void do_log(char **args, int argc) {
     } else if (argc == 2 && strcmp(args[1], "purge") == 0) {
         for (int i = 0; i < log_count; i++) free(command_log[i]);
         log_count = 0; log_start = 0;
+        METRICS.history_entries = 0;
         FILE *f = fopen(get_log_path(), "w");
         if (f) fclose(f);
     } else if (argc == 3 && strcmp(args[1], "execute") == 0) {
@@ -160,11 +173,13 @@ static void do_log(char **args, int argc) {
             // Just print the command for user feedback
             int actual_index = (log_start + log_count - index) % MAX_LOG_SIZE;
             printf("%s\n", command_log[actual_index]);
-            return;
+            return 0;
         } else {
             fprintf(stderr, "log: invalid index\n");
+            return 1;
         }
     }
+    return 0;
 }
 
 // Helper for log persistence
@@ -199,11 +214,13 @@ void log_add(const char *command) {
         log_count++;
     }
     command_log[(log_start + log_count - 1) % MAX_LOG_SIZE] = strdup(command);
+    METRICS.history_entries = log_count;
 
     FILE *f = fopen(get_log_path(), "w");
     if (!f) return;
     for (int i = 0; i < log_count; i++) {
-        fprintf(f, "%s\n", command_log[(log_start + i) % MAX_LOG_SIZE]);
+        int written = fprintf(f, "%s\n", command_log[(log_start + i) % MAX_LOG_SIZE]);
+        if (written > 0) METRICS.history_bytes += written;
     }
     fclose(f);
 }
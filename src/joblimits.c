@@ -0,0 +1,108 @@
+#include "shell.h"
+#include "joblimits.h"
+
+static bool parse_duration(const char *text, double *seconds);
+static bool parse_size(const char *text, rlim_t *bytes);
+static void format_size(rlim_t bytes, char *buf, size_t size);
+
+void limits_clear(JobLimits *limits) {
+    limits->timeout = 0;
+    limits->memory = RLIM_INFINITY;
+    limits->files = RLIM_INFINITY;
+}
+
+bool limits_any(const JobLimits *limits) {
+    return limits->timeout > 0 || limits->memory != RLIM_INFINITY || limits->files != RLIM_INFINITY;
+}
+
+int limits_parse(char **words, int count, JobLimits *limits) {
+    int i = 0;
+    while (i < count && words[i][0] == '-' && words[i][1] && !words[i][2]) {
+        char option = words[i][1];
+        const char *value = i + 1 < count ? words[i + 1] : NULL;
+        bool ok = false;
+        if (value && option == 't') ok = parse_duration(value, &limits->timeout) && limits->timeout > 0;
+        else if (value && option == 'm') ok = parse_size(value, &limits->memory);
+        else if (value && option == 'n') ok = parse_size(value, &limits->files);
+        else if (option != 't' && option != 'm' && option != 'n') {
+            fprintf(stderr, "limit: -%c: invalid option\n", option);
+            return -1;
+        }
+        if (!ok) {
+            fprintf(stderr, "limit: -%c: invalid value '%s'\n", option, value ? value : "");
+            return -1;
+        }
+        i += 2;
+    }
+    if (i == count) {
+        fprintf(stderr, "limit: usage: limit [-t duration] [-m size] [-n count] command\n");
+        return -1;
+    }
+    return i;
+}
+
+int limits_apply(const JobLimits *limits) {
+    struct { int resource; rlim_t value; const char *name; } wanted[] = {
+        { RLIMIT_AS, limits->memory, "memory" },
+        { RLIMIT_NOFILE, limits->files, "open files" },
+    };
+    for (size_t i = 0; i < sizeof(wanted) / sizeof(wanted[0]); i++) {
+        if (wanted[i].value == RLIM_INFINITY) continue;
+        struct rlimit rl = { wanted[i].value, wanted[i].value };
+        if (setrlimit(wanted[i].resource, &rl) < 0) {
+            fprintf(stderr, "limit: %s: %s\n", wanted[i].name, strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void limits_format(const JobLimits *limits, char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    if (limits->timeout > 0 && len < size) len += snprintf(buf + len, size - len, "-t %gs", limits->timeout);
+    if (limits->memory != RLIM_INFINITY && len < size) {
+        char text[32];
+        format_size(limits->memory, text, sizeof(text));
+        len += snprintf(buf + len, size - len, "%s-m %s", len ? " " : "", text);
+    }
+    if (limits->files != RLIM_INFINITY && len < size) {
+        snprintf(buf + len, size - len, "%s-n %llu", len ? " " : "", (unsigned long long)limits->files);
+    }
+}
+
+// "90", "90s", "1.5m", "2h", "250ms"
+static bool parse_duration(const char *text, double *seconds) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || value < 0) return false;
+    if (strcmp(end, "") == 0 || strcmp(end, "s") == 0) *seconds = value;
+    else if (strcmp(end, "ms") == 0) *seconds = value / 1000;
+    else if (strcmp(end, "m") == 0) *seconds = value * 60;
+    else if (strcmp(end, "h") == 0) *seconds = value * 3600;
+    else return false;
+    return true;
+}
+
+// "1024", "512K", "2G" (powers of 1024)
+static bool parse_size(const char *text, rlim_t *bytes) {
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text || text[0] == '-') return false;
+    const char *units = "KMGT";
+    if (*end) {
+        const char *unit = strchr(units, *end);
+        if (!unit || end[1]) return false;
+        for (const char *u = units; u <= unit; u++) value *= 1024;
+    }
+    *bytes = (rlim_t)value;
+    return true;
+}
+
+static void format_size(rlim_t bytes, char *buf, size_t size) {
+    const char *units = "KMGT";
+    int unit = -1;
+    while (unit < 3 && bytes >= 1024 && bytes % 1024 == 0) { bytes /= 1024; unit++; }
+    if (unit < 0) snprintf(buf, size, "%llu", (unsigned long long)bytes);
+    else snprintf(buf, size, "%llu%c", (unsigned long long)bytes, units[unit]);
+}
\ No newline at end of file
@@ -1,26 +1,54 @@
 #include "jobs.h"
+#include "events.h"
+#include "metrics.h"
+#include "zygote.h"
 
-#define MAX_JOBS 64
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+#define LIMIT_KILL_GRACE 5
+
+// Limits and policy of a running job, foreground or background, keyed by pgid
+typedef struct {
+    pid_t pgid;
+    JobLimits limits;
+    JobSched sched;
+    int timer_fd;       // -1 once no timer is pending
+    bool terminating;   // SIGTERM sent, SIGKILL armed
+    bool active;
+} Watch;
+
+static Watch watches[MAX_JOBS];
 
 // The Job struct is defined in jobs.h
 static Job job_list[MAX_JOBS];
+// Process groups of process substitutions, which `activities` does not list
+static pid_t hidden_jobs[MAX_JOBS];
+static int hidden_count = 0;
 int next_job_id = 1; // Now globally accessible
 
 // Forward declarations for internal helper functions
-static Job* find_job_by_pgid(pid_t pgid);
 static Job* find_job_by_jid(int jid);
 static Job* get_latest_job(void);
+static Watch* find_watch(pid_t pgid);
+static void arm_timer(int fd, double seconds);
+static void on_timeout(int fd, void *data);
+static void reap_hidden(void);
+static void reap_orphans(void);
 
 void jobs_init(void) {
     for (int i = 0; i < MAX_JOBS; i++) {
         job_list[i].active = false;
+        watches[i].active = false;
     }
 }
 
-void jobs_add(pid_t pgid, const char* command, JobState state) {
+void jobs_add(pid_t pgid, const char* command, JobState state, const pid_t *pids, int pid_count) {
     for (int i = 0; i < MAX_JOBS; i++) {
         if (!job_list[i].active) {
             job_list[i].pgid = pgid;
+            job_list[i].pid_count = pid_count < JOB_MAX_PROCS ? pid_count : JOB_MAX_PROCS;
+            memcpy(job_list[i].pids, pids, sizeof(pid_t) * job_list[i].pid_count);
             job_list[i].job_id = next_job_id++;
             job_list[i].state = state;
             strncpy(job_list[i].command, command, sizeof(job_list[i].command) - 1);
@@ -36,22 +64,55 @@ void jobs_add(pid_t pgid, const char* command, JobState state) {
     fprintf(stderr, "shell: Error: too many background jobs\n");
 }
 
+void jobs_add_hidden(pid_t pgid) {
+    // Also called where jobs_reap() never runs, e.g. in an `every` job
+    reap_hidden();
+    if (hidden_count == MAX_JOBS) {
+        fprintf(stderr, "shell: Error: too many process substitutions\n");
+        return;
+    }
+    hidden_jobs[hidden_count++] = pgid;
+}
+
+int jobs_hidden_count(void) {
+    reap_hidden();
+    return hidden_count;
+}
+
+int jobs_count(void) {
+    int count = 0;
+    for (int i = 0; i < MAX_JOBS; i++) if (job_list[i].active) count++;
+    return count;
+}
+
+// Waits on each job's process group rather than on any child: by the time
+// waitpid(-1) returns a pid, the process is gone and its group can no
+// longer be looked up. A group with no children left is done.
 void jobs_reap(void) {
     int status;
     pid_t pid;
-    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0) {
-        Job* job = find_job_by_pgid(getpgid(pid));
-        if (!job) continue;
-
-        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+    double started = METRICS.enabled ? metrics_clock() : 0;
+    reap_hidden();
+    for (int i = 0; i < MAX_JOBS; i++) {
+        Job *job = &job_list[i];
+        if (!job->active) continue;
+        while ((pid = waitpid(-job->pgid, &status, WNOHANG | WUNTRACED)) > 0) {
+            if (WIFSTOPPED(status)) job->state = STOPPED;
+            else if (WIFEXITED(status)) metrics_stage_status(WEXITSTATUS(status));
+        }
+        if (pid < 0 && errno == ECHILD) {
             // Print job completion message immediately for background jobs
             printf("[%d]+ Done\t\t%s\n", job->job_id, job->command);
             fflush(stdout); // Ensure immediate output
             job->active = false;
-        } else if (WIFSTOPPED(status)) {
-            job->state = STOPPED;
+            jobs_unwatch(job->pgid);
         }
     }
+    if (zygote_active()) reap_orphans();
+    if (METRICS.enabled) {
+        METRICS.reap_count++;
+        METRICS.reap_seconds += metrics_clock() - started;
+    }
 }
 
 void jobs_kill_all(void) {
@@ -60,9 +121,77 @@ void jobs_kill_all(void) {
             kill(-job_list[i].pgid, SIGKILL);
         }
     }
+    for (int i = 0; i < hidden_count; i++) kill(-hidden_jobs[i], SIGKILL);
+}
+
+bool jobs_watch(pid_t pgid, const JobLimits *limits, const JobSched *sched) {
+    Watch *w = NULL;
+    for (int i = 0; i < MAX_JOBS && !w; i++) if (!watches[i].active) w = &watches[i];
+    if (!w) {
+        fprintf(stderr, "limit: too many watched jobs (at most %d)\n", MAX_JOBS);
+        return false;
+    }
+    w->pgid = pgid;
+    w->limits = *limits;
+    if (sched) w->sched = *sched;
+    else sched_clear(&w->sched);
+    w->timer_fd = -1;
+    w->terminating = false;
+    w->active = true;
+    if (limits->timeout <= 0) return true;
+
+    w->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (w->timer_fd < 0) {
+        perror("timerfd_create");
+        w->active = false;
+        return false;
+    }
+    arm_timer(w->timer_fd, limits->timeout);
+    if (!events_add(w->timer_fd, on_timeout, w)) {
+        fprintf(stderr, "limit: too many timers\n");
+        close(w->timer_fd);
+        w->active = false;
+        return false;
+    }
+    return true;
+}
+
+void jobs_unwatch(pid_t pgid) {
+    Watch *w = find_watch(pgid);
+    if (!w) return;
+    if (w->timer_fd >= 0) {
+        events_remove(w->timer_fd);
+        close(w->timer_fd);
+    }
+    w->active = false;
 }
 
-void do_activities(void) {
+int jobs_list(Job *out, int max) {
+    int count = 0;
+    for (int id = 1; id < next_job_id && count < max; id++) {
+        Job *job = find_job_by_jid(id);
+        if (job) out[count++] = *job;
+    }
+    return count;
+}
+
+// activities [--top [interval] [count]]
+int do_activities(char** args, int argc) {
+    if (argc > 1) {
+        if (strcmp(args[1], "--top") != 0 || argc > 4) {
+            fprintf(stderr, "activities: usage: activities [--top [interval] [count]]\n");
+            return 1;
+        }
+        char *end = NULL;
+        double interval = argc > 2 ? strtod(args[2], &end) : 1.0;
+        int count = argc > 3 ? atoi(args[3]) : 0;
+        if ((end && *end) || interval <= 0 || count < 0) {
+            fprintf(stderr, "activities: --top: invalid interval or count\n");
+            return 1;
+        }
+        return jobs_top(interval, count);
+    }
+
     Job temp_jobs[MAX_JOBS];
     int count = 0;
     for (int i = 0; i < MAX_JOBS; i++) {
@@ -79,64 +208,95 @@ void do_activities(void) {
         }
     }
     for (int i = 0; i < count; i++) {
-        printf("[%d] : %s - %s\n", temp_jobs[i].pgid, temp_jobs[i].command,
+        printf("[%d] : %s - %s", temp_jobs[i].pgid, temp_jobs[i].command,
                temp_jobs[i].state == RUNNING ? "Running" : "Stopped");
+        Watch *w = find_watch(temp_jobs[i].pgid);
+        if (w && limits_any(&w->limits)) {
+            char limits[128];
+            limits_format(&w->limits, limits, sizeof(limits));
+            struct itimerspec left;
+            if (w->terminating) {
+                printf(" (limit %s, timed out)", limits);
+            } else if (w->timer_fd >= 0 && timerfd_gettime(w->timer_fd, &left) == 0) {
+                printf(" (limit %s, %lds left)", limits, (long)left.it_value.tv_sec + (left.it_value.tv_nsec > 0));
+            } else {
+                printf(" (limit %s)", limits);
+            }
+        }
+        if (w && sched_any(&w->sched)) {
+            char sched[256];
+            sched_format(&w->sched, sched, sizeof(sched));
+            printf(" (sched %s)", sched);
+        }
+        printf("\n");
     }
+    return 0;
 }
 
-void do_ping(char** args, int argc) {
-    if (argc != 3) { fprintf(stderr, "ping: Invalid syntax\n"); return; }
+int do_ping(char** args, int argc) {
+    if (argc != 3) { fprintf(stderr, "ping: Invalid syntax\n"); return 1; }
     pid_t pid = atoi(args[1]);
     int sig = atoi(args[2]);
-    if (kill(pid, 0) == -1) { printf("No such process found\n"); return; }
+    if (kill(pid, 0) == -1) { printf("No such process found\n"); return 1; }
     kill(pid, sig % 32);
     printf("Sent signal %d to process with pid %d\n", sig, pid);
+    return 0;
 }
 
-void do_fg(char** args, int argc) {
+int do_fg(char** args, int argc) {
     Job* job = (argc == 1) ? get_latest_job() : find_job_by_jid(atoi(args[1]));
-    if (!job) { printf("No such job\n"); return; }
+    if (!job) { printf("No such job\n"); return 1; }
 
     printf("%s\n", job->command);
     tcsetpgrp(STDIN_FILENO, job->pgid);
     if (job->state == STOPPED) { kill(-job->pgid, SIGCONT); }
 
-    int status;
-    waitpid(-job->pgid, &status, WUNTRACED);
+    // Every stage has to be collected, not just the first one to finish:
+    // once the job is dropped, jobs_reap() no longer waits for the rest
+    pid_t last_pid = job->pid_count > 0 ? job->pids[job->pid_count - 1] : -1;
+    int status, last_status = 0;
+    bool stopped = false;
+    for (;;) {
+        pid_t pid = events_waitpid(-job->pgid, &status, WUNTRACED);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;  // ECHILD: no stage left
+        }
+        if (WIFSTOPPED(status)) {
+            stopped = true;
+            last_status = 128 + WSTOPSIG(status);
+            break;
+        }
+        if (WIFEXITED(status)) metrics_stage_status(WEXITSTATUS(status));
+        if (pid == last_pid || last_pid < 0) last_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
     tcsetpgrp(STDIN_FILENO, SHELL_PGID);
 
-    if (WIFSTOPPED(status)) {
+    if (stopped) {
         job->state = STOPPED;
         printf("\n[%d]+ Stopped\t\t%s\n", job->job_id, job->command);
-    } else {
-        job->active = false;
+        return last_status;
     }
+    job->active = false;
+    jobs_unwatch(job->pgid);
+    return last_status;
 }
 
-void do_bg(char** args, int argc) {
-    if (argc != 2) { fprintf(stderr, "bg: Invalid syntax\n"); return; }
+int do_bg(char** args, int argc) {
+    if (argc != 2) { fprintf(stderr, "bg: Invalid syntax\n"); return 1; }
     Job* job = find_job_by_jid(atoi(args[1]));
-    if (!job) { printf("No such job\n"); return; }
-    if (job->state == RUNNING) { printf("Job already running\n"); return; }
+    if (!job) { printf("No such job\n"); return 1; }
+    if (job->state == RUNNING) { printf("Job already running\n"); return 1; }
     
     kill(-job->pgid, SIGCONT);
     job->state = RUNNING;
     printf("[%d] %s &\n", job->job_id, job->command);
+    return 0;
 }
 
 //
 // FIX: The missing function definitions are now here.
 //
-static Job* find_job_by_pgid(pid_t pgid) {
-    if (pgid < 1) return NULL;
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].active && job_list[i].pgid == pgid) {
-            return &job_list[i];
-        }
-    }
-    return NULL;
-}
-
 static Job* find_job_by_jid(int jid) {
     for (int i = 0; i < MAX_JOBS; i++) {
         if (job_list[i].active && job_list[i].job_id == jid) return &job_list[i];
@@ -152,4 +312,66 @@ static Job* get_latest_job() {
         }
     }
     return latest;
+}
+
+static Watch* find_watch(pid_t pgid) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (watches[i].active && watches[i].pgid == pgid) return &watches[i];
+    }
+    return NULL;
+}
+
+static void arm_timer(int fd, double seconds) {
+    struct itimerspec spec = { { 0, 0 }, { (time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9) } };
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) spec.it_value.tv_nsec = 1;
+    timerfd_settime(fd, 0, &spec, NULL);
+}
+
+static void on_timeout(int fd, void *data) {
+    Watch *w = data;
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) < 0) return;
+
+    if (!w->terminating) {
+        fprintf(stderr, "\nlimit: process group %d timed out after %gs\n", w->pgid, w->limits.timeout);
+        kill(-w->pgid, SIGTERM);
+        kill(-w->pgid, SIGCONT);   // A stopped job cannot act on SIGTERM
+        w->terminating = true;
+        arm_timer(fd, LIMIT_KILL_GRACE);
+        return;
+    }
+    kill(-w->pgid, SIGKILL);
+    events_remove(fd);
+    close(fd);
+    w->timer_fd = -1;
+}
+
+// Collects finished process substitutions, silently
+static void reap_hidden(void) {
+    for (int i = 0; i < hidden_count; ) {
+        pid_t pid;
+        while ((pid = waitpid(-hidden_jobs[i], NULL, WNOHANG)) > 0) {}
+        if (pid < 0 && errno == ECHILD) {
+            jobs_unwatch(hidden_jobs[i]);
+            hidden_jobs[i] = hidden_jobs[--hidden_count];
+        } else {
+            i++;
+        }
+    }
+}
+
+// With the fork server the shell is a child subreaper, so processes that
+// outlive the command that started them end up as its children. Those in
+// the group of a job are collected with the job; the rest are collected
+// here. WNOWAIT leaves the group of an exited process to be looked up.
+static void reap_orphans(void) {
+    siginfo_t info;
+    for (;;) {
+        info.si_pid = 0;
+        if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) < 0 || info.si_pid == 0) return;
+        pid_t pgid = getpgid(info.si_pid);
+        for (int i = 0; i < MAX_JOBS; i++) if (job_list[i].active && job_list[i].pgid == pgid) return;
+        for (int i = 0; i < hidden_count; i++) if (hidden_jobs[i] == pgid) return;
+        waitpid(info.si_pid, NULL, 0);
+    }
 }
\ No newline at end of file
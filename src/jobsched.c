@@ -0,0 +1,219 @@
+// sched_setaffinity, cpu_set_t and syscall() are GNU extensions
+#define _GNU_SOURCE
+
+#include "shell.h"
+#include "jobsched.h"
+
+#include <ctype.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define IOPRIO_CLASS_RT 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+
+static const char *IOPRIO_NAMES[] = { "none", "rt", "be", "idle" };
+
+// Background jobs yield the CPU and the disk to interactive work unless
+// the user says otherwise
+static JobSched background_default = { .has_nice = true, .nice = 10, .ioprio_class = IOPRIO_CLASS_BE, .ioprio_level = 7 };
+static bool background_default_set = true;
+
+static bool parse_cpus(const char *text, JobSched *sched);
+static bool parse_ioprio(const char *text, JobSched *sched);
+static int nth_cpu(const cpu_set_t *set, int n);
+
+void sched_clear(JobSched *sched) {
+    memset(sched, 0, sizeof(*sched));
+}
+
+bool sched_any(const JobSched *sched) {
+    return sched->has_cpus || sched->spread || sched->has_nice || sched->ioprio_class;
+}
+
+int sched_parse(char **words, int count, JobSched *sched) {
+    int i = 0;
+    while (i < count && strncmp(words[i], "--", 2) == 0) {
+        const char *option = words[i] + 2;
+        if (strcmp(option, "spread") == 0) {
+            sched->spread = true;
+            i++;
+            continue;
+        }
+        const char *value = i + 1 < count ? words[i + 1] : NULL;
+        bool ok = false;
+        if (strcmp(option, "cpus") == 0) {
+            ok = value && parse_cpus(value, sched);
+        } else if (strcmp(option, "nice") == 0) {
+            char *end = NULL;
+            long nice = value ? strtol(value, &end, 10) : 0;
+            ok = value && end != value && !*end && nice >= -20 && nice <= 19;
+            sched->has_nice = ok;
+            sched->nice = (int)nice;
+        } else if (strcmp(option, "ioprio") == 0) {
+            ok = value && parse_ioprio(value, sched);
+        } else {
+            fprintf(stderr, "sched: %s: invalid option\n", words[i]);
+            return -1;
+        }
+        if (!ok) {
+            fprintf(stderr, "sched: %s: invalid value '%s'\n", words[i], value ? value : "");
+            return -1;
+        }
+        i += 2;
+    }
+    if (i == count) {
+        fprintf(stderr, "sched: usage: sched [--cpus list] [--nice n] [--ioprio class[:level]] [--spread] command\n");
+        return -1;
+    }
+    return i;
+}
+
+int sched_apply(const JobSched *sched, pid_t pid, int stage) {
+    int status = 0;
+    if (sched->has_cpus || sched->spread) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched->has_cpus) {
+            for (int cpu = 0; cpu < SCHED_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+                if (sched->cpus[cpu / 64] & (1ULL << (cpu % 64))) CPU_SET(cpu, &set);
+            }
+        } else if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+            CPU_ZERO(&set);
+        }
+        if (sched->spread && CPU_COUNT(&set) > 0) {
+            int cpu = nth_cpu(&set, stage % CPU_COUNT(&set));
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(pid, sizeof(set), &set) < 0) {
+            fprintf(stderr, "sched: cpus: %s\n", strerror(errno));
+            status = -1;
+        }
+    }
+    if (sched->has_nice && setpriority(PRIO_PROCESS, pid, sched->nice) < 0) {
+        fprintf(stderr, "sched: nice: %s\n", strerror(errno));
+        status = -1;
+    }
+    if (sched->ioprio_class) {
+        int value = sched->ioprio_class << IOPRIO_CLASS_SHIFT | sched->ioprio_level;
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid, value) < 0) {
+            fprintf(stderr, "sched: ioprio: %s\n", strerror(errno));
+            status = -1;
+        }
+    }
+    return status;
+}
+
+void sched_format(const JobSched *sched, char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    if (sched->has_cpus) {
+        len += snprintf(buf + len, size - len, "--cpus ");
+        // Runs of set bits as ranges: 0-3,6
+        bool first = true;
+        for (int cpu = 0; cpu < SCHED_MAX_CPUS && len < size; cpu++) {
+            if (!(sched->cpus[cpu / 64] & (1ULL << (cpu % 64)))) continue;
+            int last = cpu;
+            while (last + 1 < SCHED_MAX_CPUS && (sched->cpus[(last + 1) / 64] & (1ULL << ((last + 1) % 64)))) last++;
+            if (last == cpu) len += snprintf(buf + len, size - len, "%s%d", first ? "" : ",", cpu);
+            else len += snprintf(buf + len, size - len, "%s%d-%d", first ? "" : ",", cpu, last);
+            first = false;
+            cpu = last;
+        }
+    }
+    if (sched->has_nice && len < size) len += snprintf(buf + len, size - len, "%s--nice %d", len ? " " : "", sched->nice);
+    if (sched->ioprio_class && len < size) {
+        len += snprintf(buf + len, size - len, "%s--ioprio %s", len ? " " : "", IOPRIO_NAMES[sched->ioprio_class]);
+        if (sched->ioprio_class != IOPRIO_CLASS_IDLE && len < size) len += snprintf(buf + len, size - len, ":%d", sched->ioprio_level);
+    }
+    if (sched->spread && len < size) snprintf(buf + len, size - len, "%s--spread", len ? " " : "");
+}
+
+const JobSched* sched_background_default(void) {
+    return background_default_set ? &background_default : NULL;
+}
+
+// sched                        prints the background default
+// sched --default off          background jobs run like foreground ones
+// sched --default options...   sets the background default
+int do_sched(char **args, int argc) {
+    if (argc == 1) {
+        char text[256];
+        if (background_default_set) sched_format(&background_default, text, sizeof(text));
+        printf("background: %s\n", background_default_set ? text : "off");
+        return 0;
+    }
+    if (strcmp(args[1], "--default") != 0 || argc == 2) {
+        fprintf(stderr, "sched: usage: sched [--default off | --default options]\n");
+        return 1;
+    }
+    if (argc == 3 && strcmp(args[2], "off") == 0) {
+        background_default_set = false;
+        return 0;
+    }
+
+    // Parsed as a prefix of a dummy command so the same parser applies
+    JobSched sched;
+    sched_clear(&sched);
+    char *words[argc - 1];
+    for (int i = 2; i < argc; i++) words[i - 2] = args[i];
+    words[argc - 2] = "";
+    if (sched_parse(words, argc - 1, &sched) != argc - 2) return 1;
+    background_default = sched;
+    background_default_set = true;
+    return 0;
+}
+
+// "0-3,6,8-9"
+static bool parse_cpus(const char *text, JobSched *sched) {
+    memset(sched->cpus, 0, sizeof(sched->cpus));
+    const char *p = text;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return false;
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) return false;
+            p = end;
+        }
+        if (last >= SCHED_MAX_CPUS) return false;
+        for (long cpu = first; cpu <= last; cpu++) sched->cpus[cpu / 64] |= 1ULL << (cpu % 64);
+        if (*p == ',') p++;
+        else if (*p) return false;
+    }
+    sched->has_cpus = true;
+    return true;
+}
+
+// "idle", "be", "be:7", "rt:0"
+static bool parse_ioprio(const char *text, JobSched *sched) {
+    size_t name_len = strcspn(text, ":");
+    int class = 0;
+    for (int i = 1; i <= IOPRIO_CLASS_IDLE; i++) {
+        if (strlen(IOPRIO_NAMES[i]) == name_len && strncmp(text, IOPRIO_NAMES[i], name_len) == 0) class = i;
+    }
+    if (!class) return false;
+    int level = class == IOPRIO_CLASS_IDLE ? 0 : 4;
+    if (text[name_len] == ':') {
+        if (class == IOPRIO_CLASS_IDLE || !isdigit((unsigned char)text[name_len + 1]) || text[name_len + 2]) return false;
+        level = text[name_len + 1] - '0';
+        if (level > 7) return false;
+    }
+    sched->ioprio_class = class;
+    sched->ioprio_level = level;
+    return true;
+}
+
+static int nth_cpu(const cpu_set_t *set, int n) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, set) && n-- == 0) return cpu;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "shell.h"
+#include "jobs.h"
+
+#include <time.h>
+
+// One pipeline stage being sampled. The /proc files are opened once and
+// re-read with pread() at offset 0 on every refresh, so a refresh costs
+// three reads per process and no path lookups.
+typedef struct {
+    int job_index;
+    int stage;
+    pid_t pid;
+    char comm[32];
+    int stat_fd, status_fd, io_fd;
+    bool gone;
+    char state;
+    unsigned long long ticks;       // utime + stime
+    unsigned long long rchar, wchar;            // All reads and writes, pipes included
+    unsigned long long read_bytes, write_bytes; // What reached storage
+    long rss_kb;
+} Stage;
+
+static void open_stage(Stage *s);
+static void close_stage(Stage *s);
+static void sample_stage(Stage *s);
+static ssize_t read_proc(int fd, char *buf, size_t size);
+static unsigned long long field_value(const char *text, const char *name);
+static void format_bytes(double bytes, char *buf, size_t size);
+static double now_seconds(void);
+
+int jobs_top(double interval, int count) {
+    Job jobs[MAX_JOBS];
+    int job_count = jobs_list(jobs, MAX_JOBS);
+    if (job_count == 0) {
+        printf("No jobs\n");
+        return 0;
+    }
+
+    Stage stages[MAX_JOBS * JOB_MAX_PROCS];
+    int stage_count = 0;
+    for (int j = 0; j < job_count; j++) {
+        for (int k = 0; k < jobs[j].pid_count; k++) {
+            Stage *s = &stages[stage_count++];
+            s->job_index = j;
+            s->stage = k + 1;
+            s->pid = jobs[j].pids[k];
+            open_stage(s);
+        }
+    }
+
+    long ticks_per_second = sysconf(_SC_CLK_TCK);
+    bool terminal = isatty(STDOUT_FILENO);
+    Stage previous[MAX_JOBS * JOB_MAX_PROCS];
+    for (int i = 0; i < stage_count; i++) sample_stage(&stages[i]);
+    double last = now_seconds();
+
+    for (int frame = 0; count == 0 || frame < count; frame++) {
+        struct timespec pause = { (time_t)interval, (long)((interval - (time_t)interval) * 1e9) };
+        while (nanosleep(&pause, &pause) < 0 && errno == EINTR);
+
+        memcpy(previous, stages, sizeof(Stage) * stage_count);
+        for (int i = 0; i < stage_count; i++) sample_stage(&stages[i]);
+        double now = now_seconds();
+        double elapsed = now - last > 0 ? now - last : interval;
+        last = now;
+
+        if (terminal) printf("\033[H\033[J");
+        else if (frame > 0) printf("\n");
+        printf("%-5s %-7s %-5s %6s %7s %9s %9s %9s %9s  %s\n",
+               "STAGE", "PID", "STATE", "CPU%", "RSS", "READ/s", "WRITE/s", "DISK-R/s", "DISK-W/s", "COMMAND");
+        int current_job = -1;
+        for (int i = 0; i < stage_count; i++) {
+            Stage *s = &stages[i], *p = &previous[i];
+            if (s->job_index != current_job) {
+                current_job = s->job_index;
+                printf("[%d] %s\n", jobs[current_job].job_id, jobs[current_job].command);
+            }
+            if (s->gone) {
+                printf("%-5d %-7d %-5s\n", s->stage, s->pid, "done");
+                continue;
+            }
+            char rss[16], rd[16], wr[16], disk_rd[16], disk_wr[16];
+            format_bytes(s->rss_kb * 1024.0, rss, sizeof(rss));
+            format_bytes((s->rchar - p->rchar) / elapsed, rd, sizeof(rd));
+            format_bytes((s->wchar - p->wchar) / elapsed, wr, sizeof(wr));
+            format_bytes((s->read_bytes - p->read_bytes) / elapsed, disk_rd, sizeof(disk_rd));
+            format_bytes((s->write_bytes - p->write_bytes) / elapsed, disk_wr, sizeof(disk_wr));
+            double cpu = 100.0 * (s->ticks - p->ticks) / ticks_per_second / elapsed;
+            printf("%-5d %-7d %-5c %6.1f %7s %9s %9s %9s %9s  %s\n",
+                   s->stage, s->pid, s->state, cpu, rss, rd, wr, disk_rd, disk_wr, s->comm);
+        }
+        fflush(stdout);
+    }
+
+    for (int i = 0; i < stage_count; i++) close_stage(&stages[i]);
+    return 0;
+}
+
+static void open_stage(Stage *s) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", s->pid);
+    s->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/proc/%d/status", s->pid);
+    s->status_fd = open(path, O_RDONLY | O_CLOEXEC);
+    snprintf(path, sizeof(path), "/proc/%d/io", s->pid);
+    s->io_fd = open(path, O_RDONLY | O_CLOEXEC);
+    s->gone = s->stat_fd < 0;
+    s->comm[0] = '\0';
+    s->ticks = s->rchar = s->wchar = s->read_bytes = s->write_bytes = 0;
+    s->rss_kb = 0;
+    s->state = '?';
+}
+
+static void close_stage(Stage *s) {
+    if (s->stat_fd >= 0) close(s->stat_fd);
+    if (s->status_fd >= 0) close(s->status_fd);
+    if (s->io_fd >= 0) close(s->io_fd);
+}
+
+// A process that has exited (or been reaped) makes the read fail with ESRCH
+// or come back empty; it keeps its last values and is shown as done
+static void sample_stage(Stage *s) {
+    if (s->gone) return;
+    char buf[4096];
+    if (read_proc(s->stat_fd, buf, sizeof(buf)) <= 0) { s->gone = true; return; }
+
+    // pid (comm) state ppid ... utime stime: comm may contain spaces and
+    // parentheses, so fields are counted from the last ')'
+    char *open_paren = strchr(buf, '('), *close_paren = strrchr(buf, ')');
+    if (!open_paren || !close_paren) { s->gone = true; return; }
+    size_t comm_len = close_paren - open_paren - 1;
+    if (comm_len >= sizeof(s->comm)) comm_len = sizeof(s->comm) - 1;
+    memcpy(s->comm, open_paren + 1, comm_len);
+    s->comm[comm_len] = '\0';
+
+    char *field = close_paren + 2;
+    s->state = *field;
+    if (s->state == 'Z') { s->gone = true; return; }
+    unsigned long long utime = 0, stime = 0;
+    for (int n = 3; field && n <= 15; n++) {
+        if (n == 14) utime = strtoull(field, NULL, 10);
+        if (n == 15) stime = strtoull(field, NULL, 10);
+        field = strchr(field, ' ');
+        if (field) field++;
+    }
+    s->ticks = utime + stime;
+
+    if (s->status_fd >= 0 && read_proc(s->status_fd, buf, sizeof(buf)) > 0) s->rss_kb = (long)field_value(buf, "VmRSS:");
+    if (s->io_fd >= 0 && read_proc(s->io_fd, buf, sizeof(buf)) > 0) {
+        s->rchar = field_value(buf, "rchar:");
+        s->wchar = field_value(buf, "wchar:");
+        s->read_bytes = field_value(buf, "read_bytes:");
+        s->write_bytes = field_value(buf, "write_bytes:");
+    }
+}
+
+static ssize_t read_proc(int fd, char *buf, size_t size) {
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    buf[n > 0 ? n : 0] = '\0';
+    return n;
+}
+
+// The number after "name" at the start of a line, e.g. "VmRSS:   1234 kB"
+static unsigned long long field_value(const char *text, const char *name) {
+    size_t len = strlen(name);
+    for (const char *line = text; line && *line; line = strchr(line, '\n'), line = line ? line + 1 : NULL) {
+        if (strncmp(line, name, len) == 0) return strtoull(line + len, NULL, 10);
+    }
+    return 0;
+}
+
+static void format_bytes(double bytes, char *buf, size_t size) {
+    const char *units = "BKMGT";
+    int unit = 0;
+    while (bytes >= 1024 && unit < 4) { bytes /= 1024; unit++; }
+    if (unit == 0) snprintf(buf, size, "%.0f%c", bytes, units[unit]);
+    else snprintf(buf, size, "%.1f%c", bytes, units[unit]);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
\ No newline at end of file
@@ -5,22 +5,63 @@
 #include "jobs.h"
 #include "executor.h"
 #include "intrinsics.h"
+#include "variables.h"
+#include "script.h"
+#include "zygote.h"
+#include "pathglob.h"
+#include "replay.h"
+#include "metrics.h"
+#include "server.h"
+#include "coreutils.h"
+#include "heredoc.h"
 
 // Global variable definitions
 char SHELL_HOME[PATH_MAX];
 char PREVIOUS_CWD[PATH_MAX] = "";
 pid_t SHELL_PGID;
 bool PREVIOUS_CWD_IS_SET = false; 
+int LAST_STATUS = 0;
+volatile sig_atomic_t INTERRUPTED = 0;
 
 // E.3: Signal Handlers
 // These handlers do nothing, their purpose is to interrupt blocking syscalls like waitpid.
 // The main logic is handled in the loops where those syscalls are.
-void sigint_handler(int sig) { (void)sig; }
+void sigint_handler(int sig) { (void)sig; INTERRUPTED = 1; }
 void sigtstp_handler(int sig) { (void)sig; }
 
-int main(void) {
-    // Make the shell interactive and grab terminal control only if running on a terminal
-    if (isatty(STDIN_FILENO)) {
+int main(int argc, char **argv) {
+    // Re-executed as the fork server helper (see zygote.c)
+    if (argc == 3 && strcmp(argv[1], ZYGOTE_HELPER_FLAG) == 0) {
+        return zygote_main(atoi(argv[2]));
+    }
+    bool fork_server = false, debug_forks = false;
+    const char *record_path = NULL, *replay_path = NULL, *metrics_path = NULL;
+    const char *server_path = NULL;
+    char *command = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fork-server") == 0) {
+            fork_server = true;
+        } else if (strcmp(argv[i], "--debug-forks") == 0) {
+            debug_forks = true;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics_path = argv[++i];
+        } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            command = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--fork-server] [--debug-forks] [--metrics socket] [--record file | --replay file | --server socket | -c command]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Make the shell interactive and grab terminal control only if running on a
+    // terminal and reading commands from it
+    if (isatty(STDIN_FILENO) && !server_path && !command) {
         SHELL_PGID = getpgrp();
         while (tcgetpgrp(STDIN_FILENO) != SHELL_PGID) {
             kill(-SHELL_PGID, SIGTTIN);
@@ -44,24 +85,57 @@ int main(void) {
     strncpy(PREVIOUS_CWD, SHELL_HOME, sizeof(PREVIOUS_CWD) - 1);
 
     // Initialize subsystems
+    vars_init();
     log_init();
     jobs_init();
+    if (fork_server) zygote_start();
+    if (debug_forks) metrics_debug_forks();
+    if (replay_path) return replay_run(replay_path);
+    if (record_path && record_open(record_path) < 0) return EXIT_FAILURE;
+    if (metrics_path && metrics_start(metrics_path) < 0) return EXIT_FAILURE;
+    if (server_path) {
+        int status = server_main(server_path);
+        metrics_stop();
+        return status;
+    }
+    if (command) {
+        execute_text(command);
+        // What builtins left buffered goes out now; a failed write fails the run
+        LAST_STATUS = builtin_flush("shell", LAST_STATUS);
+        metrics_report_forks();
+        jobs_kill_all();
+        metrics_stop();
+        return LAST_STATUS;
+    }
 
     while (1) {
         jobs_reap();
+        // Directory listings cached for globbing live for one line
+        glob_cache_clear();
         display_prompt();
-        char *input = read_input();
+        // Here-document bodies follow the line they belong to, and an
+        // unfinished if/for/while/case continues on the following lines
+        char *input = read_command();
 
         if (input == NULL) { // E.3: Handle Ctrl-D
             printf("logout\n");
+            metrics_report_forks();
             jobs_kill_all();
+            metrics_stop();
             break; 
         }
 
+        ReplayMark mark;
+        record_begin(&mark, input);
+
         // Check if this is a "log execute" command with pipes
         if (strlen(input) > 0) {
+            // Here-document bodies are left out of what is checked and
+            // logged: a large one would otherwise be copied into the log
+            char *command_text = heredoc_strip(input);
+
             // Check if the command is "log execute N | ..."
-            char *cmd_copy = strdup(input);
+            char *cmd_copy = strdup(command_text);
             char *token = strtok(cmd_copy, " \t");
             int is_log_execute_with_pipe = 0;
             int history_index = 0;
@@ -79,7 +153,9 @@ int main(void) {
                             // Capture the rest of the pipeline
                             char *rest = strtok(NULL, "");
                             if (rest) {
-                                remaining_pipeline = strdup(rest);
+                                // Nothing before 'rest' was stripped, so it
+                                // starts at the same offset in the full line
+                                remaining_pipeline = strdup(input + (rest - cmd_copy));
                                 is_log_execute_with_pipe = 1;
                             }
                         }
@@ -89,9 +165,7 @@ int main(void) {
             free(cmd_copy);
             
             // Add command to log
-            char *input_copy_for_log = strdup(input);
-            log_add(input_copy_for_log);
-            free(input_copy_for_log);
+            log_add(command_text);
 
             if (is_log_execute_with_pipe && history_index > 0) {
                 char *historical_cmd = log_get_command(history_index);
@@ -100,12 +174,7 @@ int main(void) {
                     char *full_pipeline = malloc(strlen(historical_cmd) + strlen(remaining_pipeline) + 4);
                     sprintf(full_pipeline, "%s | %s", historical_cmd, remaining_pipeline);
 
-                    // Process the full pipeline
-                    if (is_valid_syntax(full_pipeline)) {
-                        process_line(full_pipeline);
-                    } else {
-                        fprintf(stderr, "Invalid Syntax in pipeline!\n");
-                    }
+                    execute_line(full_pipeline);
 
                     free(full_pipeline);
                     free(historical_cmd);
@@ -115,7 +184,7 @@ int main(void) {
                 if (remaining_pipeline) free(remaining_pipeline);
             } else {
                 // Check if the command is "log execute N" (without pipes)
-                cmd_copy = strdup(input);
+                cmd_copy = strdup(command_text);
                 token = strtok(cmd_copy, " \t");
                 int is_log_execute = 0;
                 history_index = 0;
@@ -143,23 +212,18 @@ int main(void) {
                         // Print the command being executed
                         printf("%s\n", historical_cmd);
                         
-                        // Process it
-                        if (is_valid_syntax(historical_cmd)) {
-                            process_line(historical_cmd);
-                        } else {
-                            fprintf(stderr, "Invalid Syntax in historical command!\n");
-                        }
+                        execute_line(historical_cmd);
                         free(historical_cmd);
                     } else {
                         fprintf(stderr, "log: invalid index\n");
                     }
-                } else if (!is_valid_syntax(input)) {
-                    fprintf(stderr, "Invalid Syntax!\n");
                 } else {
-                    process_line(input);
+                    execute_line(input);
                 }
             }
+            free(command_text);
         }
+        record_end(&mark);
         free(input);
     }
     return 0;
@@ -0,0 +1,205 @@
+// SOCK_NONBLOCK, SOCK_CLOEXEC and MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+
+#include "shell.h"
+#include "metrics.h"
+#include "events.h"
+#include "jobs.h"
+#include "variables.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+// Clients that connected but have not sent their request yet
+#define METRICS_MAX_CLIENTS 8
+#define METRICS_REQUEST_MAX 1024
+
+Metrics METRICS;
+
+static const double parse_bounds[METRICS_PARSE_BUCKETS] = {
+    1e-6, 5e-6, 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 1e-2
+};
+
+static int listen_fd = -1;
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static int client_count = 0;
+
+static void on_connect(int fd, void *data);
+static void on_request(int fd, void *data);
+static void respond(int fd, bool http);
+static char* format_metrics(size_t *len);
+
+int metrics_start(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "metrics: %s: path too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Only ever remove a socket, never a file that happens to be there
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+        perror(path);
+        if (listen_fd >= 0) close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+    if (!events_add(listen_fd, on_connect, NULL)) {
+        fprintf(stderr, "metrics: too many event sources\n");
+        close(listen_fd);
+        unlink(path);
+        listen_fd = -1;
+        return -1;
+    }
+    strcpy(socket_path, path);
+    METRICS.enabled = true;
+    return 0;
+}
+
+void metrics_stop(void) {
+    if (listen_fd < 0) return;
+    events_remove(listen_fd);
+    close(listen_fd);
+    unlink(socket_path);
+    listen_fd = -1;
+    METRICS.enabled = false;
+}
+
+void metrics_debug_forks(void) {
+    void *page = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) { perror("mmap"); return; }
+    METRICS.forks_saved = page;
+}
+
+void metrics_report_forks(void) {
+    if (!METRICS.forks_saved) return;
+    fprintf(stderr, "forks saved: %llu\n", (unsigned long long)__atomic_load_n(METRICS.forks_saved, __ATOMIC_RELAXED));
+}
+
+double metrics_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void metrics_observe_parse(double seconds) {
+    for (int i = 0; i < METRICS_PARSE_BUCKETS; i++) {
+        if (seconds <= parse_bounds[i]) { METRICS.parse_buckets[i]++; break; }
+    }
+    METRICS.parse_count++;
+    METRICS.parse_seconds += seconds;
+}
+
+static void on_connect(int fd, void *data) {
+    (void)data;
+    // A forked copy of the shell still has the registry; leave the socket
+    // to the shell itself
+    if (getpid() != vars_shell_pid()) { events_remove(fd); return; }
+
+    int client;
+    while ((client = accept(fd, NULL, NULL)) >= 0) {
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+        fcntl(client, F_SETFL, O_NONBLOCK);
+        // The reply waits for the request line, so that an HTTP client
+        // (curl --unix-socket) gets a status line and a plain one does not
+        if (client_count == METRICS_MAX_CLIENTS || !events_add(client, on_request, NULL)) {
+            respond(client, false);
+            continue;
+        }
+        client_count++;
+    }
+}
+
+// Readable: a request, or EOF from a client that sends nothing
+static void on_request(int fd, void *data) {
+    (void)data;
+    char request[METRICS_REQUEST_MAX];
+    ssize_t n = recv(fd, request, sizeof(request), MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+    events_remove(fd);
+    client_count--;
+    respond(fd, n >= 4 && strncmp(request, "GET ", 4) == 0);
+}
+
+// Sends the whole reply without waiting; a client too slow to take a few
+// kilobytes at once gets it cut short
+static void respond(int fd, bool http) {
+    size_t len;
+    char *body = format_metrics(&len);
+    if (body) {
+        char header[128];
+        int header_len = http ? snprintf(header, sizeof(header),
+            "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", len) : 0;
+        if (header_len > 0) send(fd, header, header_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        send(fd, body, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        free(body);
+    }
+    close(fd);
+}
+
+static char* format_metrics(size_t *len) {
+    char *text = NULL;
+    FILE *out = open_memstream(&text, len);
+    if (!out) return NULL;
+
+    Job jobs[MAX_JOBS];
+    int count = jobs_list(jobs, MAX_JOBS), running = 0, stopped = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].state == STOPPED) stopped++;
+        else running++;
+    }
+
+    fprintf(out, "# HELP shell_commands_total Commands started, by where they ran.\n"
+                 "# TYPE shell_commands_total counter\n"
+                 "shell_commands_total{where=\"shell\"} %llu\n"
+                 "shell_commands_total{where=\"forked\"} %llu\n",
+            (unsigned long long)METRICS.shell_commands, (unsigned long long)METRICS.forked_commands);
+    fprintf(out, "# HELP shell_fork_failures_total fork() calls that failed.\n"
+                 "# TYPE shell_fork_failures_total counter\n"
+                 "shell_fork_failures_total %llu\n"
+                 "# HELP shell_exec_failures_total Stages that could not be executed (exit status 126 or 127).\n"
+                 "# TYPE shell_exec_failures_total counter\n"
+                 "shell_exec_failures_total %llu\n",
+            (unsigned long long)METRICS.fork_failures, (unsigned long long)METRICS.exec_failures);
+
+    fprintf(out, "# HELP shell_parse_duration_seconds Time to parse a pipeline.\n"
+                 "# TYPE shell_parse_duration_seconds histogram\n");
+    uint64_t cumulative = 0;
+    for (int i = 0; i < METRICS_PARSE_BUCKETS; i++) {
+        cumulative += METRICS.parse_buckets[i];
+        fprintf(out, "shell_parse_duration_seconds_bucket{le=\"%g\"} %llu\n", parse_bounds[i], (unsigned long long)cumulative);
+    }
+    fprintf(out, "shell_parse_duration_seconds_bucket{le=\"+Inf\"} %llu\n"
+                 "shell_parse_duration_seconds_sum %.9f\n"
+                 "shell_parse_duration_seconds_count %llu\n",
+            (unsigned long long)METRICS.parse_count, METRICS.parse_seconds, (unsigned long long)METRICS.parse_count);
+
+    fprintf(out, "# HELP shell_jobs Jobs by state; hidden jobs are process substitutions and output relays.\n"
+                 "# TYPE shell_jobs gauge\n"
+                 "shell_jobs{state=\"running\"} %d\n"
+                 "shell_jobs{state=\"stopped\"} %d\n"
+                 "shell_jobs{state=\"hidden\"} %d\n",
+            running, stopped, jobs_hidden_count());
+    fprintf(out, "# HELP shell_reap_duration_seconds Time spent collecting finished jobs before each prompt.\n"
+                 "# TYPE shell_reap_duration_seconds summary\n"
+                 "shell_reap_duration_seconds_sum %.9f\n"
+                 "shell_reap_duration_seconds_count %llu\n",
+            METRICS.reap_seconds, (unsigned long long)METRICS.reap_count);
+    fprintf(out, "# HELP shell_history_entries Commands in the history.\n"
+                 "# TYPE shell_history_entries gauge\n"
+                 "shell_history_entries %llu\n"
+                 "# HELP shell_history_written_bytes_total Bytes written to the history file.\n"
+                 "# TYPE shell_history_written_bytes_total counter\n"
+                 "shell_history_written_bytes_total %llu\n",
+            (unsigned long long)METRICS.history_entries, (unsigned long long)METRICS.history_bytes);
+    fclose(out);
+    return text;
+}
@@ -1,5 +1,10 @@
 #include "shell.h"
 #include "parser.h"
+#include "variables.h"
+#include "executor.h"
+#include "pathglob.h"
+
+#include <ctype.h>
 
 // This preliminary check remains the same as in Part A.
 bool is_valid_syntax(const char *input) {
@@ -7,9 +12,20 @@ bool is_valid_syntax(const char *input) {
     bool last_was_special = false;
     for (int i = 0; input[i] != '\0'; ++i) {
         if (input[i] == ' ' || input[i] == '\t' || input[i] == '\r' || input[i] == '\n') continue;
+        if (strchr("$<>", input[i]) && input[i + 1] == '(') {
+            // A substitution is one word; its contents are checked when it runs
+            size_t len = substitution_len(input + i + 1);
+            if (len == 0) return false;
+            i += len;
+            last_was_special = false;
+            expect_command = false;
+            continue;
+        }
         if (strchr("|&;<>", input[i])) {
             if (last_was_special) {
                 if (input[i-1] == '>' && input[i] == '>') continue;
+                if (input[i-1] == '<' && input[i] == '<') continue;    // << and <<<
+                if ((input[i-1] == '>' || input[i-1] == '<') && input[i] == '&') continue;    // n>&m, n<&m
                 return false; 
             }
             if (expect_command && (input[i] == '|' || input[i] == ';')) return false;
@@ -43,4 +59,198 @@ char **tokenize(char *input, int *argc) {
     tokens[count] = NULL; // Null-terminate the array
     *argc = count;
     return tokens;
-}
\ No newline at end of file
+}
+
+size_t substitution_len(const char *s) {
+    int depth = 0;
+    for (size_t i = 0; s[i]; i++) {
+        if (s[i] == '(') depth++;
+        else if (s[i] == ')' && --depth == 0) return i + 1;
+    }
+    return 0;
+}
+
+// Here-document bodies ride along in the line, so this runs over megabytes.
+// A table of the bytes worth a closer look lets the scan skip the rest
+// without two strchr() calls per byte.
+size_t shell_strcspn(const char *s, const char *reject) {
+    bool stop[256] = { false };
+    for (const char *r = reject; *r; r++) stop[(unsigned char)*r] = true;
+    stop['$'] = stop['<'] = stop['>'] = true;
+
+    size_t i = 0;
+    for (;;) {
+        while (s[i] && !stop[(unsigned char)s[i]]) i++;
+        if (!s[i]) return i;
+        if (strchr(reject, s[i]) && !(s[i] == '&' && i > 0 && (s[i - 1] == '>' || s[i - 1] == '<'))) return i;
+        if (s[i] != '&' && s[i + 1] == '(') {
+            size_t len = substitution_len(s + i + 1);
+            if (len > 0) { i += len + 1; continue; }
+        }
+        i++;
+    }
+}
+
+char *shell_strtok(char *s, const char *delims, char **saveptr) {
+    if (!s) s = *saveptr;
+    s += strspn(s, delims);
+    if (*s == '\0') { *saveptr = s; return NULL; }
+    char *end = s + shell_strcspn(s, delims);
+    if (*end) *end++ = '\0';
+    *saveptr = end;
+    return s;
+}
+
+void wordlist_push(WordList *list, char *word) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->items = realloc(list->items, sizeof(char *) * list->capacity);
+        if (!list->items) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    list->items[list->count++] = word;
+}
+
+void wordlist_free(WordList *list) {
+    for (int i = 0; i < list->count; i++) free(list->items[i]);
+    free(list->items);
+    list->items = NULL;
+    list->count = list->capacity = 0;
+}
+
+bool is_assignment(const char *word) {
+    const char *eq = strchr(word, '=');
+    return eq && var_name_valid(word, eq - word);
+}
+
+// Growable string used while building one field
+typedef struct {
+    char *data;
+    size_t len, capacity;
+} Field;
+
+static void field_append(Field *f, const char *s, size_t n) {
+    if (f->len + n + 1 > f->capacity) {
+        f->capacity = (f->len + n + 1) * 2;
+        f->data = realloc(f->data, f->capacity);
+        if (!f->data) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    memcpy(f->data + f->len, s, n);
+    f->len += n;
+    f->data[f->len] = '\0';
+}
+
+static void field_finish(Field *f, WordList *out) {
+    if (!f->data) field_append(f, "", 0);
+    wordlist_push(out, f->data);
+    f->data = NULL;
+    f->len = f->capacity = 0;
+}
+
+// Appends the result of one expansion. When splitting, runs of blanks in the
+// value end the current field, as for an unquoted expansion in sh.
+static void append_expansion(Field *f, bool *have_field, const char *value, bool split, WordList *out) {
+    if (!value) return;
+    if (!split) { field_append(f, value, strlen(value)); return; }
+    for (const char *p = value; *p; ) {
+        size_t run = strcspn(p, " \t\n");
+        if (run > 0) {
+            field_append(f, p, run);
+            *have_field = true;
+            p += run;
+        }
+        if (*p) {
+            if (*have_field) { field_finish(f, out); *have_field = false; }
+            p += strspn(p, " \t\n");
+        }
+    }
+}
+
+static void expand_globs(WordList *list, int first);
+
+void expand_word(const char *word, bool split, WordList *out) {
+    int first_field = out->count;
+    Field f = { NULL, 0, 0 };
+    bool have_field = false;     // Literal text or a non-empty expansion seen
+    char number[32];
+
+    for (const char *p = word; *p; ) {
+        if (*p != '$') {
+            size_t run = strcspn(p, "$");
+            field_append(&f, p, run);
+            have_field = true;
+            p += run;
+            continue;
+        }
+
+        const char *name = p + 1;
+        size_t name_len = 0;
+        const char *next = name;
+        if (*name == '{') {
+            const char *close = strchr(name, '}');
+            if (close) {
+                name++;
+                name_len = close - name;
+                next = close + 1;
+            }
+        } else if (isalpha((unsigned char)*name) || *name == '_') {
+            while (isalnum((unsigned char)name[name_len]) || name[name_len] == '_') name_len++;
+            next = name + name_len;
+        } else if (*name == '(' && (name_len = substitution_len(p)) > 0) {
+            // $(command): run it and expand to its output
+            char *command = strndup(p + 2, name_len - 3);
+            char *output = capture_output(command);
+            append_expansion(&f, &have_field, output, split, out);
+            free(output);
+            free(command);
+            p += name_len;
+            continue;
+        } else if (*name == '?' || *name == '$') {
+            name_len = 1;
+            next = name + 1;
+        }
+
+        if (name_len == 1 && *name == '?') {
+            snprintf(number, sizeof(number), "%d", LAST_STATUS);
+            append_expansion(&f, &have_field, number, split, out);
+        } else if (name_len == 1 && *name == '$') {
+            snprintf(number, sizeof(number), "%d", (int)vars_shell_pid());
+            append_expansion(&f, &have_field, number, split, out);
+        } else if (name_len > 0 && var_name_valid(name, name_len)) {
+            append_expansion(&f, &have_field, var_get_n(name, name_len), split, out);
+        } else {
+            // Not an expansion: a lone '$' (or a malformed ${...}) is literal
+            field_append(&f, p, next == p + 1 ? 1 : (size_t)(next - p));
+            have_field = true;
+            if (next == p + 1) { p++; continue; }
+        }
+        p = next;
+    }
+
+    if (have_field || !split) field_finish(&f, out);
+    else free(f.data);
+    if (split) expand_globs(out, first_field);
+}
+
+// Replaces each field from 'first' on that is a pattern with the paths it
+// matches; a pattern that matches nothing stays as it is
+static void expand_globs(WordList *list, int first) {
+    int i = first;
+    while (i < list->count) {
+        if (!glob_has_magic(list->items[i])) { i++; continue; }
+        WordList matches = { NULL, 0, 0 };
+        if (glob_expand(list->items[i], &matches) == 0) { i++; continue; }
+
+        // Splice the matches in place of the pattern
+        int tail = list->count - i - 1;
+        char **rest = malloc(sizeof(char *) * (tail + 1));
+        if (!rest) { perror("malloc"); exit(EXIT_FAILURE); }
+        memcpy(rest, list->items + i + 1, sizeof(char *) * tail);
+        free(list->items[i]);
+        list->count = i;
+        for (int j = 0; j < matches.count; j++) wordlist_push(list, matches.items[j]);
+        for (int j = 0; j < tail; j++) wordlist_push(list, rest[j]);
+        i += matches.count;
+        free(rest);
+        free(matches.items);
+    }
+}
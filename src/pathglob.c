@@ -0,0 +1,421 @@
+// d_type and the DT_* constants
+#define _DEFAULT_SOURCE
+
+#include "shell.h"
+#include "pathglob.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define GLOB_CACHE_SIZE 16
+
+// A compiled pattern component: a sequence of elements matched by running
+// all possible positions at once (a Thompson NFA over a bitset), so a
+// pattern like *a*a*a*b costs the same per character as a plain *
+typedef enum { ELEM_CHAR, ELEM_ANY, ELEM_CLASS, ELEM_STAR } ElemType;
+
+typedef struct {
+    ElemType type;
+    unsigned char c;
+    uint64_t set[4];     // ELEM_CLASS: one bit per byte value
+} Elem;
+
+typedef struct {
+    Elem *elems;
+    int count;
+    const char *prefix;  // Literal text every match starts with
+    size_t prefix_len;
+    const char *suffix;  // ...and ends with (after the last '*')
+    size_t suffix_len;
+    size_t min_len;      // Elements other than '*', one character each
+    bool fixed_len;      // No '*': every match is exactly min_len long
+    bool dot_ok;         // Component starts with '.'
+} Matcher;
+
+// One directory's names, kept in a single arena so a listing of a million
+// entries is three allocations
+typedef struct {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    char *names;         // NUL-separated
+    size_t *offsets;
+    unsigned char *types;    // DT_* from readdir, DT_UNKNOWN if not known
+    size_t count;
+} Listing;
+
+static Listing cache[GLOB_CACHE_SIZE];
+static int cache_next = 0;
+
+static void compile(const char *pattern, size_t len, Matcher *m);
+static bool run_matcher(const Matcher *m, const char *name);
+static const Listing* list_directory(const char *path);
+static void free_listing(Listing *l);
+static void expand_from(char *path, size_t path_len, char **components, int n, WordList *out);
+static void add_recursive(char *path, size_t path_len, char **components, int n, WordList *out);
+static bool is_directory(const char *path, const Listing *l, size_t i);
+static void path_push(char *path, size_t *len, const char *name);
+static int compare_words(const void *a, const void *b);
+
+bool glob_has_magic(const char *word) {
+    for (const char *p = word; *p; p++) {
+        if (*p == '*' || *p == '?') return true;
+        if (*p == '[' && strchr(p + 1, ']')) return true;
+    }
+    return false;
+}
+
+bool glob_match(const char *pattern, const char *name) {
+    Matcher m;
+    compile(pattern, strlen(pattern), &m);
+    bool matched = (name[0] != '.' || m.dot_ok) && run_matcher(&m, name);
+    free(m.elems);
+    return matched;
+}
+
+int glob_expand(const char *pattern, WordList *out) {
+    char *copy = strdup(pattern);
+    int capacity = 8, n = 0;
+    char **components = malloc(sizeof(char *) * capacity);
+    if (!copy || !components) { perror("malloc"); exit(EXIT_FAILURE); }
+
+    // "/a/*/b" -> "", "a", "*", "b"; a trailing '/' leaves an empty last
+    // component, which only directories satisfy
+    char *p = copy;
+    for (;;) {
+        if (n == capacity) {
+            capacity *= 2;
+            components = realloc(components, sizeof(char *) * capacity);
+            if (!components) { perror("realloc"); exit(EXIT_FAILURE); }
+        }
+        components[n++] = p;
+        char *slash = strchr(p, '/');
+        if (!slash) break;
+        *slash = '\0';
+        p = slash + 1;
+        while (*p == '/') p++;
+    }
+
+    int before = out->count;
+    char path[PATH_MAX];
+    path[0] = '\0';
+    if (components[0][0] == '\0') {
+        strcpy(path, "/");
+        expand_from(path, 1, components + 1, n - 1, out);
+    } else {
+        expand_from(path, 0, components, n, out);
+    }
+    qsort(out->items + before, out->count - before, sizeof(char *), compare_words);
+
+    free(components);
+    free(copy);
+    return out->count - before;
+}
+
+void glob_cache_clear(void) {
+    for (int i = 0; i < GLOB_CACHE_SIZE; i++) free_listing(&cache[i]);
+    cache_next = 0;
+}
+
+// Matches 'components' below 'path' (empty for the current directory)
+static void expand_from(char *path, size_t path_len, char **components, int n, WordList *out) {
+    if (n == 0) {
+        wordlist_push(out, strdup(path));
+        return;
+    }
+    const char *component = components[0];
+    const char *dir = path_len ? path : ".";
+
+    if (n == 1 && component[0] == '\0') {
+        // Trailing '/': the path so far must be a directory
+        struct stat st;
+        if (!path_len || stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) return;
+        char *dir_path = malloc(path_len + 2);
+        if (!dir_path) { perror("malloc"); exit(EXIT_FAILURE); }
+        memcpy(dir_path, path, path_len);
+        strcpy(dir_path + path_len, path[path_len - 1] == '/' ? "" : "/");
+        wordlist_push(out, dir_path);
+        return;
+    }
+
+    if (strcmp(component, "**") == 0) {
+        add_recursive(path, path_len, components + 1, n - 1, out);
+        return;
+    }
+
+    if (!glob_has_magic(component)) {
+        size_t len = path_len;
+        path_push(path, &len, component);
+        if (n > 1) {
+            expand_from(path, len, components + 1, n - 1, out);
+        } else {
+            struct stat st;
+            if (lstat(path, &st) == 0) wordlist_push(out, strdup(path));
+        }
+        path[path_len] = '\0';
+        return;
+    }
+
+    Matcher m;
+    compile(component, strlen(component), &m);
+    const Listing *l = list_directory(dir);
+    if (l) {
+        // The listing may be evicted while recursing, so work from a copy
+        // of the matching names
+        WordList matches = { NULL, 0, 0 };
+        for (size_t i = 0; i < l->count; i++) {
+            const char *name = l->names + l->offsets[i];
+            if (name[0] == '.' && !m.dot_ok) continue;
+            if (!run_matcher(&m, name)) continue;
+            // Only a directory (or what may be one) can have components below it
+            if (n > 1 && l->types[i] != DT_DIR && l->types[i] != DT_UNKNOWN && l->types[i] != DT_LNK) continue;
+            wordlist_push(&matches, strdup(name));
+        }
+        for (int i = 0; i < matches.count; i++) {
+            size_t len = path_len;
+            path_push(path, &len, matches.items[i]);
+            expand_from(path, len, components + 1, n - 1, out);
+            path[path_len] = '\0';
+        }
+        wordlist_free(&matches);
+    }
+    free(m.elems);
+}
+
+// '**': the rest of the pattern is matched below 'path' itself and below
+// every directory under it. Hidden directories and symlinks are not entered.
+static void add_recursive(char *path, size_t path_len, char **components, int n, WordList *out) {
+    if (n == 0) {
+        // A trailing ** matches everything below, like **/*
+        static char *star[] = { "*" };
+        expand_from(path, path_len, star, 1, out);
+    } else {
+        expand_from(path, path_len, components, n, out);
+    }
+
+    const Listing *l = list_directory(path_len ? path : ".");
+    if (!l) return;
+    WordList dirs = { NULL, 0, 0 };
+    for (size_t i = 0; i < l->count; i++) {
+        const char *name = l->names + l->offsets[i];
+        if (name[0] == '.') continue;
+        if (l->types[i] == DT_DIR || (l->types[i] == DT_UNKNOWN && is_directory(path, l, i))) wordlist_push(&dirs, strdup(name));
+    }
+    for (int i = 0; i < dirs.count; i++) {
+        size_t len = path_len;
+        path_push(path, &len, dirs.items[i]);
+        add_recursive(path, len, components, n, out);
+        path[path_len] = '\0';
+    }
+    wordlist_free(&dirs);
+}
+
+static bool is_directory(const char *path, const Listing *l, size_t i) {
+    char full[PATH_MAX];
+    snprintf(full, sizeof(full), "%s%s%s", path, *path && path[strlen(path) - 1] != '/' ? "/" : "", l->names + l->offsets[i]);
+    struct stat st;
+    return lstat(full, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static void path_push(char *path, size_t *len, const char *name) {
+    size_t name_len = strlen(name);
+    bool slash = *len > 0 && path[*len - 1] != '/';
+    if (*len + slash + name_len + 1 > PATH_MAX) return;
+    if (slash) path[(*len)++] = '/';
+    memcpy(path + *len, name, name_len + 1);
+    *len += name_len;
+}
+
+// --- Matcher ---
+
+static void compile(const char *pattern, size_t len, Matcher *m) {
+    m->elems = malloc(sizeof(Elem) * (len + 1));
+    if (!m->elems) { perror("malloc"); exit(EXIT_FAILURE); }
+    m->count = 0;
+    m->dot_ok = pattern[0] == '.';
+
+    for (size_t i = 0; i < len; i++) {
+        Elem *e = &m->elems[m->count];
+        memset(e, 0, sizeof(*e));
+        char c = pattern[i];
+        if (c == '*') {
+            // Runs of '*' are one star
+            if (m->count > 0 && m->elems[m->count - 1].type == ELEM_STAR) continue;
+            e->type = ELEM_STAR;
+        } else if (c == '?') {
+            e->type = ELEM_ANY;
+        } else if (c == '[') {
+            size_t j = i + 1;
+            bool negate = j < len && (pattern[j] == '!' || pattern[j] == '^');
+            if (negate) j++;
+            size_t start = j;
+            // A ']' right after '[' or '[!' is a member, not the end
+            while (j < len && (pattern[j] != ']' || j == start)) j++;
+            if (j >= len) {
+                e->type = ELEM_CHAR;     // No closing ']': a literal '['
+                e->c = '[';
+            } else {
+                e->type = ELEM_CLASS;
+                for (size_t k = start; k < j; k++) {
+                    unsigned char lo = pattern[k], hi = lo;
+                    if (k + 2 < j && pattern[k + 1] == '-') { hi = pattern[k + 2]; k += 2; }
+                    for (unsigned v = lo; v <= hi; v++) e->set[v / 64] |= 1ULL << (v % 64);
+                }
+                if (negate) for (int w = 0; w < 4; w++) e->set[w] = ~e->set[w];
+                i = j;
+            }
+        } else {
+            e->type = ELEM_CHAR;
+            e->c = (unsigned char)c;
+        }
+        m->count++;
+    }
+
+    // Literal runs at either end let most names be rejected with a memcmp()
+    // before the NFA runs. Each literal element is one pattern character.
+    int first = 0, last = m->count;
+    while (first < m->count && m->elems[first].type == ELEM_CHAR) first++;
+    while (last > first && m->elems[last - 1].type == ELEM_CHAR) last--;
+    m->prefix = pattern;
+    m->prefix_len = first;
+    m->suffix_len = m->count - last;
+    m->suffix = pattern + len - m->suffix_len;
+
+    m->min_len = 0;
+    for (int i = 0; i < m->count; i++) m->min_len += m->elems[i].type != ELEM_STAR;
+    m->fixed_len = m->min_len == (size_t)m->count;
+}
+
+static inline bool elem_matches(const Elem *e, unsigned char c) {
+    switch (e->type) {
+    case ELEM_CHAR: return e->c == c;
+    case ELEM_ANY: return true;
+    case ELEM_CLASS: return e->set[c / 64] & (1ULL << (c % 64));
+    default: return false;
+    }
+}
+
+// States are positions 0..count in the element list; state 'count' accepts.
+// A star state loops on any character and is also skipped for free.
+static bool run_matcher(const Matcher *m, const char *name) {
+    size_t name_len = strlen(name);
+    if (name_len < m->min_len || (m->fixed_len && name_len != m->min_len)) return false;
+    if (memcmp(name, m->prefix, m->prefix_len) != 0) return false;
+    if (memcmp(name + name_len - m->suffix_len, m->suffix, m->suffix_len) != 0) return false;
+
+    int words = (m->count + 1 + 63) / 64;
+    uint64_t small[8];
+    uint64_t *heap = words > 4 ? malloc(sizeof(uint64_t) * words * 2) : NULL;
+    uint64_t *current = heap ? heap : small, *next = current + words;
+    if (words > 4 && !heap) { perror("malloc"); exit(EXIT_FAILURE); }
+
+    memset(current, 0, sizeof(uint64_t) * words);
+    current[0] = 1;
+    // Epsilon closure: a star may match nothing
+    for (int s = 0; s < m->count; s++) {
+        if ((current[s / 64] >> (s % 64) & 1) && m->elems[s].type == ELEM_STAR) current[(s + 1) / 64] |= 1ULL << ((s + 1) % 64);
+    }
+
+    bool alive = true;
+    for (const unsigned char *p = (const unsigned char *)name; *p && alive; p++) {
+        memset(next, 0, sizeof(uint64_t) * words);
+        alive = false;
+        for (int s = 0; s < m->count; s++) {
+            if (!(current[s / 64] >> (s % 64) & 1)) continue;
+            const Elem *e = &m->elems[s];
+            if (e->type == ELEM_STAR) {
+                next[s / 64] |= 1ULL << (s % 64);
+                alive = true;
+            } else if (elem_matches(e, *p)) {
+                next[(s + 1) / 64] |= 1ULL << ((s + 1) % 64);
+                alive = true;
+            }
+        }
+        for (int s = 0; s < m->count; s++) {
+            if ((next[s / 64] >> (s % 64) & 1) && m->elems[s].type == ELEM_STAR) next[(s + 1) / 64] |= 1ULL << ((s + 1) % 64);
+        }
+        uint64_t *swap = current;
+        current = next;
+        next = swap;
+    }
+
+    bool matched = alive && (current[m->count / 64] >> (m->count % 64) & 1);
+    free(heap);
+    return matched;
+}
+
+// --- Directory cache ---
+
+// A listing is reused while the directory's mtime is unchanged. Listings
+// taken within a few ticks of the last modification are not trusted, since
+// a change in the same timestamp tick would not move the mtime.
+static const Listing* list_directory(const char *path) {
+    struct stat st;
+    if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) return NULL;
+
+    for (int i = 0; i < GLOB_CACHE_SIZE; i++) {
+        Listing *l = &cache[i];
+        if (l->path && l->dev == st.st_dev && l->ino == st.st_ino && l->mtime.tv_sec == st.st_mtim.tv_sec
+            && l->mtime.tv_nsec == st.st_mtim.tv_nsec && strcmp(l->path, path) == 0) {
+            return l;
+        }
+    }
+
+    DIR *d = opendir(path);
+    if (!d) return NULL;
+    struct timespec scanned;
+    clock_gettime(CLOCK_REALTIME, &scanned);
+
+    Listing *l = &cache[cache_next];
+    cache_next = (cache_next + 1) % GLOB_CACHE_SIZE;
+    free_listing(l);
+
+    size_t names_cap = 4096, names_len = 0, cap = 64;
+    l->names = malloc(names_cap);
+    l->offsets = malloc(sizeof(size_t) * cap);
+    l->types = malloc(cap);
+    if (!l->names || !l->offsets || !l->types) { perror("malloc"); exit(EXIT_FAILURE); }
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        size_t len = strlen(name) + 1;
+        if (names_len + len > names_cap) {
+            while (names_len + len > names_cap) names_cap *= 2;
+            l->names = realloc(l->names, names_cap);
+        }
+        if (l->count == cap) {
+            cap *= 2;
+            l->offsets = realloc(l->offsets, sizeof(size_t) * cap);
+            l->types = realloc(l->types, cap);
+        }
+        if (!l->names || !l->offsets || !l->types) { perror("realloc"); exit(EXIT_FAILURE); }
+        memcpy(l->names + names_len, name, len);
+        l->offsets[l->count] = names_len;
+        l->types[l->count++] = entry->d_type;
+        names_len += len;
+    }
+    closedir(d);
+
+    l->path = strdup(path);
+    l->dev = st.st_dev;
+    l->ino = st.st_ino;
+    l->mtime = st.st_mtim;
+    // Racy: modified within 20ms of the scan. Usable now, not cached.
+    double age = (scanned.tv_sec - st.st_mtim.tv_sec) + (scanned.tv_nsec - st.st_mtim.tv_nsec) / 1e9;
+    if (age < 0.02) l->mtime.tv_nsec = -1;
+    return l;
+}
+
+static void free_listing(Listing *l) {
+    free(l->path);
+    free(l->names);
+    free(l->offsets);
+    free(l->types);
+    memset(l, 0, sizeof(*l));
+}
+
+static int compare_words(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
\ No newline at end of file
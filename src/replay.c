@@ -0,0 +1,248 @@
+#include "shell.h"
+#include "replay.h"
+#include "builtins.h"
+#include "executor.h"
+#include "jobs.h"
+#include "parser.h"
+#include "pathglob.h"
+#include "script.h"
+
+#include <ctype.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// Ordered so that a line mixing several kinds counts as the heaviest one
+typedef enum {
+    KIND_BUILTIN,
+    KIND_EXTERNAL,
+    KIND_PIPELINE,
+    KIND_BACKGROUND,
+    KIND_COMPOUND,
+    KIND_COUNT
+} CommandKind;
+
+static const char *kind_names[KIND_COUNT] = {
+    "builtin", "external", "pipeline", "background", "compound"
+};
+
+typedef struct {
+    double latency, cpu;    // ms, measured by this replay
+    double recorded;        // ms from the record file, or -1
+    CommandKind kind;
+} Sample;
+
+static FILE *record_file = NULL;
+
+static double wall_ms(void);
+static double cpu_ms(void);
+static bool parse_record(char *line, double *latency, int *status, char **command);
+static CommandKind classify(const char *line);
+static CommandKind classify_group(char *text);
+static void print_row(const char *name, const Sample *samples, int count, int kind, bool with_recorded);
+static void print_percentiles(double *values, int count);
+static int compare_double(const void *a, const void *b);
+
+int record_open(const char *path) {
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || !(record_file = fdopen(fd, "a"))) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size == 0) {
+        fprintf(record_file, "# time\tlatency_ms\tshell_cpu_ms\tstatus\tcommand\n");
+        fflush(record_file);
+    }
+    return 0;
+}
+
+void record_begin(ReplayMark *mark, const char *command) {
+    mark->command = NULL;
+    if (!record_file || *command == '\0') return;
+    mark->command = strdup(command);
+    mark->wall = wall_ms();
+    mark->cpu = cpu_ms();
+}
+
+void record_end(ReplayMark *mark) {
+    if (!mark->command) return;
+    double latency = wall_ms() - mark->wall;
+    double cpu = cpu_ms() - mark->cpu;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    fprintf(record_file, "%lld.%03ld\t%.3f\t%.3f\t%d\t%s\n", (long long)now.tv_sec,
+            now.tv_nsec / 1000000, latency, cpu, LAST_STATUS, mark->command);
+    // Flushed per line so a forked child never inherits buffered records
+    fflush(record_file);
+    free(mark->command);
+    mark->command = NULL;
+}
+
+int replay_run(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return EXIT_FAILURE; }
+
+    Sample *samples = NULL;
+    int count = 0, capacity = 0, mismatched = 0;
+    bool with_recorded = false;
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    double started = wall_ms();
+    while ((len = getline(&line, &size, f)) >= 0) {
+        if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
+        double recorded = -1;
+        int recorded_status = -1;
+        char *command = line;
+        parse_record(line, &recorded, &recorded_status, &command);
+        while (isspace((unsigned char)*command)) command++;
+        if (*command == '\0' || *command == '#') continue;
+
+        // The same per-line housekeeping as the interactive loop, outside
+        // the measured span
+        jobs_reap();
+        glob_cache_clear();
+        CommandKind kind = classify(command);
+
+        double wall = wall_ms(), cpu = cpu_ms();
+        execute_line(command);
+        double latency = wall_ms() - wall;
+        cpu = cpu_ms() - cpu;
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            samples = realloc(samples, sizeof(Sample) * capacity);
+            if (!samples) { perror("realloc"); exit(EXIT_FAILURE); }
+        }
+        samples[count++] = (Sample){ latency, cpu, recorded, kind };
+        if (recorded >= 0) with_recorded = true;
+        if (recorded_status >= 0 && recorded_status != LAST_STATUS) mismatched++;
+    }
+    free(line);
+    fclose(f);
+    fflush(stdout);
+    jobs_kill_all();
+
+    fprintf(stderr, "replay: %d commands from %s in %.2f s\n", count, path,
+            (wall_ms() - started) / 1000);
+    fprintf(stderr, "%-10s %5s  %26s  %26s", "type", "count",
+            "latency ms p50/p95/p99", "shell cpu ms p50/p95/p99");
+    if (with_recorded) fprintf(stderr, "  %26s", "recorded ms p50/p95/p99");
+    fprintf(stderr, "\n");
+    print_row("all", samples, count, -1, with_recorded);
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        print_row(kind_names[kind], samples, count, kind, with_recorded);
+    }
+    if (mismatched > 0) {
+        fprintf(stderr, "replay: %d commands exited with a different status than recorded\n",
+                mismatched);
+    }
+    free(samples);
+    return EXIT_SUCCESS;
+}
+
+static double wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// User+system time of the shell process only, not of its children
+static double cpu_ms(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1e3
+        + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e3;
+}
+
+// A record line is "time\tlatency\tcpu\tstatus\tcommand"; anything else is
+// taken to be a plain command as found in ~/.cshell_log
+static bool parse_record(char *line, double *latency, int *status, char **command) {
+    double fields[3];
+    char *p = line, *end;
+    for (int i = 0; i < 3; i++) {
+        fields[i] = strtod(p, &end);
+        if (end == p || *end != '\t') return false;
+        p = end + 1;
+    }
+    long value = strtol(p, &end, 10);
+    if (end == p || *end != '\t') return false;
+    *latency = fields[1];
+    *status = (int)value;
+    *command = end + 1;
+    return true;
+}
+
+// Splits the line the way process_line() does and keeps the heaviest kind
+static CommandKind classify(const char *line) {
+    if (script_is_compound(line)) return KIND_COMPOUND;
+    char *copy = strdup(line);
+    CommandKind kind = KIND_BUILTIN;
+    for (char *current = copy; ; ) {
+        size_t n = shell_strcspn(current, ";&");
+        char separator = current[n];
+        current[n] = '\0';
+        CommandKind group = separator == '&' ? KIND_BACKGROUND : classify_group(current);
+        if (group > kind) kind = group;
+        if (separator == '\0') break;
+        current += n + 1;
+    }
+    free(copy);
+    return kind;
+}
+
+static CommandKind classify_group(char *text) {
+    if (text[shell_strcspn(text, "|")] == '|') return KIND_PIPELINE;
+    char *saveptr;
+    for (char *word = shell_strtok(text, " \t", &saveptr); word;
+         word = shell_strtok(NULL, " \t", &saveptr)) {
+        if (is_assignment(word)) continue;
+        return builtin_lookup(word) ? KIND_BUILTIN : KIND_EXTERNAL;
+    }
+    // A bare assignment is handled by the shell itself
+    return KIND_BUILTIN;
+}
+
+static void print_row(const char *name, const Sample *samples, int count, int kind, bool with_recorded) {
+    double *latency = malloc(sizeof(double) * (count + 1));
+    double *cpu = malloc(sizeof(double) * (count + 1));
+    double *recorded = malloc(sizeof(double) * (count + 1));
+    int n = 0, recorded_n = 0;
+    for (int i = 0; i < count; i++) {
+        if (kind >= 0 && samples[i].kind != (CommandKind)kind) continue;
+        latency[n] = samples[i].latency;
+        cpu[n++] = samples[i].cpu;
+        if (samples[i].recorded >= 0) recorded[recorded_n++] = samples[i].recorded;
+    }
+    if (n > 0) {
+        fprintf(stderr, "%-10s %5d  ", name, n);
+        print_percentiles(latency, n);
+        fprintf(stderr, "  ");
+        print_percentiles(cpu, n);
+        if (with_recorded) {
+            fprintf(stderr, "  ");
+            if (recorded_n > 0) print_percentiles(recorded, recorded_n);
+            else fprintf(stderr, "%26s", "-");
+        }
+        fprintf(stderr, "\n");
+    }
+    free(latency);
+    free(cpu);
+    free(recorded);
+}
+
+// Nearest-rank p50, p95 and p99; sorts 'values'
+static void print_percentiles(double *values, int count) {
+    static const int ranks[] = { 50, 95, 99 };
+    qsort(values, count, sizeof(double), compare_double);
+    for (int i = 0; i < 3; i++) {
+        int index = (ranks[i] * count + 99) / 100 - 1;
+        fprintf(stderr, i ? " %8.2f" : "%8.2f", values[index]);
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,711 @@
+#include "shell.h"
+#include "script.h"
+#include "executor.h"
+#include "parser.h"
+#include "variables.h"
+#include "metrics.h"
+
+#include <ctype.h>
+#include <fnmatch.h>
+#include <stdint.h>
+
+#define MAX_LOOP_DEPTH 64
+#define MAX_GROUP_DEPTH 32
+
+// OP_GROUP flags
+#define GROUP_SUBSHELL 1
+#define GROUP_ELIDE 2       // The body is one pipeline that forks anyway
+
+// Characters that end a word in command position
+#define WORD_DELIMS " \t\r\n;&|<>()"
+
+typedef enum {
+    OP_RUN,          // a: pipeline, b: run in background
+    OP_JUMP,         // a: target
+    OP_JUMP_FALSE,   // a: target, taken when LAST_STATUS != 0
+    OP_JUMP_TRUE,    // a: target, taken when LAST_STATUS == 0
+    OP_STATUS,       // a: new LAST_STATUS
+    OP_FOR_INIT,     // slot; a: first word, b: word count
+    OP_FOR_NEXT,     // slot; a: variable name, b: target once exhausted
+    OP_CASE_WORD,    // slot; a: word
+    OP_CASE_TEST,    // slot; a: first pattern, b: pattern count, c: target on no match
+    OP_GROUP,        // slot: GROUP_* flags; a: redirections (-1: none), b: its OP_GROUP_END, c: subshell text
+    OP_GROUP_END,
+    OP_UNWIND        // a: group depth to return to, before break/continue jumps out of groups
+} OpCode;
+
+typedef struct {
+    uint8_t op;
+    uint16_t slot;
+    int32_t a, b, c;
+} Instr;
+
+struct Program {
+    Instr *code;
+    int code_len, code_cap;
+    CommandGroup **groups;      // Pre-parsed pipelines for OP_RUN
+    int group_count, group_cap;
+    char **strings;             // Words, names and patterns, expanded at run time
+    int string_count, string_cap;
+    int slot_count;             // One per for loop / case statement
+};
+
+// Run-time state of a for loop (remaining words) or case (the subject)
+typedef struct {
+    WordList words;
+    int next;
+} Slot;
+
+// Run-time state of a { ...; } or ( ... ) group whose body is running
+typedef struct {
+    bool forked;                // This process is the subshell, and exits at the end
+    bool redirected;
+    bool relayed;               // Its redirections fan out through relays
+} GroupFrame;
+
+typedef struct {
+    int continue_target;
+    int break_chain;            // Pending break jumps, linked through 'a'
+    int group_depth;            // Groups open around the loop
+} Loop;
+
+typedef struct {
+    const char *src;
+    size_t pos;
+    Program *program;
+    Loop loops[MAX_LOOP_DEPTH];
+    int loop_depth;
+    int loop_floor;             // Loops outside the innermost subshell, out of reach of break
+    int group_depth;
+    int paren_depth;            // Subshells open; ')' ends a command inside one
+    CompileResult result;
+    char error[128];
+} Compiler;
+
+static const char *const RESERVED[] = { "if", "then", "elif", "else", "fi", "for", "while", "until", "do", "done", "case", "esac", "{", "}", NULL };
+static const char *const CLOSERS[] = { "then", "elif", "else", "fi", "do", "done", "esac", "}", NULL };
+static const char *const THEN_TERMS[] = { "then", NULL };
+static const char *const BRANCH_TERMS[] = { "elif", "else", "fi", NULL };
+static const char *const FI_TERMS[] = { "fi", NULL };
+static const char *const DO_TERMS[] = { "do", NULL };
+static const char *const DONE_TERMS[] = { "done", NULL };
+static const char *const ESAC_TERMS[] = { "esac", NULL };
+static const char *const BRACE_TERMS[] = { "}", NULL };
+// A subshell ends at ')', which is not a word; this only makes running out
+// of input inside one incomplete rather than an error
+static const char *const PAREN_TERMS[] = { NULL };
+
+static int compile_list(Compiler *c, const char *const *terms, bool in_case);
+static bool compile_body(Compiler *c, const char *const *terms);
+static void compile_command(Compiler *c);
+static void compile_pipeline(Compiler *c);
+static void compile_if(Compiler *c);
+static void compile_while(Compiler *c);
+static void compile_for(Compiler *c);
+static void compile_case(Compiler *c);
+static void compile_group(Compiler *c, bool subshell);
+static void compile_break(Compiler *c);
+static void syntax_error(Compiler *c);
+static int emit(Compiler *c, OpCode op, int slot, int a, int b, int c3);
+static void patch_chain(Compiler *c, int chain, int target);
+static bool is_tail(const Program *program, int pc, const GroupFrame *frames, int depth);
+static void end_group(GroupFrame *frame);
+
+// --- Lexing helpers ---
+
+static void skip_blanks(Compiler *c) {
+    while (c->src[c->pos] == ' ' || c->src[c->pos] == '\t' || c->src[c->pos] == '\r') c->pos++;
+}
+
+// Skips blanks and command separators (';' and newlines, but not ';;')
+static void skip_separators(Compiler *c) {
+    for (;;) {
+        skip_blanks(c);
+        char ch = c->src[c->pos];
+        if (ch == '\n' || (ch == ';' && c->src[c->pos + 1] != ';')) c->pos++;
+        else break;
+    }
+}
+
+static bool at_end(Compiler *c) { return c->src[c->pos] == '\0'; }
+static bool at_case_end(Compiler *c) { return c->src[c->pos] == ';' && c->src[c->pos + 1] == ';'; }
+static size_t word_len(Compiler *c) { return shell_strcspn(c->src + c->pos, WORD_DELIMS); }
+
+static bool word_is(Compiler *c, const char *word) {
+    size_t len = word_len(c);
+    return len == strlen(word) && strncmp(c->src + c->pos, word, len) == 0;
+}
+
+static bool word_in(Compiler *c, const char *const *set) {
+    for (; set && *set; set++) if (word_is(c, *set)) return true;
+    return false;
+}
+
+// Consumes 'word' after optional separators. Running out of input is not an
+// error here: the caller may supply more lines.
+static bool expect(Compiler *c, const char *word) {
+    skip_separators(c);
+    if (at_end(c)) {
+        if (c->result == COMPILE_OK) c->result = COMPILE_INCOMPLETE;
+        return false;
+    }
+    if (!word_is(c, word)) { syntax_error(c); return false; }
+    c->pos += strlen(word);
+    return true;
+}
+
+static void syntax_error(Compiler *c) {
+    if (c->result != COMPILE_OK) return;
+    if (at_end(c)) { c->result = COMPILE_INCOMPLETE; return; }
+    size_t len = word_len(c);
+    if (len == 0) len = at_case_end(c) ? 2 : 1;
+    c->result = COMPILE_ERROR;
+    snprintf(c->error, sizeof(c->error), "Invalid Syntax near `%.*s'!", (int)len, c->src + c->pos);
+}
+
+// --- Program building ---
+
+static int emit(Compiler *c, OpCode op, int slot, int a, int b, int c3) {
+    Program *p = c->program;
+    if (p->code_len == p->code_cap) {
+        p->code_cap = p->code_cap ? p->code_cap * 2 : 32;
+        p->code = realloc(p->code, sizeof(Instr) * p->code_cap);
+        if (!p->code) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    p->code[p->code_len] = (Instr){ (uint8_t)op, (uint16_t)slot, a, b, c3 };
+    return p->code_len++;
+}
+
+static int add_string(Compiler *c, const char *s, size_t len) {
+    Program *p = c->program;
+    if (p->string_count == p->string_cap) {
+        p->string_cap = p->string_cap ? p->string_cap * 2 : 16;
+        p->strings = realloc(p->strings, sizeof(char *) * p->string_cap);
+        if (!p->strings) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    p->strings[p->string_count] = strndup(s, len);
+    return p->string_count++;
+}
+
+static int add_group(Compiler *c, CommandGroup *group) {
+    Program *p = c->program;
+    if (p->group_count == p->group_cap) {
+        p->group_cap = p->group_cap ? p->group_cap * 2 : 16;
+        p->groups = realloc(p->groups, sizeof(CommandGroup *) * p->group_cap);
+        if (!p->groups) { perror("realloc"); exit(EXIT_FAILURE); }
+    }
+    p->groups[p->group_count] = group;
+    return p->group_count++;
+}
+
+static int new_slot(Compiler *c) {
+    if (c->program->slot_count == UINT16_MAX) {
+        c->result = COMPILE_ERROR;
+        snprintf(c->error, sizeof(c->error), "Too many loops in one command!");
+        return 0;
+    }
+    return c->program->slot_count++;
+}
+
+// Forward jumps whose target is not known yet are chained through their
+// 'a' operand and resolved together
+static void patch_chain(Compiler *c, int chain, int target) {
+    while (chain >= 0) {
+        int next = c->program->code[chain].a;
+        c->program->code[chain].a = target;
+        chain = next;
+    }
+}
+
+static bool push_loop(Compiler *c, int continue_target) {
+    if (c->loop_depth == MAX_LOOP_DEPTH) {
+        c->result = COMPILE_ERROR;
+        snprintf(c->error, sizeof(c->error), "Loops nested too deeply!");
+        return false;
+    }
+    c->loops[c->loop_depth++] = (Loop){ continue_target, -1, c->group_depth };
+    return true;
+}
+
+static void pop_loop(Compiler *c, int break_target) {
+    patch_chain(c, c->loops[--c->loop_depth].break_chain, break_target);
+}
+
+// --- Grammar ---
+
+// Compiles commands until one of 'terms' (or ';;' inside a case item) is
+// reached. Returns the number of commands compiled.
+static int compile_list(Compiler *c, const char *const *terms, bool in_case) {
+    int count = 0;
+    while (c->result == COMPILE_OK) {
+        skip_separators(c);
+        if (at_end(c)) {
+            if (terms) c->result = COMPILE_INCOMPLETE;
+            break;
+        }
+        if (at_case_end(c)) {
+            if (!in_case) syntax_error(c);
+            break;
+        }
+        if (c->src[c->pos] == ')') {
+            // Closes a subshell, which consumes it
+            if (c->paren_depth == 0) syntax_error(c);
+            break;
+        }
+        if (word_in(c, terms)) break;
+        if (word_in(c, CLOSERS)) { syntax_error(c); break; }
+        compile_command(c);
+        count++;
+    }
+    return count;
+}
+
+// A list that must contain at least one command
+static bool compile_body(Compiler *c, const char *const *terms) {
+    if (compile_list(c, terms, false) == 0) syntax_error(c);
+    return c->result == COMPILE_OK;
+}
+
+static void compile_command(Compiler *c) {
+    if (word_is(c, "if")) compile_if(c);
+    else if (word_is(c, "while") || word_is(c, "until")) compile_while(c);
+    else if (word_is(c, "for")) compile_for(c);
+    else if (word_is(c, "case")) compile_case(c);
+    else if (word_is(c, "break") || word_is(c, "continue")) compile_break(c);
+    else if (word_is(c, "{")) compile_group(c, false);
+    else if (c->src[c->pos] == '(') compile_group(c, true);
+    else { compile_pipeline(c); return; }
+
+    // Compound commands cannot be piped or put in the background, and only
+    // groups take redirections
+    skip_blanks(c);
+    if (c->result == COMPILE_OK && !at_end(c) && c->src[c->pos] != ';' && c->src[c->pos] != '\n'
+        && !(c->paren_depth > 0 && c->src[c->pos] == ')')) syntax_error(c);
+}
+
+// A pipeline runs up to the next ';', newline or '&'. Its text is parsed
+// once here; expansion happens each time it runs.
+static void compile_pipeline(Compiler *c) {
+    size_t start = c->pos;
+    c->pos += shell_strcspn(c->src + c->pos, c->paren_depth > 0 ? ";\n&)" : ";\n&");
+    bool is_background = c->src[c->pos] == '&';
+    char *text = strndup(c->src + start, c->pos - start);
+    if (is_background) c->pos++;
+
+    if (!is_valid_syntax(text)) {
+        c->result = COMPILE_ERROR;
+        snprintf(c->error, sizeof(c->error), "Invalid Syntax!");
+        free(text);
+        return;
+    }
+    CommandGroup *group = parse_cmd_group(text);
+    free(text);
+    if (!group) { perror("malloc"); exit(EXIT_FAILURE); }
+    emit(c, OP_RUN, 0, add_group(c, group), is_background, 0);
+}
+
+// if list; then list; [elif list; then list;]... [else list;] fi
+static void compile_if(Compiler *c) {
+    c->pos += 2;
+    int end_chain = -1;
+    for (;;) {
+        if (!compile_body(c, THEN_TERMS) || !expect(c, "then")) return;
+        int skip = emit(c, OP_JUMP_FALSE, 0, -1, 0, 0);
+        if (!compile_body(c, BRANCH_TERMS)) return;
+        end_chain = emit(c, OP_JUMP, 0, end_chain, 0, 0);
+        patch_chain(c, skip, c->program->code_len);
+
+        if (word_is(c, "elif")) { c->pos += 4; continue; }
+        if (word_is(c, "else")) {
+            c->pos += 4;
+            if (!compile_body(c, FI_TERMS)) return;
+        } else {
+            // No branch taken
+            emit(c, OP_STATUS, 0, 0, 0, 0);
+        }
+        break;
+    }
+    if (!expect(c, "fi")) return;
+    patch_chain(c, end_chain, c->program->code_len);
+}
+
+// while|until list; do list; done
+static void compile_while(Compiler *c) {
+    bool is_until = word_is(c, "until");
+    c->pos += 5;
+    int top = c->program->code_len;
+    if (!compile_body(c, DO_TERMS) || !expect(c, "do")) return;
+    int exit_jump = emit(c, is_until ? OP_JUMP_TRUE : OP_JUMP_FALSE, 0, -1, 0, 0);
+    if (!push_loop(c, top)) return;
+    if (!compile_body(c, DONE_TERMS) || !expect(c, "done")) return;
+    emit(c, OP_JUMP, 0, top, 0, 0);
+    patch_chain(c, exit_jump, c->program->code_len);
+    pop_loop(c, c->program->code_len);
+    emit(c, OP_STATUS, 0, 0, 0, 0);
+}
+
+// for name [in word...]; do list; done
+static void compile_for(Compiler *c) {
+    c->pos += 3;
+    skip_blanks(c);
+    size_t len = word_len(c);
+    if (len == 0) { syntax_error(c); return; }
+    if (!var_name_valid(c->src + c->pos, len)) {
+        c->result = COMPILE_ERROR;
+        snprintf(c->error, sizeof(c->error), "for: `%.*s': not a valid identifier", (int)len, c->src + c->pos);
+        return;
+    }
+    int name = add_string(c, c->src + c->pos, len);
+    c->pos += len;
+
+    int first = c->program->string_count, count = 0;
+    skip_separators(c);
+    if (word_is(c, "in")) {
+        c->pos += 2;
+        for (;;) {
+            skip_blanks(c);
+            char ch = c->src[c->pos];
+            if (ch == '\0' || ch == ';' || ch == '\n') break;
+            len = word_len(c);
+            if (len == 0) { syntax_error(c); return; }
+            add_string(c, c->src + c->pos, len);
+            c->pos += len;
+            count++;
+        }
+    }
+    if (!expect(c, "do")) return;
+
+    int slot = new_slot(c);
+    emit(c, OP_FOR_INIT, slot, first, count, 0);
+    int top = emit(c, OP_FOR_NEXT, slot, name, -1, 0);
+    if (!push_loop(c, top)) return;
+    if (!compile_body(c, DONE_TERMS) || !expect(c, "done")) return;
+    emit(c, OP_JUMP, 0, top, 0, 0);
+    c->program->code[top].b = c->program->code_len;
+    pop_loop(c, c->program->code_len);
+}
+
+// case word in [(]pattern[|pattern]...) list ;; ... esac
+static void compile_case(Compiler *c) {
+    c->pos += 4;
+    skip_blanks(c);
+    size_t len = word_len(c);
+    if (len == 0) { syntax_error(c); return; }
+    int word = add_string(c, c->src + c->pos, len);
+    c->pos += len;
+    if (!expect(c, "in")) return;
+
+    int slot = new_slot(c);
+    emit(c, OP_CASE_WORD, slot, word, 0, 0);
+    int end_chain = -1;
+    for (;;) {
+        skip_separators(c);
+        if (at_end(c)) { c->result = COMPILE_INCOMPLETE; return; }
+        if (word_is(c, "esac")) { c->pos += 4; break; }
+
+        if (c->src[c->pos] == '(') c->pos++;
+        int first = c->program->string_count, count = 0;
+        for (;;) {
+            skip_blanks(c);
+            len = shell_strcspn(c->src + c->pos, " \t\r\n;&|()");
+            if (len == 0) { syntax_error(c); return; }
+            add_string(c, c->src + c->pos, len);
+            c->pos += len;
+            count++;
+            skip_blanks(c);
+            if (c->src[c->pos] == '|') { c->pos++; continue; }
+            if (c->src[c->pos] == ')') { c->pos++; break; }
+            syntax_error(c);
+            return;
+        }
+
+        int test = emit(c, OP_CASE_TEST, slot, first, count, -1);
+        compile_list(c, ESAC_TERMS, true);
+        if (c->result != COMPILE_OK) return;
+        end_chain = emit(c, OP_JUMP, 0, end_chain, 0, 0);
+        c->program->code[test].c = c->program->code_len;
+        if (at_case_end(c)) c->pos += 2;
+    }
+    // No pattern matched
+    emit(c, OP_STATUS, 0, 0, 0, 0);
+    patch_chain(c, end_chain, c->program->code_len);
+}
+
+// { list; } or ( list ), optionally followed by redirections for the whole
+// group. A subshell runs in a forked copy of the shell, unless the VM can
+// tell that forking would make no difference (see script_run()).
+static void compile_group(Compiler *c, bool subshell) {
+    if (c->group_depth == MAX_GROUP_DEPTH) {
+        c->result = COMPILE_ERROR;
+        snprintf(c->error, sizeof(c->error), "Groups nested too deeply!");
+        return;
+    }
+    size_t start = c->pos++;
+    int begin = emit(c, OP_GROUP, subshell ? GROUP_SUBSHELL : 0, -1, -1, -1);
+    int loop_floor = c->loop_floor;
+    if (subshell) {
+        // A loop outside cannot be broken out of from a separate process
+        c->loop_floor = c->loop_depth;
+        c->paren_depth++;
+    }
+    c->group_depth++;
+    bool ok = compile_body(c, subshell ? PAREN_TERMS : BRACE_TERMS);
+    c->group_depth--;
+    if (subshell) {
+        c->loop_floor = loop_floor;
+        c->paren_depth--;
+    }
+    if (!ok) return;
+    if (subshell) {
+        skip_separators(c);
+        if (c->src[c->pos] != ')') { syntax_error(c); return; }
+        c->pos++;
+    } else if (!expect(c, "}")) {
+        return;
+    }
+
+    size_t text_end = c->pos;
+    skip_blanks(c);
+    size_t redir_start = c->pos;
+    c->pos += shell_strcspn(c->src + c->pos, c->paren_depth > 0 ? ";\n&|)" : ";\n&|");
+    size_t len = c->pos - redir_start;
+    while (len > 0 && isspace((unsigned char)c->src[redir_start + len - 1])) len--;
+    if (len > 0) {
+        char *text = strndup(c->src + redir_start, len);
+        CommandGroup *group = is_valid_syntax(text) ? parse_cmd_group(text) : NULL;
+        free(text);
+        if (!group || !group_only_redirects(group)) {
+            free_cmd_group(group);
+            c->pos = redir_start;
+            syntax_error(c);
+            return;
+        }
+        c->program->code[begin].a = add_group(c, group);
+        text_end = redir_start + len;
+    }
+
+    int end = emit(c, OP_GROUP_END, 0, 0, 0, 0);
+    Instr *code = c->program->code;
+    code[begin].b = end;
+    if (subshell) {
+        code[begin].c = add_string(c, c->src + start, text_end - start);
+        const Instr *body = &code[begin + 1];
+        if (end == begin + 2 && body->op == OP_RUN && !body->b && group_forks(c->program->groups[body->a])) code[begin].slot |= GROUP_ELIDE;
+    }
+}
+
+// break [n] / continue [n]
+static void compile_break(Compiler *c) {
+    bool is_break = word_is(c, "break");
+    c->pos += is_break ? 5 : 8;
+    skip_blanks(c);
+    long levels = 1;
+    if (isdigit((unsigned char)c->src[c->pos])) {
+        char *end;
+        levels = strtol(c->src + c->pos, &end, 10);
+        c->pos = end - c->src;
+    }
+    int reachable = c->loop_depth - c->loop_floor;
+    if (reachable == 0 || levels < 1) {
+        c->result = COMPILE_ERROR;
+        snprintf(c->error, sizeof(c->error), "%s: only meaningful in a loop", is_break ? "break" : "continue");
+        return;
+    }
+    if (levels > reachable) levels = reachable;
+    Loop *loop = &c->loops[c->loop_depth - levels];
+    if (c->group_depth > loop->group_depth) emit(c, OP_UNWIND, 0, loop->group_depth, 0, 0);
+    if (is_break) loop->break_chain = emit(c, OP_JUMP, 0, loop->break_chain, 0, 0);
+    else emit(c, OP_JUMP, 0, loop->continue_target, 0, 0);
+}
+
+// --- Public interface ---
+
+bool script_is_compound(const char *text) {
+    const char *p = text;
+    while (*p) {
+        // At the start of a command
+        p += strspn(p, " \t\r\n;&|");
+        if (*p == '(') return true;
+        size_t len = shell_strcspn(p, WORD_DELIMS);
+        for (const char *const *w = RESERVED; *w; w++) {
+            if (len == strlen(*w) && strncmp(p, *w, len) == 0) return true;
+        }
+        p += shell_strcspn(p, ";&|\n");
+    }
+    return false;
+}
+
+CompileResult script_compile(const char *text, bool quiet, Program **out) {
+    Compiler c;
+    memset(&c, 0, sizeof(c));
+    c.src = text;
+    c.result = COMPILE_OK;
+    c.program = calloc(1, sizeof(Program));
+    if (!c.program) { perror("calloc"); exit(EXIT_FAILURE); }
+
+    compile_list(&c, NULL, false);
+
+    *out = NULL;
+    if (c.result != COMPILE_OK) {
+        if (c.result == COMPILE_ERROR && !quiet) fprintf(stderr, "%s\n", c.error);
+        script_free(c.program);
+        return c.result;
+    }
+    *out = c.program;
+    return COMPILE_OK;
+}
+
+int script_run(Program *program) {
+    Slot *slots = calloc(program->slot_count ? program->slot_count : 1, sizeof(Slot));
+    if (!slots) { perror("calloc"); return 1; }
+    char **strings = program->strings;
+    GroupFrame frames[MAX_GROUP_DEPTH];
+    int depth = 0;
+    INTERRUPTED = 0;
+
+    int pc = 0;
+    while (pc < program->code_len) {
+        const Instr *in = &program->code[pc++];
+        Slot *slot = &slots[in->slot];
+        switch ((OpCode)in->op) {
+        case OP_RUN:
+            if (!in->b && is_tail(program, pc, frames, depth)) mark_tail_call();
+            run_parsed_group(program->groups[in->a], in->b);
+            // Ctrl-C ends the whole construct, not just the current command
+            if (INTERRUPTED || LAST_STATUS == 128 + SIGINT) pc = program->code_len;
+            break;
+        case OP_JUMP:
+            // Backward jumps are where a builtin-only loop can be interrupted
+            if (in->a < pc && INTERRUPTED) pc = program->code_len;
+            else pc = in->a;
+            break;
+        case OP_JUMP_FALSE:
+            if (LAST_STATUS != 0) pc = in->a;
+            break;
+        case OP_JUMP_TRUE:
+            if (LAST_STATUS == 0) pc = in->a;
+            break;
+        case OP_STATUS:
+            LAST_STATUS = in->a;
+            break;
+        case OP_FOR_INIT:
+            wordlist_free(&slot->words);
+            slot->next = 0;
+            for (int i = 0; i < in->b; i++) expand_word(strings[in->a + i], true, &slot->words);
+            LAST_STATUS = 0;
+            break;
+        case OP_FOR_NEXT:
+            if (slot->next >= slot->words.count) pc = in->b;
+            else var_set(strings[in->a], slot->words.items[slot->next++], false);
+            break;
+        case OP_CASE_WORD:
+            wordlist_free(&slot->words);
+            expand_word(strings[in->a], false, &slot->words);
+            LAST_STATUS = 0;
+            break;
+        case OP_CASE_TEST: {
+            bool matched = false;
+            for (int i = 0; i < in->b && !matched; i++) {
+                WordList pattern = { NULL, 0, 0 };
+                expand_word(strings[in->a + i], false, &pattern);
+                matched = fnmatch(pattern.items[0], slot->words.items[0], 0) == 0;
+                wordlist_free(&pattern);
+            }
+            if (!matched) pc = in->c;
+            break;
+        }
+        case OP_GROUP: {
+            GroupFrame frame = { false, false, false };
+            // A subshell whose body forks anyway, or after which this
+            // process has nothing left to do, runs without a fork of its own
+            if ((in->slot & GROUP_SUBSHELL) && !(in->slot & GROUP_ELIDE) && !is_tail(program, in->b + 1, frames, depth)) {
+                pid_t pid = subshell_fork();
+                if (pid != 0) {
+                    LAST_STATUS = pid < 0 ? 1 : subshell_wait(pid, strings[in->c]);
+                    pc = INTERRUPTED || LAST_STATUS == 128 + SIGINT ? program->code_len : in->b + 1;
+                    break;
+                }
+                frame.forked = true;
+            } else if (in->slot & GROUP_SUBSHELL) {
+                metrics_fork_saved();
+            }
+            if (in->a >= 0) {
+                if (redirect_push(program->groups[in->a]) == 0) {
+                    frame.redirected = true;
+                    frame.relayed = redirect_has_relays();
+                } else {
+                    // The body is skipped
+                    LAST_STATUS = 1;
+                    pc = in->b;
+                }
+            }
+            frames[depth++] = frame;
+            break;
+        }
+        case OP_GROUP_END:
+            end_group(&frames[--depth]);
+            break;
+        case OP_UNWIND:
+            while (depth > in->a) end_group(&frames[--depth]);
+            break;
+        }
+    }
+    // Ctrl-C left groups open
+    while (depth > 0) end_group(&frames[--depth]);
+
+    for (int i = 0; i < program->slot_count; i++) wordlist_free(&slots[i].words);
+    free(slots);
+    return LAST_STATUS;
+}
+
+// Undoes the group's redirections; a subshell exits here
+static void end_group(GroupFrame *frame) {
+    if (frame->redirected) redirect_pop();
+    if (frame->forked) {
+        fflush(stdout);
+        _exit(LAST_STATUS);
+    }
+}
+
+// True if nothing runs in this process after the instruction before 'pc':
+// only forward jumps and the ends of groups lie between it and the end of
+// a forked subshell, or the end of a line the shell exits after. Relays
+// must be waited for, so a group that fans out ends the search.
+static bool is_tail(const Program *program, int pc, const GroupFrame *frames, int depth) {
+    while (pc < program->code_len) {
+        const Instr *in = &program->code[pc];
+        if (in->op == OP_JUMP && in->a > pc) {
+            pc = in->a;
+        } else if (in->op == OP_GROUP_END && depth > 0) {
+            const GroupFrame *frame = &frames[--depth];
+            if (frame->relayed) return false;
+            if (frame->forked) return true;
+            pc++;
+        } else {
+            return false;
+        }
+    }
+    return exits_after_line();
+}
+
+void script_free(Program *program) {
+    if (!program) return;
+    for (int i = 0; i < program->group_count; i++) free_cmd_group(program->groups[i]);
+    for (int i = 0; i < program->string_count; i++) free(program->strings[i]);
+    free(program->groups);
+    free(program->strings);
+    free(program->code);
+    free(program);
+}
+
+void script_execute(const char *text) {
+    Program *program;
+    CompileResult result = script_compile(text, false, &program);
+    if (result == COMPILE_INCOMPLETE) fprintf(stderr, "Invalid Syntax: unexpected end of input!\n");
+    if (result != COMPILE_OK) {
+        LAST_STATUS = 2;
+        return;
+    }
+    script_run(program);
+    script_free(program);
+}
\ No newline at end of file
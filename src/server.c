@@ -0,0 +1,327 @@
+// CMSG_SPACE/CMSG_LEN, MSG_CMSG_CLOEXEC and SOCK_NONBLOCK need the default feature set
+#define _DEFAULT_SOURCE
+
+#include "shell.h"
+#include "server.h"
+#include "events.h"
+#include "executor.h"
+#include "jobs.h"
+#include "zygote.h"
+
+#include <stdint.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+
+// How long a client may take to send its request once connected, and how
+// many may be doing so at once; others are turned away
+#define SERVER_REQUEST_TIMEOUT 2
+#define SERVER_MAX_PENDING 32
+
+typedef struct {
+    pid_t pid;
+    int conn;       // Answered with the exit status when 'pid' is reaped
+} Request;
+
+// A connection whose request is still arriving. Every connection is
+// non-blocking and read from the event loop, so a slow or silent client
+// holds up nobody else.
+typedef struct {
+    int conn;
+    time_t connected;
+    ServerRequest req;
+    bool have_header;   // 'req' and 'fds' have arrived
+    int fds[3];
+    char *payload;
+    size_t received;
+} Pending;
+
+static int listen_fd = -1;
+static Request *requests = NULL;
+static int request_count = 0, request_capacity = 0;
+static Pending pending[SERVER_MAX_PENDING];
+static int pending_count = 0;
+static int sweep_fd = -1;   // Periodic timer while requests are pending
+static sigset_t original_mask;
+
+static void on_connect(int fd, void *data);
+static void on_readable(int fd, void *data);
+static void on_sweep(int fd, void *data);
+static void drop_pending(int i);
+static void serve(int conn, int *fds, char *payload, size_t len);
+static void run_request(int conn, int *fds, char *cwd, char *line);
+static void reap_requests(void);
+static bool read_header(Pending *p);
+static time_t now(void);
+
+int server_main(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "server: %s: path too long\n", path);
+        return EXIT_FAILURE;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Only ever remove a socket, never a file that happens to be there
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 128) < 0) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    sweep_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sweep_fd < 0 || !events_add(listen_fd, on_connect, NULL) || !events_add(sweep_fd, on_sweep, NULL)) {
+        perror("server");
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+
+    // Child exits and the stop signals arrive through one descriptor, so the
+    // loop never races a signal between checking and sleeping
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGINT);
+    sigprocmask(SIG_BLOCK, &mask, &original_mask);
+    int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd < 0) { perror("signalfd"); unlink(path); return EXIT_FAILURE; }
+
+    bool stopping = false;
+    while (!stopping) {
+        if (events_wait_readable(signal_fd) < 0 && errno != EINTR) { perror("poll"); break; }
+        struct signalfd_siginfo info;
+        while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            if (info.ssi_signo != SIGCHLD) stopping = true;
+        }
+        reap_requests();
+    }
+
+    events_remove(listen_fd);
+    close(listen_fd);
+    unlink(path);
+    while (pending_count > 0) drop_pending(0);
+    events_remove(sweep_fd);
+    close(sweep_fd);
+    // Requests still running finish on their own; their clients get no status
+    for (int i = 0; i < request_count; i++) close(requests[i].conn);
+    free(requests);
+    return EXIT_SUCCESS;
+}
+
+static void on_connect(int fd, void *data) {
+    (void)data;
+    int conn;
+    while ((conn = accept(fd, NULL, NULL)) >= 0) {
+        fcntl(conn, F_SETFD, FD_CLOEXEC);
+        fcntl(conn, F_SETFL, O_NONBLOCK);
+        if (pending_count == SERVER_MAX_PENDING || !events_add(conn, on_readable, NULL)) {
+            close(conn);
+            continue;
+        }
+        pending[pending_count++] = (Pending){ conn, now(), { 0, 0 }, false, { -1, -1, -1 }, NULL, 0 };
+        if (pending_count == 1) {
+            struct itimerspec every = { { 1, 0 }, { 1, 0 } };
+            timerfd_settime(sweep_fd, 0, &every, NULL);
+        }
+    }
+}
+
+// Reads whatever part of the request has arrived. Once it is complete the
+// request is served; a malformed one just has its connection closed.
+static void on_readable(int fd, void *data) {
+    (void)data;
+    int i = 0;
+    while (i < pending_count && pending[i].conn != fd) i++;
+    if (i == pending_count) return;
+    Pending *p = &pending[i];
+
+    if (!p->have_header) {
+        if (!read_header(p)) {
+            if (errno != EAGAIN) drop_pending(i);
+            return;
+        }
+        p->payload = malloc(p->req.payload_len);
+        if (!p->payload) { perror("malloc"); drop_pending(i); return; }
+    }
+    while (p->received < p->req.payload_len) {
+        ssize_t n = recv(fd, p->payload + p->received, p->req.payload_len - p->received, MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        if (n <= 0) { drop_pending(i); return; }
+        p->received += n;
+    }
+
+    // Handed over whole: serve() owns the connection, descriptors and payload
+    int conn = p->conn, fds[3] = { p->fds[0], p->fds[1], p->fds[2] };
+    char *payload = p->payload;
+    events_remove(conn);
+    pending[i] = pending[--pending_count];
+    serve(conn, fds, payload, p->req.payload_len);
+}
+
+// Once a second while requests are pending: drops those that have taken
+// longer than SERVER_REQUEST_TIMEOUT
+static void on_sweep(int fd, void *data) {
+    (void)data;
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) < 0) return;
+    time_t cutoff = now() - SERVER_REQUEST_TIMEOUT;
+    for (int i = pending_count - 1; i >= 0; i--) {
+        if (pending[i].connected <= cutoff) drop_pending(i);
+    }
+    if (pending_count == 0) {
+        struct itimerspec off = { { 0, 0 }, { 0, 0 } };
+        timerfd_settime(fd, 0, &off, NULL);
+    }
+}
+
+static void drop_pending(int i) {
+    Pending *p = &pending[i];
+    events_remove(p->conn);
+    close(p->conn);
+    for (int j = 0; j < 3; j++) if (p->fds[j] >= 0) close(p->fds[j]);
+    free(p->payload);
+    pending[i] = pending[--pending_count];
+}
+
+// Forks the copy that runs a complete request
+static void serve(int conn, int *fds, char *payload, size_t len) {
+    if (payload[len - 1] != '\0') goto fail;
+    char *cwd = payload;
+    size_t cwd_len = strlen(cwd);
+    if (cwd_len + 1 >= len) goto fail;
+    char *line = cwd + cwd_len + 1;
+
+    if (request_count == request_capacity) {
+        int capacity = request_capacity ? request_capacity * 2 : 16;
+        Request *grown = realloc(requests, sizeof(Request) * capacity);
+        if (!grown) { perror("realloc"); goto fail; }
+        requests = grown;
+        request_capacity = capacity;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) run_request(conn, fds, cwd, line);
+    if (pid < 0) { perror("fork"); goto fail; }
+    requests[request_count++] = (Request){ pid, conn };
+    free(payload);
+    for (int i = 0; i < 3; i++) close(fds[i]);
+    return;
+
+fail:
+    free(payload);
+    for (int i = 0; i < 3; i++) close(fds[i]);
+    close(conn);
+}
+
+// In the forked copy: becomes a fresh non-interactive shell started in 'cwd'
+// on the client's descriptors, runs the line and exits with its status
+static void run_request(int conn, int *fds, char *cwd, char *line) {
+    close(conn);
+    events_remove(listen_fd);
+    close(listen_fd);
+    events_remove(sweep_fd);
+    close(sweep_fd);
+    for (int i = 0; i < request_count; i++) close(requests[i].conn);
+    while (pending_count > 0) drop_pending(0);
+    zygote_forget();
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    sigprocmask(SIG_SETMASK, &original_mask, NULL);
+
+    // A session of its own keeps the client's terminal, if it passed one,
+    // from ever being taken over by the server's jobs
+    setsid();
+    SHELL_PGID = getpgrp();
+
+    // Moved clear of 0-2 first, as the descriptors may be numbered 0-2
+    int high[3];
+    for (int i = 0; i < 3; i++) high[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, 10);
+    for (int i = 0; i < 3; i++) {
+        dup2(high[i], i);
+        close(high[i]);
+        close(fds[i]);
+    }
+
+    if (chdir(cwd) < 0) {
+        perror(cwd);
+        _exit(1);
+    }
+    // The client's directory plays the part of the startup directory
+    strncpy(SHELL_HOME, cwd, sizeof(SHELL_HOME) - 1);
+    strncpy(PREVIOUS_CWD, cwd, sizeof(PREVIOUS_CWD) - 1);
+
+    int status = execute_text(line);
+    fflush(stdout);
+    fflush(stderr);
+    jobs_kill_all();
+    _exit(status);
+}
+
+static void reap_requests(void) {
+    pid_t pid;
+    int status;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < request_count; i++) {
+            if (requests[i].pid != pid) continue;
+            int32_t code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            // A client that has gone away is no reason to stop
+            send(requests[i].conn, &code, sizeof(code), MSG_NOSIGNAL | MSG_DONTWAIT);
+            close(requests[i].conn);
+            requests[i] = requests[--request_count];
+            break;
+        }
+    }
+}
+
+// Receives the header together with exactly three descriptors, which the
+// client sends in one message. Returns false with errno EAGAIN if nothing
+// has arrived yet, or with errno EPROTO for a malformed header.
+static bool read_header(Pending *p) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * 3)];
+    } control;
+    struct iovec iov = { &p->req, sizeof(p->req) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    while ((n = recvmsg(p->conn, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR);
+    if (n < 0 && errno == EAGAIN) return false;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (n > 0 && cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        // CMSG_SPACE rounds up, so the buffer has room for a fourth
+        int passed[4];
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (count > 4) count = 4;
+        memcpy(passed, CMSG_DATA(cmsg), sizeof(int) * count);
+        for (size_t i = 0; i < count; i++) {
+            if (count == 3) p->fds[i] = passed[i];
+            else close(passed[i]);
+        }
+    }
+    p->have_header = n == (ssize_t)sizeof(p->req) && !(msg.msg_flags & MSG_CTRUNC)
+        && p->fds[0] >= 0 && p->fds[1] >= 0 && p->fds[2] >= 0
+        && p->req.magic == SERVER_MAGIC && p->req.payload_len > 0 && p->req.payload_len <= SERVER_MAX_PAYLOAD;
+    if (!p->have_header) errno = EPROTO;
+    return p->have_header;
+}
+
+static time_t now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "shell.h"
+#include "variables.h"
+
+#include <ctype.h>
+#include <stdint.h>
+
+extern char **environ;
+
+#define VARS_INITIAL_CAPACITY 256  // Power of two
+
+// Open-addressing table with linear probing. Deleted slots become
+// tombstones so probe chains stay intact; they are dropped on resize.
+typedef struct {
+    char *name;          // NULL for an empty slot
+    char *value;         // NULL while declared (e.g. `export X`) but unset
+    char *env_entry;     // "NAME=value" while present in envp
+    int env_index;       // Slot in envp, or -1
+    bool exported;
+    bool tombstone;
+} Variable;
+
+static Variable *table = NULL;
+static size_t capacity = 0;
+static size_t used = 0;         // Live entries plus tombstones
+
+static pid_t shell_pid;
+
+static char **envp = NULL;
+static size_t env_count = 0;
+static size_t env_capacity = 0;
+
+static uint32_t hash_name(const char *name, size_t len);
+static Variable* find_slot(const char *name, size_t len, bool for_insert);
+static void grow_table(void);
+static void env_put(Variable *v);
+static void env_remove(Variable *v);
+static int compare_env(const void *a, const void *b);
+
+void vars_init(void) {
+    capacity = VARS_INITIAL_CAPACITY;
+    table = calloc(capacity, sizeof(Variable));
+    envp = malloc(sizeof(char *) * 64);
+    if (!table || !envp) { perror("malloc"); exit(EXIT_FAILURE); }
+    env_capacity = 63;
+    envp[0] = NULL;
+    shell_pid = getpid();
+
+    for (char **e = environ; e && *e; e++) {
+        char *eq = strchr(*e, '=');
+        if (!eq || !var_name_valid(*e, eq - *e)) continue;
+        char *name = strndup(*e, eq - *e);
+        var_set(name, eq + 1, true);
+        free(name);
+    }
+    environ = envp;
+}
+
+const char* var_get(const char *name) {
+    return var_get_n(name, strlen(name));
+}
+
+const char* var_get_n(const char *name, size_t len) {
+    Variable *v = find_slot(name, len, false);
+    return v ? v->value : NULL;
+}
+
+int var_set(const char *name, const char *value, bool export) {
+    size_t len = strlen(name);
+    if (!var_name_valid(name, len)) return -1;
+
+    Variable *v = find_slot(name, len, false);
+    if (!v) {
+        if ((used + 1) * 10 > capacity * 7) grow_table();
+        v = find_slot(name, len, true);
+        if (!v->tombstone) used++;
+        v->name = strdup(name);
+        v->value = NULL;
+        v->env_entry = NULL;
+        v->env_index = -1;
+        v->exported = false;
+        v->tombstone = false;
+    }
+    char *new_value = strdup(value);
+    free(v->value);
+    v->value = new_value;
+    if (export) v->exported = true;
+    if (v->exported) env_put(v);
+    return 0;
+}
+
+int var_export(const char *name) {
+    size_t len = strlen(name);
+    if (!var_name_valid(name, len)) return -1;
+    Variable *v = find_slot(name, len, false);
+    if (!v) {
+        // Declared but unset: exported as soon as it gets a value
+        if (var_set(name, "", true) != 0) return -1;
+        v = find_slot(name, len, false);
+        env_remove(v);
+        free(v->value);
+        v->value = NULL;
+        return 0;
+    }
+    v->exported = true;
+    if (v->value) env_put(v);
+    return 0;
+}
+
+int var_unexport(const char *name) {
+    Variable *v = find_slot(name, strlen(name), false);
+    if (!v) return -1;
+    v->exported = false;
+    env_remove(v);
+    return 0;
+}
+
+int var_unset(const char *name) {
+    Variable *v = find_slot(name, strlen(name), false);
+    if (!v) return 0;
+    env_remove(v);
+    free(v->name);
+    free(v->value);
+    v->name = NULL;
+    v->value = NULL;
+    v->tombstone = true;
+    return 0;
+}
+
+char** vars_envp(void) {
+    return envp;
+}
+
+pid_t vars_shell_pid(void) {
+    return shell_pid;
+}
+
+bool var_name_valid(const char *name, size_t len) {
+    if (len == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_')) return false;
+    for (size_t i = 1; i < len; i++) {
+        if (!(isalnum((unsigned char)name[i]) || name[i] == '_')) return false;
+    }
+    return true;
+}
+
+// export [-n] [name[=value] ...]
+int do_export(char **args, int argc) {
+    bool unexport = false;
+    int i = 1;
+    if (i < argc && strcmp(args[i], "-n") == 0) { unexport = true; i++; }
+
+    if (i == argc) {
+        // Sorted so the listing is stable regardless of hash order
+        char **sorted = malloc(sizeof(char *) * (env_count + 1));
+        memcpy(sorted, envp, sizeof(char *) * env_count);
+        qsort(sorted, env_count, sizeof(char *), compare_env);
+        for (size_t j = 0; j < env_count; j++) printf("export %s\n", sorted[j]);
+        free(sorted);
+        return 0;
+    }
+
+    int status = 0;
+    for (; i < argc; i++) {
+        char *eq = strchr(args[i], '=');
+        int rc;
+        if (unexport) {
+            rc = var_name_valid(args[i], strlen(args[i])) ? 0 : -1;
+            if (rc == 0) var_unexport(args[i]);
+        } else if (eq) {
+            char *name = strndup(args[i], eq - args[i]);
+            rc = var_set(name, eq + 1, true);
+            free(name);
+        } else {
+            rc = var_export(args[i]);
+        }
+        if (rc != 0) {
+            fprintf(stderr, "export: %s: not a valid identifier\n", args[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+// unset name ...
+int do_unset(char **args, int argc) {
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!var_name_valid(args[i], strlen(args[i]))) {
+            fprintf(stderr, "unset: %s: not a valid identifier\n", args[i]);
+            status = 1;
+            continue;
+        }
+        var_unset(args[i]);
+    }
+    return status;
+}
+
+// FNV-1a
+static uint32_t hash_name(const char *name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Looks 'name' up. With 'for_insert', returns the first reusable slot
+// (tombstone or empty) instead of NULL when the name is absent.
+static Variable* find_slot(const char *name, size_t len, bool for_insert) {
+    size_t mask = capacity - 1;
+    size_t i = hash_name(name, len) & mask;
+    Variable *reusable = NULL;
+    for (size_t probes = 0; probes < capacity; probes++, i = (i + 1) & mask) {
+        Variable *v = &table[i];
+        if (v->tombstone) {
+            if (!reusable) reusable = v;
+            continue;
+        }
+        if (!v->name) return for_insert ? (reusable ? reusable : v) : NULL;
+        if (strncmp(v->name, name, len) == 0 && v->name[len] == '\0') return for_insert ? NULL : v;
+    }
+    return for_insert ? reusable : NULL;
+}
+
+static void grow_table(void) {
+    Variable *old = table;
+    size_t old_capacity = capacity;
+    capacity *= 2;
+    table = calloc(capacity, sizeof(Variable));
+    if (!table) { perror("calloc"); exit(EXIT_FAILURE); }
+    used = 0;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!old[i].name) continue;
+        // env_index is a position in envp, not in the table, so it survives
+        *find_slot(old[i].name, strlen(old[i].name), true) = old[i];
+        used++;
+    }
+    free(old);
+}
+
+// Adds or refreshes the envp entry of an exported variable. Only this
+// variable's slot changes; the rest of the array is untouched.
+static void env_put(Variable *v) {
+    size_t name_len = strlen(v->name), value_len = strlen(v->value);
+    char *entry = malloc(name_len + value_len + 2);
+    if (!entry) { perror("malloc"); exit(EXIT_FAILURE); }
+    memcpy(entry, v->name, name_len);
+    entry[name_len] = '=';
+    memcpy(entry + name_len + 1, v->value, value_len + 1);
+
+    if (v->env_index < 0) {
+        if (env_count == env_capacity) {
+            env_capacity *= 2;
+            envp = realloc(envp, sizeof(char *) * (env_capacity + 1));
+            if (!envp) { perror("realloc"); exit(EXIT_FAILURE); }
+            environ = envp;
+        }
+        v->env_index = (int)env_count++;
+        envp[env_count] = NULL;
+    }
+    envp[v->env_index] = entry;
+    free(v->env_entry);
+    v->env_entry = entry;
+}
+
+// Removes a variable from envp by moving the last entry into its slot
+static void env_remove(Variable *v) {
+    if (v->env_index < 0) return;
+    size_t last = env_count - 1;
+    if ((size_t)v->env_index != last) {
+        char *moved = envp[last];
+        Variable *owner = find_slot(moved, strchr(moved, '=') - moved, false);
+        envp[v->env_index] = moved;
+        owner->env_index = v->env_index;
+    }
+    envp[last] = NULL;
+    env_count--;
+    free(v->env_entry);
+    v->env_entry = NULL;
+    v->env_index = -1;
+}
+
+static int compare_env(const void *a, const void *b) {
+    return strcmp(*(const char **)a, *(const char **)b);
+}
\ No newline at end of file
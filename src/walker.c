@@ -0,0 +1,415 @@
+// DT_* constants for d_type are not part of the POSIX feature set
+#define _DEFAULT_SOURCE
+
+#include "shell.h"
+#include "walker.h"
+
+#include <pthread.h>
+
+#define MAX_WALK_THREADS 256
+
+// One directory in the tree. Nodes are created by the worker that reads the
+// parent and filled in by whichever worker ends up processing them.
+typedef struct WalkNode {
+    char *name;                  // Name relative to the parent directory
+    char *path;                  // Display path, also used in error messages
+    struct WalkNode *parent;
+    DIR *dir;                    // Kept open while children still need openat()
+    int unopened_children;       // Children that have not called openat() yet
+    int error;                   // errno from opening the directory, 0 if ok
+    DirEntry *entries;
+    int entry_count;
+    struct WalkNode **children;
+    int child_count;
+} WalkNode;
+
+// A per-worker deque. The owner pushes and pops at the tail (LIFO keeps the
+// walk depth-first and the number of open directories low); idle workers
+// steal from the head, which holds the oldest and usually largest subtrees.
+typedef struct {
+    pthread_mutex_t lock;
+    WalkNode **items;
+    size_t head, tail, cap;
+} WorkDeque;
+
+typedef struct {
+    const WalkOptions *opts;
+    WorkDeque *deques;
+    int nworkers;
+    long outstanding;            // Nodes queued or in progress
+    long queued;                 // Nodes sitting in a deque, may dip below 0 briefly
+    int idle;                    // Workers blocked on work_ready
+    bool failed;                 // An allocation failed; nothing is printed
+    pthread_mutex_t idle_lock;
+    pthread_cond_t work_ready;   // Signalled when nodes are queued or the walk ends
+} WalkContext;
+
+typedef struct {
+    WalkContext *ctx;
+    int id;
+    StatRing *ring;              // Per-worker, only opened when metadata is needed
+} WorkerArg;
+
+static bool deque_push(WorkDeque *dq, WalkNode *node);
+static WalkNode* deque_pop(WorkDeque *dq);
+static WalkNode* deque_steal(WorkDeque *dq);
+static void* worker_main(void *arg);
+static void process_node(WalkContext *ctx, WorkerArg *worker, WalkNode *node);
+static bool read_node(WalkContext *ctx, WalkNode *node, DIR *d);
+static void queue_children(WalkContext *ctx, WorkerArg *worker, WalkNode *node);
+static void wait_for_work(WalkContext *ctx);
+static void wake_workers(WalkContext *ctx);
+static void finish_node(WalkContext *ctx);
+static void order_children(WalkNode *node);
+static void release_parent(WalkNode *parent);
+static WalkNode* new_node(WalkNode *parent, const char *name, const char *path);
+static void print_tree(const WalkNode *root, const WalkOptions *opts, bool *first);
+static void free_tree(WalkNode *node);
+static int compare_nodes(const void *a, const void *b);
+static int compare_name_to_node(const void *key, const void *elem);
+
+int walk_tree(const char *root, const char *label, const WalkOptions *opts) {
+    int nworkers = opts->threads;
+    if (nworkers <= 0) nworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nworkers <= 0) nworkers = 1;
+    if (nworkers > MAX_WALK_THREADS) nworkers = MAX_WALK_THREADS;
+
+    WalkNode *root_node = new_node(NULL, root, label);
+    if (!root_node) return -1;
+
+    WalkContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.opts = opts;
+    ctx.deques = calloc(nworkers, sizeof(WorkDeque));
+    ctx.nworkers = nworkers;
+    ctx.outstanding = 1;
+    ctx.queued = 1;
+    if (!ctx.deques) { perror("calloc"); free_tree(root_node); return -1; }
+    for (int i = 0; i < nworkers; i++) pthread_mutex_init(&ctx.deques[i].lock, NULL);
+    pthread_mutex_init(&ctx.idle_lock, NULL);
+    pthread_cond_init(&ctx.work_ready, NULL);
+    if (!deque_push(&ctx.deques[0], root_node)) {
+        ctx.outstanding = 0;
+        ctx.failed = true;
+    }
+
+    // The calling thread acts as worker 0 so a single-threaded walk spawns nothing
+    pthread_t threads[MAX_WALK_THREADS];
+    WorkerArg args[MAX_WALK_THREADS];
+    int started = 1;
+    for (int i = 1; i < nworkers; i++) {
+        args[i].ctx = &ctx;
+        args[i].id = i;
+        if (pthread_create(&threads[i], NULL, worker_main, &args[i]) != 0) break;
+        started++;
+    }
+    args[0].ctx = &ctx;
+    args[0].id = 0;
+    worker_main(&args[0]);
+    for (int i = 1; i < started; i++) pthread_join(threads[i], NULL);
+
+    for (int i = 0; i < nworkers; i++) {
+        pthread_mutex_destroy(&ctx.deques[i].lock);
+        free(ctx.deques[i].items);
+    }
+    free(ctx.deques);
+    pthread_mutex_destroy(&ctx.idle_lock);
+    pthread_cond_destroy(&ctx.work_ready);
+
+    int result = 0;
+    if (ctx.failed) {
+        result = -1;
+    } else if (root_node->error) {
+        fprintf(stderr, "No such directory!\n");
+        result = -1;
+    } else {
+        bool first = true;
+        print_tree(root_node, opts, &first);
+    }
+    free_tree(root_node);
+    return result;
+}
+
+static void* worker_main(void *arg) {
+    WorkerArg *wa = arg;
+    WalkContext *ctx = wa->ctx;
+    unsigned int victim = (unsigned int)wa->id;
+    bool need_meta = ctx->opts->long_format || ctx->opts->sort_key != SORT_NAME;
+    wa->ring = need_meta ? stat_ring_open() : NULL;
+
+    while (__atomic_load_n(&ctx->outstanding, __ATOMIC_ACQUIRE) > 0) {
+        WalkNode *node = deque_pop(&ctx->deques[wa->id]);
+        for (int tries = 1; !node && tries < ctx->nworkers; tries++) {
+            victim = (victim + 1) % ctx->nworkers;
+            if ((int)victim != wa->id) node = deque_steal(&ctx->deques[victim]);
+        }
+        if (node) {
+            __atomic_sub_fetch(&ctx->queued, 1, __ATOMIC_SEQ_CST);
+            process_node(ctx, wa, node);
+        } else {
+            wait_for_work(ctx);
+        }
+    }
+    stat_ring_close(wa->ring);
+    return NULL;
+}
+
+// Opens, reads and sorts one directory, then queues its subdirectories
+static void process_node(WalkContext *ctx, WorkerArg *worker, WalkNode *node) {
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    int fd;
+    if (node->parent) {
+        fd = openat(dirfd(node->parent->dir), node->name, flags | O_NOFOLLOW);
+        release_parent(node->parent);
+    } else {
+        fd = open(node->name, flags);
+    }
+
+    DIR *d = (fd >= 0) ? fdopendir(fd) : NULL;
+    if (!d) {
+        node->error = errno;
+        if (fd >= 0) close(fd);
+        if (node->parent) fprintf(stderr, "reveal: cannot open %s: %s\n", node->path, strerror(node->error));
+        finish_node(ctx);
+        return;
+    }
+
+    if (!read_node(ctx, node, d)) {
+        // The listing is incomplete: drop the node, and the whole output
+        node->error = ENOMEM;
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+        closedir(d);
+        finish_node(ctx);
+        return;
+    }
+
+    if (ctx->opts->long_format || ctx->opts->sort_key != SORT_NAME) {
+        stat_entries(worker->ring, dirfd(d), node->entries, node->entry_count);
+    }
+    sort_entries(node->entries, node->entry_count, ctx->opts->sort_key);
+    qsort(node->children, node->child_count, sizeof(WalkNode *), compare_nodes);
+    if (ctx->opts->sort_key != SORT_NAME) order_children(node);
+
+    if (node->child_count == 0) {
+        closedir(d);
+    } else {
+        // Children open themselves relative to this handle; the last one to
+        // do so closes it (see release_parent)
+        node->dir = d;
+        queue_children(ctx, worker, node);
+    }
+    finish_node(ctx);
+}
+
+// Reads the entries of 'd' into 'node' and creates a child node for each
+// subdirectory. Returns false, having reported it, if memory ran out.
+static bool read_node(WalkContext *ctx, WalkNode *node, DIR *d) {
+    int entry_cap = 64, child_cap = 8;
+    node->entries = malloc(entry_cap * sizeof(DirEntry));
+    node->children = malloc(child_cap * sizeof(WalkNode *));
+    if (!node->entries || !node->children) { perror("malloc"); return false; }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        const char *name = ent->d_name;
+        if (!ctx->opts->show_all && name[0] == '.') continue;
+        if (node->entry_count == entry_cap) {
+            DirEntry *grown = realloc(node->entries, entry_cap * 2 * sizeof(DirEntry));
+            if (!grown) { perror("realloc"); return false; }
+            node->entries = grown;
+            entry_cap *= 2;
+        }
+        DirEntry *entry = &node->entries[node->entry_count];
+        memset(entry, 0, sizeof(*entry));
+        entry->name = strdup(name);
+        if (!entry->name) { perror("strdup"); return false; }
+        node->entry_count++;
+
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        bool is_dir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_dir = fstatat(dirfd(d), name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+        }
+        if (!is_dir) continue;
+
+        if (node->child_count == child_cap) {
+            WalkNode **grown = realloc(node->children, child_cap * 2 * sizeof(WalkNode *));
+            if (!grown) { perror("realloc"); return false; }
+            node->children = grown;
+            child_cap *= 2;
+        }
+        size_t path_len = strlen(node->path) + strlen(name) + 2;
+        char *path = malloc(path_len);
+        if (!path) { perror("malloc"); return false; }
+        snprintf(path, path_len, "%s/%s", node->path, name);
+        WalkNode *child = new_node(node, name, path);
+        free(path);
+        if (!child) return false;
+        node->children[node->child_count++] = child;
+    }
+    return true;
+}
+
+// Pushes the children onto this worker's deque, last first so that the
+// first one is popped next. A child that cannot be queued is dropped and
+// fails the walk.
+static void queue_children(WalkContext *ctx, WorkerArg *worker, WalkNode *node) {
+    node->unopened_children = node->child_count;
+    __atomic_add_fetch(&ctx->outstanding, node->child_count, __ATOMIC_RELEASE);
+    int queued = 0;
+    for (int i = node->child_count - 1; i >= 0; i--) {
+        if (deque_push(&ctx->deques[worker->id], node->children[i])) {
+            queued++;
+            continue;
+        }
+        node->children[i]->error = ENOMEM;
+        __atomic_store_n(&ctx->failed, true, __ATOMIC_RELAXED);
+        release_parent(node);
+        finish_node(ctx);
+    }
+    __atomic_add_fetch(&ctx->queued, queued, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ctx->idle, __ATOMIC_SEQ_CST) > 0) wake_workers(ctx);
+}
+
+// Blocks until some deque has work or the walk is over. A waiter registers
+// in 'idle' before testing 'queued', and a pusher bumps 'queued' before
+// testing 'idle', so at least one of them sees the other.
+static void wait_for_work(WalkContext *ctx) {
+    pthread_mutex_lock(&ctx->idle_lock);
+    __atomic_add_fetch(&ctx->idle, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&ctx->queued, __ATOMIC_SEQ_CST) <= 0 &&
+           __atomic_load_n(&ctx->outstanding, __ATOMIC_ACQUIRE) > 0) {
+        pthread_cond_wait(&ctx->work_ready, &ctx->idle_lock);
+    }
+    __atomic_sub_fetch(&ctx->idle, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ctx->idle_lock);
+}
+
+static void wake_workers(WalkContext *ctx) {
+    pthread_mutex_lock(&ctx->idle_lock);
+    pthread_cond_broadcast(&ctx->work_ready);
+    pthread_mutex_unlock(&ctx->idle_lock);
+}
+
+static void finish_node(WalkContext *ctx) {
+    if (__atomic_sub_fetch(&ctx->outstanding, 1, __ATOMIC_ACQ_REL) == 0) wake_workers(ctx);
+}
+
+// Puts the children in the same order as the already sorted entries, so -S
+// and -t apply at every level and not just to the listing of each directory.
+// Expects the children sorted by name, which is what the lookup relies on.
+static void order_children(WalkNode *node) {
+    if (node->child_count < 2) return;
+    WalkNode **ordered = malloc(node->child_count * sizeof(WalkNode *));
+    if (!ordered) { perror("malloc"); return; }
+    int n = 0;
+    for (int i = 0; i < node->entry_count && n < node->child_count; i++) {
+        WalkNode **child = bsearch(node->entries[i].name, node->children, node->child_count,
+                                   sizeof(WalkNode *), compare_name_to_node);
+        if (child) ordered[n++] = *child;
+    }
+    if (n == node->child_count) {
+        free(node->children);
+        node->children = ordered;
+    } else {
+        free(ordered);
+    }
+}
+
+static void release_parent(WalkNode *parent) {
+    if (__atomic_sub_fetch(&parent->unopened_children, 1, __ATOMIC_ACQ_REL) == 0) {
+        closedir(parent->dir);
+        parent->dir = NULL;
+    }
+}
+
+static WalkNode* new_node(WalkNode *parent, const char *name, const char *path) {
+    WalkNode *node = calloc(1, sizeof(WalkNode));
+    if (!node) { perror("calloc"); return NULL; }
+    node->name = strdup(name);
+    node->path = strdup(path);
+    if (!node->name || !node->path) {
+        perror("strdup");
+        free(node->name);
+        free(node->path);
+        free(node);
+        return NULL;
+    }
+    node->parent = parent;
+    return node;
+}
+
+// Output mirrors `ls -R`: a "path:" header, the sorted entries, and a blank
+// line between directories. Subdirectories follow their parent in the order
+// they were listed.
+static void print_tree(const WalkNode *node, const WalkOptions *opts, bool *first) {
+    if (node->error) return;
+    if (!*first) printf("\n");
+    *first = false;
+
+    printf("%s:\n", node->path);
+    print_entries(node->entries, node->entry_count, opts->line_by_line, opts->long_format);
+
+    for (int i = 0; i < node->child_count; i++) print_tree(node->children[i], opts, first);
+}
+
+static void free_tree(WalkNode *node) {
+    for (int i = 0; i < node->child_count; i++) free_tree(node->children[i]);
+    for (int i = 0; i < node->entry_count; i++) free(node->entries[i].name);
+    if (node->dir) closedir(node->dir);
+    free(node->entries);
+    free(node->children);
+    free(node->name);
+    free(node->path);
+    free(node);
+}
+
+static bool deque_push(WorkDeque *dq, WalkNode *node) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail == dq->cap) {
+        // Compact before growing so a long-lived deque does not creep forward
+        size_t live = dq->tail - dq->head;
+        if (dq->head > 0) memmove(dq->items, dq->items + dq->head, live * sizeof(WalkNode *));
+        dq->head = 0;
+        dq->tail = live;
+        if (dq->tail == dq->cap) {
+            size_t cap = dq->cap ? dq->cap * 2 : 64;
+            WalkNode **items = realloc(dq->items, cap * sizeof(WalkNode *));
+            if (!items) {
+                perror("realloc");
+                pthread_mutex_unlock(&dq->lock);
+                return false;
+            }
+            dq->items = items;
+            dq->cap = cap;
+        }
+    }
+    dq->items[dq->tail++] = node;
+    pthread_mutex_unlock(&dq->lock);
+    return true;
+}
+
+static WalkNode* deque_pop(WorkDeque *dq) {
+    WalkNode *node = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail > dq->head) node = dq->items[--dq->tail];
+    pthread_mutex_unlock(&dq->lock);
+    return node;
+}
+
+static WalkNode* deque_steal(WorkDeque *dq) {
+    WalkNode *node = NULL;
+    // Thieves never wait on a busy deque; they just move on to the next victim
+    if (pthread_mutex_trylock(&dq->lock) != 0) return NULL;
+    if (dq->tail > dq->head) node = dq->items[dq->head++];
+    pthread_mutex_unlock(&dq->lock);
+    return node;
+}
+
+static int compare_nodes(const void *a, const void *b) {
+    return strcmp((*(const WalkNode **)a)->name, (*(const WalkNode **)b)->name);
+}
+
+static int compare_name_to_node(const void *key, const void *elem) {
+    return strcmp((const char *)key, (*(const WalkNode **)elem)->name);
+}
\ No newline at end of file
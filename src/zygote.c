@@ -0,0 +1,326 @@
+// CMSG_SPACE/CMSG_LEN need the default feature set
+#define _DEFAULT_SOURCE
+
+#include "shell.h"
+#include "zygote.h"
+#include "variables.h"
+
+#include <stdint.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/close_range.h>
+
+#define ZYGOTE_MAX_PASSED 32     // Descriptors per request (SCM_RIGHTS limit is 253)
+
+typedef struct {
+    int32_t pgid;
+    int32_t fd_count;
+    int32_t fd_numbers[ZYGOTE_MAX_PASSED];  // Where each passed descriptor goes
+    uint32_t argc, envc;
+    uint32_t payload_len;                   // cwd, argv and envp, NUL-separated
+} SpawnRequest;
+
+typedef struct {
+    int32_t pid;
+    int32_t error;
+} SpawnReply;
+
+static int zygote_sock = -1;
+static pid_t zygote_pid = -1;
+
+// Sockets only: a vanished peer is an error, not a SIGPIPE
+static bool write_all(int fd, const void *buf, size_t len);
+static bool read_all(int fd, void *buf, size_t len);
+static void zygote_stop(void);
+static void spawn_request(int sock, SpawnRequest *req, char *payload, int *fds);
+static void keep_only(const int32_t *fds, int count);
+
+bool zygote_start(void) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) { perror("socketpair"); return false; }
+
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); close(sv[0]); close(sv[1]); return false; }
+    if (pid == 0) {
+        close(sv[0]);
+        char fd_arg[16];
+        snprintf(fd_arg, sizeof(fd_arg), "%d", sv[1]);
+        execl("/proc/self/exe", "shell-fork-server", ZYGOTE_HELPER_FLAG, fd_arg, (char *)NULL);
+        _exit(127);
+    }
+    close(sv[1]);
+
+    // Kept out of the low descriptors users redirect, and out of children
+    zygote_sock = fcntl(sv[0], F_DUPFD_CLOEXEC, 10);
+    close(sv[0]);
+    zygote_pid = pid;
+    if (zygote_sock < 0) { zygote_stop(); return false; }
+
+    // Orphaned grandchildren of the helper are reparented to the shell
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1) < 0) { perror("prctl"); zygote_stop(); return false; }
+    return true;
+}
+
+bool zygote_active(void) {
+    return zygote_sock >= 0;
+}
+
+void zygote_subreaper(bool on) {
+    if (zygote_sock >= 0) prctl(PR_SET_CHILD_SUBREAPER, on ? 1 : 0);
+}
+
+bool zygote_vacate(int fd) {
+    if (zygote_sock < 0 || fd != zygote_sock) return true;
+    int moved = fcntl(zygote_sock, F_DUPFD_CLOEXEC, 10);
+    if (moved < 0) return false;
+    close(zygote_sock);
+    zygote_sock = moved;
+    return true;
+}
+
+void zygote_forget(void) {
+    if (zygote_sock >= 0) close(zygote_sock);
+    zygote_sock = -1;
+    zygote_pid = -1;
+}
+
+pid_t zygote_spawn(char **argv, pid_t pgid, int *exec_error) {
+    SpawnRequest req;
+    memset(&req, 0, sizeof(req));
+    req.pgid = pgid;
+    *exec_error = 0;
+
+    int fds[ZYGOTE_MAX_PASSED];
+    for (int fd = 0; fd < ZYGOTE_MAX_FD; fd++) {
+        int flags = fcntl(fd, F_GETFD);
+        if (flags < 0 || (flags & FD_CLOEXEC)) continue;
+        // Dropping the rest would start the command without them
+        if (req.fd_count == ZYGOTE_MAX_PASSED) return -1;
+        req.fd_numbers[req.fd_count] = fd;
+        fds[req.fd_count++] = fd;
+    }
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) strcpy(cwd, "/");
+    char **envp = vars_envp();
+
+    // Payload: cwd, argv..., envp..., each NUL-terminated
+    size_t len = strlen(cwd) + 1;
+    for (char **a = argv; *a; a++) { len += strlen(*a) + 1; req.argc++; }
+    for (char **e = envp; *e; e++) { len += strlen(*e) + 1; req.envc++; }
+    char *payload = malloc(len);
+    if (!payload) { perror("malloc"); return -1; }
+    char *out = payload;
+    out = stpcpy(out, cwd) + 1;
+    for (char **a = argv; *a; a++) out = stpcpy(out, *a) + 1;
+    for (char **e = envp; *e; e++) out = stpcpy(out, *e) + 1;
+    req.payload_len = len;
+
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_PASSED)];
+    } control;
+    struct iovec iov = { &req, sizeof(req) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (req.fd_count > 0) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * req.fd_count);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * req.fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * req.fd_count);
+    }
+
+    SpawnReply reply;
+    ssize_t sent;
+    while ((sent = sendmsg(zygote_sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+    bool ok = sent == (ssize_t)sizeof(req) && write_all(zygote_sock, payload, len) && read_all(zygote_sock, &reply, sizeof(reply));
+    free(payload);
+    if (!ok || reply.pid <= 0) {
+        fprintf(stderr, "fork server: %s, falling back to fork\n", ok ? strerror(reply.error) : "connection lost");
+        zygote_stop();
+        return -1;
+    }
+
+    // The child put itself in the group already; this only closes the race
+    // for a caller that signals the group straight away
+    setpgid(reply.pid, pgid ? pgid : reply.pid);
+    *exec_error = reply.error;
+    return reply.pid;
+}
+
+static void zygote_stop(void) {
+    if (zygote_sock >= 0) close(zygote_sock);
+    zygote_sock = -1;
+    if (zygote_pid > 0) {
+        kill(zygote_pid, SIGKILL);
+        waitpid(zygote_pid, NULL, 0);
+    }
+    zygote_pid = -1;
+}
+
+// --- Helper process ---
+
+int zygote_main(int sock) {
+    // Die with the shell, and stay out of the terminal's signals
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    setpgid(0, 0);
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+    for (;;) {
+        SpawnRequest req;
+        union {
+            struct cmsghdr align;
+            char buf[CMSG_SPACE(sizeof(int) * ZYGOTE_MAX_PASSED)];
+        } control;
+        struct iovec iov = { &req, sizeof(req) };
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t n;
+        while ((n = recvmsg(sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR);
+        if (n != (ssize_t)sizeof(req)) return 0;    // The shell went away
+
+        int fds[ZYGOTE_MAX_PASSED];
+        int fd_count = 0;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * fd_count);
+        }
+        if (fd_count != req.fd_count || req.payload_len == 0) return 1;
+
+        char *payload = malloc(req.payload_len);
+        if (!payload || !read_all(sock, payload, req.payload_len)) return 1;
+        spawn_request(sock, &req, payload, fds);
+        free(payload);
+        for (int i = 0; i < fd_count; i++) close(fds[i]);
+    }
+}
+
+// Double-forks the command described by 'req'. The middle process exits at
+// once, so the command is reparented to the shell (the subreaper). Both
+// report through a close-on-exec socket pair: the middle process sends the pid,
+// the command sends errno if exec fails. EOF means the exec happened.
+static void spawn_request(int sock, SpawnRequest *req, char *payload, int *fds) {
+    char *cwd = payload;
+    char **argv = malloc(sizeof(char *) * (req->argc + 1));
+    char **envp = malloc(sizeof(char *) * (req->envc + 1));
+    SpawnReply reply = { 0, 0 };
+    int status_sock[2] = { -1, -1 };
+    if (!argv || !envp || socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, status_sock) < 0) {
+        reply.error = errno;
+        goto done;
+    }
+
+    char *p = payload + strlen(payload) + 1;
+    for (uint32_t i = 0; i < req->argc; i++) { argv[i] = p; p += strlen(p) + 1; }
+    for (uint32_t i = 0; i < req->envc; i++) { envp[i] = p; p += strlen(p) + 1; }
+    argv[req->argc] = NULL;
+    envp[req->envc] = NULL;
+
+    pid_t middle = fork();
+    if (middle == 0) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // The helper inherited the shell's ignored SIGTTIN/SIGTTOU too
+            signal(SIGINT, SIG_DFL); signal(SIGTSTP, SIG_DFL);
+            signal(SIGTTIN, SIG_DFL); signal(SIGTTOU, SIG_DFL);
+            signal(SIGQUIT, SIG_DFL);
+            prctl(PR_SET_PDEATHSIG, 0);
+            setpgid(0, req->pgid);
+
+            // Move the received descriptors clear of their targets first
+            int high[ZYGOTE_MAX_PASSED];
+            for (int i = 0; i < req->fd_count; i++) high[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, ZYGOTE_MAX_FD);
+            for (int fd = 0; fd <= STDERR_FILENO; fd++) close(fd);
+            for (int i = 0; i < req->fd_count; i++) dup2(high[i], req->fd_numbers[i]);
+            keep_only(req->fd_numbers, req->fd_count);
+
+            int error = 0;
+            if (chdir(cwd) < 0) error = errno;
+            extern char **environ;
+            environ = envp;
+            if (!error) execvp(argv[0], argv);
+            SpawnReply failure = { 0, error ? error : errno };
+            write_all(status_sock[1], &failure, sizeof(failure));
+            _exit(127);
+        }
+        SpawnReply started = { pid, pid < 0 ? errno : 0 };
+        write_all(status_sock[1], &started, sizeof(started));
+        _exit(0);
+    }
+    close(status_sock[1]);
+    if (middle < 0) {
+        reply.error = errno;
+    } else {
+        waitpid(middle, NULL, 0);
+        SpawnReply record;
+        while (read_all(status_sock[0], &record, sizeof(record))) {
+            if (record.pid) reply.pid = record.pid;
+            if (record.error) reply.error = record.error;
+        }
+    }
+    close(status_sock[0]);
+
+done:
+    free(argv);
+    free(envp);
+    write_all(sock, &reply, sizeof(reply));
+}
+
+// Marks every descriptor from 3 up close-on-exec except 'fds', so the
+// command gets the passed set and nothing the helper inherited itself. They
+// are not closed outright: the status socket must survive a failed exec.
+static void keep_only(const int32_t *fds, int count) {
+    bool passed[ZYGOTE_MAX_FD] = { false };
+    for (int i = 0; i < count; i++) passed[fds[i]] = true;
+    unsigned first = STDERR_FILENO + 1;
+    for (unsigned fd = first; fd <= ZYGOTE_MAX_FD; fd++) {
+        if (fd < ZYGOTE_MAX_FD && !passed[fd]) continue;
+        // The gap below a passed descriptor, and finally everything above
+        unsigned last = fd == ZYGOTE_MAX_FD ? ~0U : fd - 1;
+        if (first <= last && syscall(SYS_close_range, first, last, CLOSE_RANGE_CLOEXEC) < 0) {
+            long max = sysconf(_SC_OPEN_MAX);
+            for (long f = first; f <= (long)last && f < max; f++) fcntl((int)f, F_SETFD, FD_CLOEXEC);
+        }
+        first = fd + 1;
+    }
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
\ No newline at end of file
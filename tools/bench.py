@@ -0,0 +1,508 @@
+#!/usr/bin/env python3
+# Benchmarks for the shell's fast paths. Each one times shell.out against
+# the slower way of doing the same thing and prints a small table.
+#
+#     tools/bench.py [--shell path] [--baseline path] [--dir path] [--quick] [bench ...]
+#
+# --baseline is an older shell.out for before/after comparisons, --dir keeps
+# generated trees between runs, and --quick shrinks every size by 100x.
+# Cold-cache rows need write access to /proc/sys/vm/drop_caches.
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+
+def run(cmd, stdin=None, env=None):
+    """Seconds taken by one run of 'cmd', output discarded."""
+    start = time.perf_counter()
+    subprocess.run(cmd, stdin=stdin, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL,
+                   env=env, check=False)
+    return time.perf_counter() - start
+
+
+def best_of(n, fn):
+    return min(fn() for _ in range(n))
+
+
+def drop_caches():
+    try:
+        os.sync()
+        with open('/proc/sys/vm/drop_caches', 'w') as f:
+            f.write('3\n')
+        return True
+    except OSError:
+        return False
+
+
+def best_cold(n, fn):
+    """Best of 'n' runs each after dropping the page cache; None without root."""
+    times = []
+    for _ in range(n):
+        if not drop_caches():
+            return None
+        times.append(fn())
+    return min(times)
+
+
+def with_env(**changes):
+    env = dict(os.environ)
+    env.update({k: str(v) for k, v in changes.items()})
+    return env
+
+
+def table(header, rows):
+    widths = [max(len(str(r[i])) for r in [header] + rows) for i in range(len(header))]
+    for r in [header] + rows:
+        print('  '.join(str(c).rjust(w) for c, w in zip(r, widths)))
+    print()
+
+
+def make_tree(path, files, per_dir=1000):
+    """'files' empty files, 'per_dir' to a directory, nested by decimal digits."""
+    marker = os.path.join(path, '.bench-%d' % files)
+    if os.path.exists(marker):
+        return
+    shutil.rmtree(path, ignore_errors=True)
+    dirs = max(1, files // per_dir)
+    made = 0
+    for d in range(dirs):
+        # d = 123 becomes 1/2/3, so the tree is several levels deep
+        parts = list(str(d).zfill(len(str(max(dirs - 1, 1)))))
+        sub = os.path.join(path, *parts)
+        os.makedirs(sub, exist_ok=True)
+        for f in range(min(per_dir, files - made)):
+            open(os.path.join(sub, 'f%d' % f), 'w').close()
+        made += min(per_dir, files - made)
+    open(marker, 'w').close()
+
+
+def write_script(args, name, lines):
+    path = os.path.join(args.dir, name)
+    with open(path, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+    return path
+
+
+def run_script(shell, path, args, env=None):
+    """Feeds the script to the shell on stdin, the way scripts are run today."""
+    # Every line is added to $HOME/.cshell_log; keep that out of the real one
+    env = dict(env or os.environ, HOME=args.dir)
+    with open(path) as f:
+        return run([shell], stdin=f, env=env)
+
+
+def script_rows(args, path, lines, repeat=3):
+    """Times a script on shell.out, the baseline if given, and bash."""
+    rows = []
+    shells = [('shell.out', args.shell)]
+    if args.baseline:
+        shells.append(('baseline', args.baseline))
+    for name, shell in shells:
+        t = best_of(repeat if name == 'shell.out' else 1, lambda: run_script(shell, path, args))
+        rows.append([name, '%.3f' % t, '%.1f' % (t / lines * 1e6)])
+    t = best_of(repeat, lambda: run(['bash', path]))
+    rows.append(['bash', '%.3f' % t, '%.1f' % (t / lines * 1e6)])
+    return rows
+
+
+def run_text(shell, text, args, extra=()):
+    """Runs multi-line 'text' with -c, which skips the prompt and history.
+    Keep it under 128 KB, the kernel's limit for a single argument."""
+    return run([shell] + list(extra) + ['-c', text], env=dict(os.environ, HOME=args.dir))
+
+
+# --- Benchmarks ---
+
+def bench_walk(args):
+    """reveal -R on a tree of 1M files, 1 to N worker threads"""
+    files = args.scale(1000000)
+    tree = os.path.join(args.dir, 'walk')
+    make_tree(tree, files)
+    cores = os.cpu_count() or 1
+    counts = sorted({1, 2, 4, 8, 16, 32, 64, cores})
+    counts = [n for n in counts if n <= max(cores, 4)]
+
+    def reveal(threads):
+        return run([args.shell, '-c', 'reveal -R ' + tree], env=with_env(REVEAL_THREADS=threads))
+
+    print('walk: %d files, %d cores' % (files, cores))
+    rows = []
+    base = best_of(3, lambda: reveal(1))
+    base_cold = best_cold(1, lambda: reveal(1))
+    for n in counts:
+        t = base if n == 1 else best_of(3, lambda: reveal(n))
+        c = base_cold if n == 1 else best_cold(1, lambda: reveal(n))
+        rows.append([n, '%.3f' % t, '%.2fx' % (base / t), '%.0f' % (files / t),
+                     '%.3f' % c if c else '-', '%.2fx' % (base_cold / c) if c else '-'])
+    ls = ['ls', '-R', tree]
+    c = best_cold(1, lambda: run(ls))
+    rows.append(['ls -R', '%.3f' % best_of(3, lambda: run(ls)), '', '', '%.3f' % c if c else '-', ''])
+    table(['threads', 'warm s', 'speedup', 'files/s', 'cold s', 'speedup'], rows)
+
+
+def bench_statx(args):
+    """reveal -L on 100K entries: batched io_uring statx against fstatat"""
+    files = args.scale(100000)
+    tree = os.path.join(args.dir, 'statx')
+    make_tree(tree, files, per_dir=files)
+    tree = os.path.join(tree, '0')     # The single directory make_tree() made
+    cmd = [args.shell, '-c', 'reveal -L ' + tree]
+    variants = [
+        ('io_uring statx', lambda: run(cmd)),
+        ('fstatat', lambda: run(cmd, env=with_env(REVEAL_NO_URING=1))),
+        ('ls -l', lambda: run(['ls', '-l', tree])),
+    ]
+    print('statx: one directory of %d files' % files)
+    rows = []
+    for name, fn in variants:
+        warm = best_of(5, fn)
+        cold = best_cold(3, fn)
+        rows.append([name, '%.3f' % warm, '%.3f' % cold if cold else '-'])
+    table(['', 'warm s', 'cold s'], rows)
+
+
+def bench_glob(args):
+    """Globs against one directory of 1M files, and ** over the walk tree"""
+    files = args.scale(1000000)
+    flat = os.path.join(args.dir, 'glob')
+    make_tree(flat, files, per_dir=files)
+    flat = os.path.join(flat, '0')      # The single directory make_tree() made
+    tree = os.path.join(args.dir, 'walk')
+    make_tree(tree, files)
+    cases = [
+        ('*7', 'echo %s/*7' % flat),
+        ('f?????', 'echo %s/f?????' % flat),
+        ('f[0-4]*5', 'echo %s/f[0-4]*5' % flat),
+        ('*1 *2, one line', 'echo %s/*1 %s/*2' % (flat, flat)),
+        ('**/f999', 'echo %s/**/f999' % tree),
+    ]
+    print('glob: %d files in one directory, and the same number in the walk tree' % files)
+    rows = []
+    for name, command in cases:
+        t = best_of(3, lambda: run_text(args.shell, command, args))
+        b = best_of(3, lambda: run(['bash', '-O', 'globstar', '-c', command]))
+        rows.append([name, '%.3f' % t, '%.3f' % b])
+    t = best_of(3, lambda: run(['find', flat, '-name', '*7']))
+    rows.append(['find -name *7', '%.3f' % t, ''])
+    table(['pattern', 'seconds', 'bash'], rows)
+
+
+def bench_builtins(args):
+    """A 100K-line script of echo, printf, test, [, true, false and pwd"""
+    count = args.scale(100000)
+    kinds = ['echo line {0}', 'printf %s-%d\\n item {0}', 'test {0} -gt 0', '[ {0} -ne 0 ]',
+             'true', 'false', 'pwd']
+    lines = [kinds[i % len(kinds)].format(i) for i in range(count)]
+    path = write_script(args, 'builtins.sh', lines)
+    print('builtins: %d lines' % count)
+    table(['', 'seconds', 'us/line'], script_rows(args, path, count))
+
+
+def bench_exports(args):
+    """$VAR expansion and external commands with 1K exported variables"""
+    count = args.scale(2000)
+    exports = '\n'.join('export BENCH_VAR%d=value%d' % (i, i) for i in range(1000)) + '\n'
+    expand = '\n'.join(['echo $BENCH_VAR1 ${BENCH_VAR500} $BENCH_VAR999'] * count) + '\n'
+    literal = '\n'.join(['echo value1 value500 value999'] * count) + '\n'
+    execs = '\n'.join(['/bin/true'] * count) + '\n'
+    cases = [
+        ('echo, literal words', exports + literal, ()),
+        ('echo, 3 expansions', exports + expand, ()),
+        ('/bin/true, no exports', execs, ()),
+        ('/bin/true, 1K exports', exports + execs, ()),
+        ('  with --fork-server', exports + execs, ('--fork-server',)),
+    ]
+    print('exports: %d commands, with 1000 exports where noted' % count)
+    rows = []
+    for name, text, flags in cases:
+        t = best_of(3, lambda: run_text(args.shell, text, args, flags))
+        b = '' if flags else '%.1f' % (best_of(3, lambda: run(['bash', '-c', text])) / count * 1e6)
+        rows.append([name, '%.1f' % (t / count * 1e6), b])
+    table(['', 'us/cmd', 'bash'], rows)
+
+
+def nested_loop(levels, body):
+    """10^levels iterations of 'body'; the shell has no arithmetic to count with."""
+    names = 'abcdefgh'[:levels]
+    head = ' '.join('for %s in 0 1 2 3 4 5 6 7 8 9; do' % n for n in names)
+    return '%s %s; %s\n' % (head, body, ' '.join(['done;'] * levels)[:-1])
+
+
+def bench_loops(args):
+    """Compiled for loops: 1M iterations of builtins, 10K of an external"""
+    quick = 2 if args.quick else 0
+    cases = [
+        ('builtins', 6 - quick, 'echo $a$b$c$d$e$f; test $f -lt 5'),
+        ('/bin/true', 4 - quick, '/bin/true $a$b$c$d'),
+    ]
+    print('loops: nested for loops, 10 words each')
+    rows = []
+    for name, levels, body in cases:
+        text = nested_loop(levels, body)
+        iterations = 10 ** levels
+        t = best_of(3, lambda: run_text(args.shell, text, args))
+        b = best_of(3, lambda: run(['bash', '-c', text]))
+        rows.append([name, iterations, '%.3f' % t, '%.2f' % (t / iterations * 1e6),
+                     '%.3f' % b, '%.2f' % (b / iterations * 1e6)])
+    table(['', 'iterations', 'seconds', 'us/iter', 'bash s', 'us/iter'], rows)
+
+
+def bench_subst(args):
+    """10K $(...) substitutions in a loop: builtins captured in-process, an external piped"""
+    levels = 2 if args.quick else 4
+    iterations = 10 ** levels
+    cases = [
+        ('$(echo ...)', 'x=$(echo $a$b$c$d)'),
+        ('$(printf; pwd)', 'x=$(printf %s $a$b; pwd)'),
+        ('$(/bin/echo ...)', 'x=$(/bin/echo $a$b$c$d)'),
+    ]
+    print('subst: %d substitutions each' % iterations)
+    rows = []
+    for name, body in cases:
+        text = nested_loop(levels, body)
+        t = best_of(3, lambda: run_text(args.shell, text, args))
+        b = best_of(3, lambda: run(['bash', '-c', text]))
+        rows.append([name, '%.3f' % t, '%.2f' % (t / iterations * 1e6), '%.3f' % b, '%.2f' % (b / iterations * 1e6)])
+    table(['', 'seconds', 'us/subst', 'bash s', 'us/subst'], rows)
+
+
+def bench_heredoc(args):
+    """Here-documents and $(...) captures from 1 KB to 100 MB against a temp file"""
+    sizes = [1 << 10, 64 << 10, 1 << 20, 16 << 20, 100 << 20]
+    if args.quick:
+        sizes = [n for n in sizes if n <= 1 << 20]
+    line = 'x' * 63 + '\n'
+    data = os.path.join(args.dir, 'payload')
+    tmp = os.path.join(args.dir, 'tmpfile')
+
+    def via_temp_file(size):
+        # The old way: write the payload out, redirect from it, delete it
+        start = time.perf_counter()
+        with open(tmp, 'w') as f:
+            f.write(line * (size // len(line)))
+        run([args.shell, '-c', 'cat < ' + tmp])
+        os.unlink(tmp)
+        return time.perf_counter() - start
+
+    def capture_to_file():
+        start = time.perf_counter()
+        run([args.shell, '-c', 'cat %s > %s' % (data, tmp)])
+        os.unlink(tmp)
+        return time.perf_counter() - start
+
+    print('heredoc: payload lines of 64 bytes')
+    rows = []
+    for size in sizes:
+        body = line * (size // len(line))
+        script = write_script(args, 'heredoc.sh', ['cat <<EOF', body + 'EOF'])
+        with open(data, 'w') as f:
+            f.write(body)
+        repeat = 3 if size < 16 << 20 else 1
+        here = best_of(repeat, lambda: run_script(args.shell, script, args))
+        here_bash = best_of(repeat, lambda: run(['bash', script]))
+        temp = best_of(repeat, lambda: via_temp_file(size))
+        capture = best_of(repeat, lambda: run_text(args.shell, 'x=$(cat %s)' % data, args))
+        capture_bash = best_of(repeat, lambda: run(['bash', '-c', 'x=$(cat %s)' % data]))
+        to_file = best_of(repeat, capture_to_file)
+        label = '%d KB' % (size >> 10) if size < 1 << 20 else '%d MB' % (size >> 20)
+        rows.append([label] + ['%.3f' % t for t in (here, here_bash, temp, capture, capture_bash, to_file)])
+    table(['size', '<<EOF', 'bash', 'temp file', '$(...)', 'bash', '> file'], rows)
+
+
+def bench_fanout(args):
+    """cmd > a > b (> c) through the splice relay against | tee at 1 GB and 4 GB"""
+    sizes = [1 << 30, 4 << 30]
+    if args.quick:
+        sizes = [10 << 20]
+    src = os.path.join(args.dir, 'fanout-src')
+    outs = [os.path.join(args.dir, 'fanout-%d' % i) for i in range(3)]
+    tee = shutil.which('tee') or '/usr/bin/tee'
+
+    def timed(cmd):
+        t = run(cmd, env=dict(os.environ, HOME=args.dir))
+        for out in outs:
+            if os.path.exists(out):
+                os.unlink(out)
+        return t
+
+    print('fanout: cat of a file to 2 and 3 files, warm source')
+    rows = []
+    for size in sizes:
+        with open(src, 'w') as f:
+            chunk = ('x' * 1023 + '\n') * 1024
+            for _ in range(size >> 20):
+                f.write(chunk)
+        repeat = 3 if size <= 1 << 30 else 2
+        for n in (2, 3):
+            targets = outs[:n]
+            relay = 'cat %s %s' % (src, ' '.join('> ' + t for t in targets))
+            piped = 'cat %s | %s %s > /dev/null' % (src, tee, ' '.join(targets))
+            t = best_of(repeat, lambda: timed([args.shell, '-c', relay]))
+            p = best_of(repeat, lambda: timed([args.shell, '-c', piped]))
+            b = best_of(repeat, lambda: timed(['bash', '-c', piped]))
+            label = '%d GB x%d' % (size >> 30, n) if size >= 1 << 30 else '%d MB x%d' % (size >> 20, n)
+            rows.append([label, '%.3f' % t, '%.0f' % ((size >> 20) / t), '%.3f' % p, '%.3f' % b])
+    os.unlink(src)
+    table(['', '> a > b', 'MB/s', '| tee', 'bash | tee'], rows)
+
+
+def bench_filters(args):
+    """grep, wc, head and tail as builtins against coreutils on a 2 GB file"""
+    size = 20 << 20 if args.quick else 2 << 30
+    src = os.path.join(args.dir, 'filters-src')
+    out = os.path.join(args.dir, 'filters-out')
+    # Prose-like lines of 1-12 words; one line in 1000 holds the needle
+    words = ['alpha', 'beta', 'gamma', 'delta', 'request', 'error', 'shell', 'x', 'pipeline', 'of']
+    lines = []
+    for i in range(16384):
+        n = 1 + (i * 7) % 12
+        line = ' '.join(words[(i + k * 3) % len(words)] for k in range(n))
+        lines.append(line + (' needle' if i % 1000 == 999 else '') + '\n')
+    chunk = ''.join(lines)
+    with open(src, 'w') as f:
+        written = 0
+        while written < size:
+            f.write(chunk)
+            written += len(chunk)
+
+    tools = {name: shutil.which(name) or '/usr/bin/' + name for name in ('grep', 'wc', 'head', 'tail')}
+
+    def external(line):
+        return ' '.join(tools.get(word, word) for word in line.split())
+
+    print('filters: %d MB file, warm cache; coreutils run from the same shell by path' % (written >> 20))
+    rows = []
+    for line in ('grep needle F | wc -l', 'grep -v needle F | wc -l', 'grep -c needle F',
+                 'wc F', 'wc -l F', 'cat F | tail -n 5', 'cat F | head -n 100000'):
+        # Into a file: GNU grep stops at the first match when stdout is /dev/null
+        text = line.replace('F', src) + ' > ' + out
+        b = best_of(3, lambda: run([args.shell, '-c', text], env=dict(os.environ, HOME=args.dir)))
+        c = best_of(3, lambda: run([args.shell, '-c', external(text)], env=dict(os.environ, HOME=args.dir)))
+        rows.append([line, '%.3f' % b, '%.3f' % c, '%.2fx' % (c / b)])
+    os.unlink(src)
+    os.unlink(out)
+    table(['', 'builtin s', 'coreutils s', 'speedup'], rows)
+
+
+def bench_server(args):
+    """One-off commands: cold shell.out -c against a shell-client.out round-trip"""
+    count = args.scale(1000)
+    client = os.path.join(os.path.dirname(args.shell), 'shell-client.out')
+    sock = os.path.join(args.dir, 'server.sock')
+    env = dict(os.environ, HOME=args.dir)
+    # A full history, as a user's would be: loading it is part of startup
+    with open(os.path.join(args.dir, '.cshell_log'), 'w') as f:
+        f.write(''.join('echo history %d\n' % i for i in range(15)))
+    server = subprocess.Popen([args.shell, '--server', sock], env=env,
+                              stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        for _ in range(100):
+            if os.path.exists(sock):
+                break
+            time.sleep(0.05)
+
+        def loop(cmd):
+            start = time.perf_counter()
+            for _ in range(count):
+                subprocess.run(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, env=env)
+            return time.perf_counter() - start
+
+        print('server: %d one-off commands, one process each, 15 history entries' % count)
+        rows = []
+        for line in ('true', 'echo hi; pwd', '/bin/true'):
+            variants = [('shell.out -c', [args.shell, '-c', line]), ('client', [client, sock, line]),
+                        ('bash -c', ['bash', '-c', line])]
+            rows.append([line] + ['%.0f' % (best_of(3, lambda: loop(cmd)) / count * 1e6) for _, cmd in variants])
+        table(['command', '-c us', 'client us', 'bash us'], rows)
+    finally:
+        server.terminate()
+        server.wait()
+
+
+def bench_launch(args):
+    """/bin/true launched 1K times by a shell holding 10 MB to 1 GB, forked or via --fork-server"""
+    sizes = [10 << 20, 100 << 20, 1 << 30]
+    if args.quick:
+        sizes = [1 << 20, 10 << 20]
+    levels = 1 if args.quick else 3
+    launches = 10 ** levels
+    data = os.path.join(args.dir, 'ballast')
+
+    def rss():
+        # The shell's own resident size once the variable is set
+        out = subprocess.run([args.shell, '-c', 'x=$(cat %s)\ngrep VmRSS /proc/$$/status' % data],
+                             stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, env=dict(os.environ, HOME=args.dir))
+        fields = out.stdout.split()
+        return int(fields[1]) >> 10 if len(fields) > 1 else 0
+
+    print('launch: %d launches of /bin/true, the shell holding a variable of the given size' % launches)
+    rows = []
+    for size in sizes:
+        with open(data, 'w') as f:
+            f.write(('x' * 1023 + '\n') * (size >> 10))
+        fill = 'x=$(cat %s)\n' % data
+        text = fill + nested_loop(levels, '/bin/true')
+        setup = best_of(3, lambda: run_text(args.shell, fill, args))
+        fork = best_of(3, lambda: run_text(args.shell, text, args)) - setup
+        setup = best_of(3, lambda: run_text(args.shell, fill, args, ('--fork-server',)))
+        server = best_of(3, lambda: run_text(args.shell, text, args, ('--fork-server',))) - setup
+        label = '%d MB' % (size >> 20) if size < 1 << 30 else '%d GB' % (size >> 30)
+        rows.append([label, rss(), '%.1f' % (fork / launches * 1e6), '%.1f' % (server / launches * 1e6),
+                     '%.2fx' % (fork / server)])
+    os.unlink(data)
+    table(['variable', 'RSS MB', 'fork us', 'server us', 'speedup'], rows)
+
+
+BENCHES = [
+    ('walk', bench_walk),
+    ('statx', bench_statx),
+    ('glob', bench_glob),
+    ('builtins', bench_builtins),
+    ('exports', bench_exports),
+    ('loops', bench_loops),
+    ('subst', bench_subst),
+    ('heredoc', bench_heredoc),
+    ('fanout', bench_fanout),
+    ('filters', bench_filters),
+    ('launch', bench_launch),
+    ('server', bench_server),
+]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmarks for shell.out')
+    parser.add_argument('--shell', default=os.path.join(ROOT, 'shell.out'))
+    parser.add_argument('--baseline', help='older shell.out to compare against')
+    parser.add_argument('--dir', help='where generated trees are kept')
+    parser.add_argument('--quick', action='store_true', help='divide every size by 100')
+    parser.add_argument('benches', nargs='*', help=', '.join(name for name, _ in BENCHES))
+    args = parser.parse_args()
+    args.shell = os.path.abspath(args.shell)
+    args.scale = (lambda n: max(1, n // 100)) if args.quick else (lambda n: n)
+    keep = args.dir is not None
+    args.dir = os.path.abspath(args.dir) if keep else tempfile.mkdtemp(prefix='shell-bench-')
+    os.makedirs(args.dir, exist_ok=True)
+
+    names = args.benches or [name for name, _ in BENCHES]
+    unknown = [n for n in names if n not in dict(BENCHES)]
+    if unknown:
+        parser.error('unknown benchmark: ' + ', '.join(unknown))
+    try:
+        for name, fn in BENCHES:
+            if name in names:
+                fn(args)
+    finally:
+        if not keep:
+            shutil.rmtree(args.dir, ignore_errors=True)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,139 @@
+// Build-time generator for the builtin registry.
+//
+// Reads src/builtins.def and writes a header holding a perfect-hash table:
+// every builtin name lands in its own slot of a power-of-two array, so a
+// lookup is one hash, one mask and one strcmp.
+//
+// Usage: gen_builtins <builtins.def> <builtin_table.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "builtins.h"
+
+#define MAX_BUILTINS 256
+#define MAX_SEED_TRIES 1000000u
+
+typedef struct {
+    char name[64];
+    char function[64];
+    char flags[128];
+} Entry;
+
+static int parse_def(const char *path, Entry *entries);
+static int find_seed(const Entry *entries, int count, uint32_t size, uint32_t *seed_out);
+static void write_flags(FILE *out, const char *flags);
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <builtins.def> <output.h>\n", argv[0]);
+        return 1;
+    }
+
+    static Entry entries[MAX_BUILTINS];
+    int count = parse_def(argv[1], entries);
+    if (count < 0) return 1;
+
+    uint32_t size = 1;
+    while (size < (uint32_t)count) size <<= 1;
+
+    // Start at the smallest table that fits and double until a seed works;
+    // small sets almost always succeed at 1x or 2x
+    uint32_t seed = 0;
+    while (find_seed(entries, count, size, &seed) != 0) {
+        size <<= 1;
+        if (size > 16 * MAX_BUILTINS) {
+            fprintf(stderr, "gen_builtins: no perfect hash found\n");
+            return 1;
+        }
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out) { perror(argv[2]); return 1; }
+
+    fprintf(out, "// Generated by tools/gen_builtins from %s. Do not edit.\n", argv[1]);
+    fprintf(out, "#ifndef BUILTIN_TABLE_H\n#define BUILTIN_TABLE_H\n\n");
+    fprintf(out, "#define BUILTIN_HASH_SEED 0x%08xu\n", seed);
+    fprintf(out, "#define BUILTIN_TABLE_MASK 0x%xu\n\n", size - 1);
+    fprintf(out, "static const Builtin builtin_table[%u] = {\n", size);
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = builtin_hash(entries[i].name, seed) & (size - 1);
+        fprintf(out, "    [%u] = { \"%s\", %s, ", slot, entries[i].name, entries[i].function);
+        write_flags(out, entries[i].flags);
+        fprintf(out, " },\n");
+    }
+    fprintf(out, "};\n\n#endif // BUILTIN_TABLE_H\n");
+
+    if (fclose(out) != 0) { perror(argv[2]); return 1; }
+    return 0;
+}
+
+// Each non-comment line is "name function flags"
+static int parse_def(const char *path, Entry *entries) {
+    FILE *f = fopen(path, "r");
+    if (!f) { perror(path); return -1; }
+
+    char line[512];
+    int count = 0, lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') continue;
+
+        if (count == MAX_BUILTINS) {
+            fprintf(stderr, "%s:%d: too many builtins\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        Entry *e = &entries[count];
+        if (sscanf(p, "%63s %63s %127s", e->name, e->function, e->flags) != 3) {
+            fprintf(stderr, "%s:%d: expected 'name function flags'\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        for (int i = 0; i < count; i++) {
+            if (strcmp(entries[i].name, e->name) == 0) {
+                fprintf(stderr, "%s:%d: duplicate builtin '%s'\n", path, lineno, e->name);
+                fclose(f);
+                return -1;
+            }
+        }
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+static int find_seed(const Entry *entries, int count, uint32_t size, uint32_t *seed_out) {
+    unsigned char used[16 * MAX_BUILTINS];
+    for (uint32_t seed = 1; seed < MAX_SEED_TRIES; seed++) {
+        memset(used, 0, size);
+        int i;
+        for (i = 0; i < count; i++) {
+            uint32_t slot = builtin_hash(entries[i].name, seed) & (size - 1);
+            if (used[slot]) break;
+            used[slot] = 1;
+        }
+        if (i == count) {
+            *seed_out = seed;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// "PARENT|PIPELINE" -> "BUILTIN_PARENT | BUILTIN_PIPELINE"
+static void write_flags(FILE *out, const char *flags) {
+    if (strcmp(flags, "0") == 0 || strcmp(flags, "NONE") == 0) { fprintf(out, "0"); return; }
+    char copy[128];
+    strncpy(copy, flags, sizeof(copy) - 1);
+    copy[sizeof(copy) - 1] = '\0';
+    const char *sep = "";
+    for (char *tok = strtok(copy, "|"); tok; tok = strtok(NULL, "|")) {
+        fprintf(out, "%sBUILTIN_%s", sep, tok);
+        sep = " | ";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# Drives shell.out on a pseudo-terminal, the way a user types at it, and
+# checks what comes back. Piped input cannot catch continuation bugs: at EOF
+# the shell runs whatever it has read, complete or not.
+#
+#     tools/interactive_test.py [path/to/shell.out]
+
+import os
+import pty
+import select
+import sys
+import time
+
+SHELL = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), '..', 'shell.out')
+
+# Lines typed one at a time, and the output expected once the last one is in
+CASES = [
+    ('brace group', ['{ echo a', 'echo b', '}'], ['a', 'b']),
+    ('subshell', ['(', 'echo sub', ')'], ['sub']),
+    ('redirected group', ['{ echo r1', 'echo r2', '} > /dev/null', 'echo after'], ['after']),
+    ('nested groups', ['( { echo in', '}', ')'], ['in']),
+    ('if', ['if true', 'then echo yes', 'fi'], ['yes']),
+    ('for', ['for i in 1 2', 'do echo $i', 'done'], ['1', '2']),
+    ('case', ['case x in', 'x) echo matched ;;', 'esac'], ['matched']),
+    ('here-document', ['cat <<EOF', 'body', 'EOF'], ['body']),
+    ('syntax error status', ['ls |', 'echo status=$?'], ['status=2']),
+]
+
+
+def read_until_quiet(fd, quiet=0.3, limit=5.0):
+    out = b''
+    end = time.time() + limit
+    last = time.time()
+    while time.time() < end and time.time() - last < quiet:
+        ready, _, _ = select.select([fd], [], [], 0.05)
+        if not ready:
+            continue
+        try:
+            chunk = os.read(fd, 4096)
+        except OSError:
+            break
+        if not chunk:
+            break
+        out += chunk
+        last = time.time()
+    return out.decode(errors='replace')
+
+
+def run_case(lines):
+    pid, fd = pty.fork()
+    if pid == 0:
+        os.execv(SHELL, [SHELL])
+    read_until_quiet(fd)
+    for line in lines:
+        os.write(fd, (line + '\n').encode())
+        out = read_until_quiet(fd)
+    # Output of the last line only: anything run at EOF does not count
+    try:
+        os.kill(pid, 9)
+    except ProcessLookupError:
+        pass
+    os.waitpid(pid, 0)
+    os.close(fd)
+    return out
+
+
+def main():
+    failures = 0
+    for name, lines, expected in CASES:
+        out = run_case(lines)
+        got = [l.strip() for l in out.replace('\r', '').split('\n')]
+        missing = [e for e in expected if e not in got]
+        if missing:
+            failures += 1
+            print('FAIL %s: expected %s in %r' % (name, missing, out))
+        else:
+            print('ok   %s' % name)
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,112 @@
+// Client for `shell.out --server`: runs one command line in the resident
+// shell on this process's stdin, stdout and stderr, from this process's
+// working directory, and exits with the command's status.
+//
+//     shell-client.out SOCKET 'command line'
+
+// CMSG_SPACE/CMSG_LEN need the default feature set
+#define _DEFAULT_SOURCE
+
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static bool write_all(int fd, const void *buf, size_t len);
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s socket command\n", argv[0]);
+        return 2;
+    }
+    const char *path = argv[1], *line = argv[2];
+
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) { perror("getcwd"); return 2; }
+    size_t cwd_len = strlen(cwd) + 1, line_len = strlen(line) + 1;
+    if (cwd_len + line_len > SERVER_MAX_PAYLOAD) {
+        fprintf(stderr, "%s: command too long\n", argv[0]);
+        return 2;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: %s: path too long\n", argv[0], path);
+        return 2;
+    }
+    strcpy(addr.sun_path, path);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror(path);
+        return 2;
+    }
+
+    // A closed standard descriptor is passed as /dev/null
+    int fds[3];
+    for (int i = 0; i < 3; i++) {
+        fds[i] = i;
+        if (fcntl(i, F_GETFD) < 0) fds[i] = open("/dev/null", i == 0 ? O_RDONLY : O_WRONLY);
+    }
+
+    ServerRequest req = { SERVER_MAGIC, (uint32_t)(cwd_len + line_len) };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(fds))];
+    } control;
+    struct iovec iov = { &req, sizeof(req) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t sent;
+    while ((sent = sendmsg(sock, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+    if (sent != (ssize_t)sizeof(req) || !write_all(sock, cwd, cwd_len) || !write_all(sock, line, line_len)) {
+        fprintf(stderr, "%s: request failed\n", argv[0]);
+        return 2;
+    }
+
+    // Nothing but the status comes back, once the command has finished
+    int32_t status;
+    size_t got = 0;
+    while (got < sizeof(status)) {
+        ssize_t n = read(sock, (char *)&status + got, sizeof(status) - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            fprintf(stderr, "%s: server closed the connection\n", argv[0]);
+            return 2;
+        }
+        got += n;
+    }
+    return status;
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
\ No newline at end of file